@@ -0,0 +1,472 @@
+#include "anonymizer_kernels.h"
+#include "ema_background_model.h"
+
+#include <opencv2/core/hal/intrin.hpp>
+#include <algorithm>
+#include <cstdlib>
+
+static constexpr int kFractionBits = EmaBackgroundModel::kFractionBits;
+static constexpr uint32_t kHalf = 1u << (kFractionBits - 1);
+// Rounding of the Q16 products of the update
+static constexpr uint32_t kProductHalf = 1u << 15;
+
+void emaCompositeRowScalar(const uchar* src, const uchar* mask, uint16_t* acc, uchar* dst,
+                           int width, int cn, uint16_t alpha) {
+    const uint32_t a = alpha;
+    const uint32_t b = 65536u - alpha;
+
+    for (int x = 0, i = 0; x < width; ++x, i += cn) {
+        if (mask && mask[x]) {
+            // Person pixel: keep the model and output the background
+            if (dst) {
+                for (int c = 0; c < cn; ++c) {
+                    dst[i + c] = static_cast<uchar>((acc[i + c] + kHalf) >> kFractionBits);
+                }
+            }
+            continue;
+        }
+
+        // Background pixel: learn it (unless alpha is 0) and output the frame.
+        // The weighted sum is rounded, so that the model does not drift
+        // downwards at low learning rates. It fits in 32 bits: it is at most
+        // 65536 times the largest accumulator value.
+        for (int c = 0; c < cn; ++c) {
+            const uint32_t s = src[i + c];
+            if (a != 0) {
+                acc[i + c] = static_cast<uint16_t>((acc[i + c] * b + (s << kFractionBits) * a + kProductHalf) >> 16);
+            }
+            if (dst) {
+                dst[i + c] = static_cast<uchar>(s);
+            }
+        }
+    }
+}
+
+#if CV_SIMD128
+// Rounded (1 - alpha) * acc + alpha * (src << kFractionBits) of 8 pixels,
+// computed on 32 bits like the scalar version
+static inline cv::v_uint16x8 emaUpdate(const cv::v_uint16x8& acc, const cv::v_uint16x8& src,
+                                       const cv::v_uint16x8& vAlpha, const cv::v_uint16x8& vBeta,
+                                       const cv::v_uint32x4& vRound) {
+    cv::v_uint32x4 acc0, acc1, src0, src1;
+    cv::v_mul_expand(acc, vBeta, acc0, acc1);
+    cv::v_mul_expand(src << kFractionBits, vAlpha, src0, src1);
+    return cv::v_pack((acc0 + src0 + vRound) >> 16, (acc1 + src1 + vRound) >> 16);
+}
+
+// Processes 16 pixels per iteration and returns the number of pixels done.
+// The remaining tail is left to the scalar implementation.
+template <int CN, bool HasMask, bool HasDst>
+static int emaCompositeRowSimd(const uchar* src, const uchar* mask, uint16_t* acc, uchar* dst,
+                               int width, uint16_t alpha) {
+    const cv::v_uint16x8 vAlpha = cv::v_setall_u16(alpha);
+    const cv::v_uint16x8 vBeta = cv::v_setall_u16(static_cast<ushort>(65536u - alpha));
+    const cv::v_uint16x8 vHalf = cv::v_setall_u16(static_cast<ushort>(kHalf));
+    const cv::v_uint32x4 vRound = cv::v_setall_u32(kProductHalf);
+    const bool learn = alpha != 0;
+    const cv::v_uint16x8 zero16 = cv::v_setzero_u16();
+    const cv::v_uint8x16 zero8 = cv::v_setzero_u8();
+
+    int x = 0;
+    for (; x <= width - 16; x += 16) {
+        cv::v_uint8x16 s[CN];
+        cv::v_uint16x8 lo[CN], hi[CN];
+        if constexpr (CN == 3) {
+            cv::v_load_deinterleave(src + 3 * x, s[0], s[1], s[2]);
+            cv::v_load_deinterleave(acc + 3 * x, lo[0], lo[1], lo[2]);
+            cv::v_load_deinterleave(acc + 3 * x + 24, hi[0], hi[1], hi[2]);
+        } else {
+            s[0] = cv::v_load(src + x);
+            lo[0] = cv::v_load(acc + x);
+            hi[0] = cv::v_load(acc + x + 8);
+        }
+
+        // All-ones lanes for person pixels, at 8 and 16 bit widths
+        cv::v_uint8x16 m8 = zero8;
+        cv::v_uint16x8 mLo = zero16, mHi = zero16;
+        if (HasMask) {
+            m8 = cv::v_load(mask + x) != zero8;
+            cv::v_expand(m8, mLo, mHi);
+            mLo = mLo != zero16;
+            mHi = mHi != zero16;
+        }
+
+        cv::v_uint8x16 out[CN];
+        for (int c = 0; c < CN; ++c) {
+            if (HasDst) {
+                if (HasMask) {
+                    cv::v_uint8x16 bg = cv::v_pack((lo[c] + vHalf) >> kFractionBits,
+                                                   (hi[c] + vHalf) >> kFractionBits);
+                    out[c] = cv::v_select(m8, bg, s[c]);
+                } else {
+                    out[c] = s[c];
+                }
+            }
+
+            if (learn) {
+                cv::v_uint16x8 sLo, sHi;
+                cv::v_expand(s[c], sLo, sHi);
+                cv::v_uint16x8 nLo = emaUpdate(lo[c], sLo, vAlpha, vBeta, vRound);
+                cv::v_uint16x8 nHi = emaUpdate(hi[c], sHi, vAlpha, vBeta, vRound);
+                lo[c] = HasMask ? cv::v_select(mLo, lo[c], nLo) : nLo;
+                hi[c] = HasMask ? cv::v_select(mHi, hi[c], nHi) : nHi;
+            }
+        }
+
+        if constexpr (CN == 3) {
+            cv::v_store_interleave(acc + 3 * x, lo[0], lo[1], lo[2]);
+            cv::v_store_interleave(acc + 3 * x + 24, hi[0], hi[1], hi[2]);
+            if (HasDst) {
+                cv::v_store_interleave(dst + 3 * x, out[0], out[1], out[2]);
+            }
+        } else {
+            cv::v_store(acc + x, lo[0]);
+            cv::v_store(acc + x + 8, hi[0]);
+            if (HasDst) {
+                cv::v_store(dst + x, out[0]);
+            }
+        }
+    }
+    return x;
+}
+
+template <int CN>
+static int emaCompositeRowSimdDispatch(const uchar* src, const uchar* mask, uint16_t* acc, uchar* dst,
+                                       int width, uint16_t alpha) {
+    if (mask) {
+        return dst ? emaCompositeRowSimd<CN, true, true>(src, mask, acc, dst, width, alpha)
+                   : emaCompositeRowSimd<CN, true, false>(src, mask, acc, dst, width, alpha);
+    }
+    return dst ? emaCompositeRowSimd<CN, false, true>(src, mask, acc, dst, width, alpha)
+               : emaCompositeRowSimd<CN, false, false>(src, mask, acc, dst, width, alpha);
+}
+#endif
+
+static void emaCompositeRowImpl(const uchar* src, const uchar* mask, uint16_t* acc, uchar* dst,
+                                int width, int cn, uint16_t alpha, bool useSimd) {
+    // In place without persons there is nothing to write back
+    if (dst == src && !mask) {
+        dst = nullptr;
+    }
+    // Frozen background and no output: nothing to do at all
+    if (alpha == 0 && !dst) {
+        return;
+    }
+
+    int x = 0;
+#if CV_SIMD128
+    if (useSimd) {
+        if (cn == 3) {
+            x = emaCompositeRowSimdDispatch<3>(src, mask, acc, dst, width, alpha);
+        } else if (cn == 1) {
+            x = emaCompositeRowSimdDispatch<1>(src, mask, acc, dst, width, alpha);
+        }
+    }
+#else
+    (void)useSimd;
+#endif
+
+    if (x < width) {
+        emaCompositeRowScalar(src + x * cn, mask ? mask + x : nullptr, acc + x * cn,
+                              dst ? dst + x * cn : nullptr, width - x, cn, alpha);
+    }
+}
+
+void emaCompositeRow(const uchar* src, const uchar* mask, uint16_t* acc, uchar* dst,
+                     int width, int cn, uint16_t alpha) {
+    emaCompositeRowImpl(src, mask, acc, dst, width, cn, alpha, true);
+}
+
+void emaComposite(const cv::Mat& frame, const cv::Mat& mask, cv::Mat& accumulator, cv::Mat& dst,
+                  uint16_t alpha, bool useSimd) {
+    CV_Assert(frame.depth() == CV_8U);
+    CV_Assert(accumulator.size() == frame.size() && accumulator.type() == CV_16UC(frame.channels()));
+    CV_Assert(mask.empty() || (mask.size() == frame.size() && mask.type() == CV_8UC1));
+
+    // Does not reallocate if dst already has the right geometry (e.g. in place)
+    dst.create(frame.size(), frame.type());
+
+    const int cn = frame.channels();
+    int rows = frame.rows;
+    int cols = frame.cols;
+
+    // Process continuous images as a single long row
+    if (frame.isContinuous() && accumulator.isContinuous() && dst.isContinuous() &&
+        (mask.empty() || mask.isContinuous())) {
+        cols *= rows;
+        rows = 1;
+    }
+
+    for (int y = 0; y < rows; ++y) {
+        emaCompositeRowImpl(frame.ptr<uchar>(y),
+                            mask.empty() ? nullptr : mask.ptr<uchar>(y),
+                            accumulator.ptr<uint16_t>(y),
+                            dst.ptr<uchar>(y),
+                            cols, cn, alpha, useSimd);
+    }
+}
+
+// Split row y in spans outside and inside the regions, and call
+// fn(x, width, inside) on each of them from left to right
+template <typename SpanFn>
+static void forEachRegionSpan(int y, int cols, const std::vector<cv::Rect>& regions, SpanFn fn) {
+    int x = 0;
+    for (const cv::Rect& r : regions) {
+        if (y < r.y || y >= r.y + r.height) {
+            continue;
+        }
+        if (r.x > x) {
+            fn(x, r.x - x, false);
+        }
+        fn(r.x, r.width, true);
+        x = r.x + r.width;
+    }
+    if (x < cols) {
+        fn(x, cols - x, false);
+    }
+}
+
+void emaCompositeRegions(const cv::Mat& frame, const cv::Mat& mask, const std::vector<cv::Rect>& regions,
+                         cv::Mat& accumulator, cv::Mat& dst, uint16_t alpha, bool useSimd) {
+    if (mask.empty() || regions.empty()) {
+        emaComposite(frame, cv::Mat(), accumulator, dst, alpha, useSimd);
+        return;
+    }
+
+    CV_Assert(frame.depth() == CV_8U);
+    CV_Assert(accumulator.size() == frame.size() && accumulator.type() == CV_16UC(frame.channels()));
+    CV_Assert(mask.size() == frame.size() && mask.type() == CV_8UC1);
+
+    dst.create(frame.size(), frame.type());
+
+    const int cn = frame.channels();
+    for (int y = 0; y < frame.rows; ++y) {
+        const uchar* src = frame.ptr<uchar>(y);
+        const uchar* m = mask.ptr<uchar>(y);
+        uint16_t* acc = accumulator.ptr<uint16_t>(y);
+        uchar* out = dst.ptr<uchar>(y);
+
+        // The mask is only read inside the regions
+        forEachRegionSpan(y, frame.cols, regions, [&](int x, int width, bool inside) {
+            emaCompositeRowImpl(src + x * cn, inside ? m + x : nullptr, acc + x * cn, out + x * cn,
+                                width, cn, alpha, useSimd);
+        });
+    }
+}
+
+void cntCompositeRowScalar(const uchar* src, const uchar* mask, uchar* bg, uchar* candidate, uchar* stability,
+                           uchar* fg, uchar* dst, int width, int cn, const CntKernelParams& params) {
+    const int threshold = params.threshold;
+
+    for (int x = 0, i = 0; x < width; ++x, i += cn) {
+        const bool person = mask && mask[x];
+
+        // Learn the pixel unless it belongs to a person
+        if (!person) {
+            int diff = 0;
+            for (int c = 0; c < cn; ++c) {
+                diff = std::max(diff, std::abs(src[i + c] - candidate[i + c]));
+            }
+            if (diff <= threshold) {
+                if (stability[x] < 255) {
+                    stability[x]++;
+                }
+            } else {
+                for (int c = 0; c < cn; ++c) {
+                    candidate[i + c] = src[i + c];
+                }
+                stability[x] = 0;
+            }
+            if (stability[x] >= params.minStability) {
+                for (int c = 0; c < cn; ++c) {
+                    bg[i + c] = src[i + c];
+                }
+            }
+        }
+
+        int diff = 0;
+        for (int c = 0; c < cn; ++c) {
+            diff = std::max(diff, std::abs(src[i + c] - bg[i + c]));
+        }
+        const bool foreground = diff > threshold;
+        if (fg) {
+            fg[x] = foreground ? 255 : 0;
+        }
+
+        if (dst) {
+            if (person || (params.hideForeground && foreground)) {
+                for (int c = 0; c < cn; ++c) {
+                    dst[i + c] = bg[i + c];
+                }
+            } else if (dst != src) {
+                for (int c = 0; c < cn; ++c) {
+                    dst[i + c] = src[i + c];
+                }
+            }
+        }
+    }
+}
+
+#if CV_SIMD128
+// Same structure as emaCompositeRowSimd(): 16 pixels per iteration, the tail
+// is left to the scalar implementation. Everything stays in 8-bit lanes.
+template <int CN, bool HasMask, bool HasDst>
+static int cntCompositeRowSimd(const uchar* src, const uchar* mask, uchar* bg, uchar* candidate, uchar* stability,
+                               uchar* fg, uchar* dst, int width, const CntKernelParams& params) {
+    const cv::v_uint8x16 vThreshold = cv::v_setall_u8(static_cast<uchar>(params.threshold));
+    const cv::v_uint8x16 vMinStability = cv::v_setall_u8(static_cast<uchar>(params.minStability));
+    const cv::v_uint8x16 zero = cv::v_setzero_u8();
+    const cv::v_uint8x16 one = cv::v_setall_u8(1);
+    const cv::v_uint8x16 vHide = params.hideForeground ? cv::v_setall_u8(255) : zero;
+
+    int x = 0;
+    for (; x <= width - 16; x += 16) {
+        cv::v_uint8x16 s[CN], c[CN], b[CN];
+        if constexpr (CN == 3) {
+            cv::v_load_deinterleave(src + 3 * x, s[0], s[1], s[2]);
+            cv::v_load_deinterleave(candidate + 3 * x, c[0], c[1], c[2]);
+            cv::v_load_deinterleave(bg + 3 * x, b[0], b[1], b[2]);
+        } else {
+            s[0] = cv::v_load(src + x);
+            c[0] = cv::v_load(candidate + x);
+            b[0] = cv::v_load(bg + x);
+        }
+
+        // All-ones lanes for person pixels, which are not learned
+        cv::v_uint8x16 person = zero;
+        if (HasMask) {
+            person = cv::v_load(mask + x) != zero;
+        }
+        const cv::v_uint8x16 learn = ~person;
+
+        cv::v_uint8x16 diff = cv::v_absdiff(s[0], c[0]);
+        for (int k = 1; k < CN; ++k) {
+            diff = cv::v_max(diff, cv::v_absdiff(s[k], c[k]));
+        }
+        const cv::v_uint8x16 same = diff <= vThreshold;
+        const cv::v_uint8x16 replace = learn & ~same;
+
+        // Saturating increment, or restart with a new candidate
+        cv::v_uint8x16 st = cv::v_load(stability + x);
+        st = cv::v_select(learn, cv::v_select(same, st + one, zero), st);
+        const cv::v_uint8x16 stable = learn & (st >= vMinStability);
+
+        for (int k = 0; k < CN; ++k) {
+            c[k] = cv::v_select(replace, s[k], c[k]);
+            b[k] = cv::v_select(stable, s[k], b[k]);
+        }
+
+        diff = cv::v_absdiff(s[0], b[0]);
+        for (int k = 1; k < CN; ++k) {
+            diff = cv::v_max(diff, cv::v_absdiff(s[k], b[k]));
+        }
+        const cv::v_uint8x16 foreground = diff > vThreshold;
+
+        cv::v_store(stability + x, st);
+        if (fg) {
+            cv::v_store(fg + x, foreground);
+        }
+
+        cv::v_uint8x16 out[CN];
+        if (HasDst) {
+            const cv::v_uint8x16 hide = person | (foreground & vHide);
+            for (int k = 0; k < CN; ++k) {
+                out[k] = cv::v_select(hide, b[k], s[k]);
+            }
+        }
+
+        if constexpr (CN == 3) {
+            cv::v_store_interleave(candidate + 3 * x, c[0], c[1], c[2]);
+            cv::v_store_interleave(bg + 3 * x, b[0], b[1], b[2]);
+            if (HasDst) {
+                cv::v_store_interleave(dst + 3 * x, out[0], out[1], out[2]);
+            }
+        } else {
+            cv::v_store(candidate + x, c[0]);
+            cv::v_store(bg + x, b[0]);
+            if (HasDst) {
+                cv::v_store(dst + x, out[0]);
+            }
+        }
+    }
+    return x;
+}
+
+template <int CN>
+static int cntCompositeRowSimdDispatch(const uchar* src, const uchar* mask, uchar* bg, uchar* candidate,
+                                       uchar* stability, uchar* fg, uchar* dst, int width,
+                                       const CntKernelParams& params) {
+    if (mask) {
+        return dst ? cntCompositeRowSimd<CN, true, true>(src, mask, bg, candidate, stability, fg, dst, width, params)
+                   : cntCompositeRowSimd<CN, true, false>(src, mask, bg, candidate, stability, fg, dst, width, params);
+    }
+    return dst ? cntCompositeRowSimd<CN, false, true>(src, mask, bg, candidate, stability, fg, dst, width, params)
+               : cntCompositeRowSimd<CN, false, false>(src, mask, bg, candidate, stability, fg, dst, width, params);
+}
+#endif
+
+static void cntCompositeRowImpl(const uchar* src, const uchar* mask, uchar* bg, uchar* candidate, uchar* stability,
+                                uchar* fg, uchar* dst, int width, int cn, const CntKernelParams& params,
+                                bool useSimd) {
+    // In place with nothing to hide there is nothing to write back
+    if (dst == src && !mask && !params.hideForeground) {
+        dst = nullptr;
+    }
+
+    int x = 0;
+#if CV_SIMD128
+    if (useSimd) {
+        if (cn == 3) {
+            x = cntCompositeRowSimdDispatch<3>(src, mask, bg, candidate, stability, fg, dst, width, params);
+        } else if (cn == 1) {
+            x = cntCompositeRowSimdDispatch<1>(src, mask, bg, candidate, stability, fg, dst, width, params);
+        }
+    }
+#else
+    (void)useSimd;
+#endif
+
+    if (x < width) {
+        cntCompositeRowScalar(src + x * cn, mask ? mask + x : nullptr, bg + x * cn, candidate + x * cn,
+                              stability + x, fg ? fg + x : nullptr, dst ? dst + x * cn : nullptr,
+                              width - x, cn, params);
+    }
+}
+
+void cntCompositeRow(const uchar* src, const uchar* mask, uchar* bg, uchar* candidate, uchar* stability,
+                     uchar* fg, uchar* dst, int width, int cn, const CntKernelParams& params) {
+    cntCompositeRowImpl(src, mask, bg, candidate, stability, fg, dst, width, cn, params, true);
+}
+
+void cntComposite(const cv::Mat& frame, const cv::Mat& mask, const std::vector<cv::Rect>& regions,
+                  cv::Mat& background, cv::Mat& candidate, cv::Mat& stability, cv::Mat& foreground,
+                  cv::Mat& dst, const CntKernelParams& params, bool useSimd) {
+    CV_Assert(frame.depth() == CV_8U);
+    CV_Assert(background.size() == frame.size() && background.type() == frame.type());
+    CV_Assert(candidate.size() == frame.size() && candidate.type() == frame.type());
+    CV_Assert(stability.size() == frame.size() && stability.type() == CV_8UC1);
+    CV_Assert(mask.empty() || (mask.size() == frame.size() && mask.type() == CV_8UC1));
+
+    dst.create(frame.size(), frame.type());
+    foreground.create(frame.size(), CV_8UC1);
+
+    const int cn = frame.channels();
+    for (int y = 0; y < frame.rows; ++y) {
+        const uchar* src = frame.ptr<uchar>(y);
+        const uchar* m = mask.empty() ? nullptr : mask.ptr<uchar>(y);
+        uchar* b = background.ptr<uchar>(y);
+        uchar* c = candidate.ptr<uchar>(y);
+        uchar* st = stability.ptr<uchar>(y);
+        uchar* fg = foreground.ptr<uchar>(y);
+        uchar* out = dst.ptr<uchar>(y);
+
+        if (!m || regions.empty()) {
+            cntCompositeRowImpl(src, m, b, c, st, fg, out, frame.cols, cn, params, useSimd);
+            continue;
+        }
+        forEachRegionSpan(y, frame.cols, regions, [&](int x, int width, bool inside) {
+            cntCompositeRowImpl(src + x * cn, inside ? m + x : nullptr, b + x * cn, c + x * cn, st + x,
+                                fg + x, out + x * cn, width, cn, params, useSimd);
+        });
+    }
+}
@@ -0,0 +1,143 @@
+#ifndef ANONYMIZER_KERNELS_H
+#define ANONYMIZER_KERNELS_H
+
+#include <cstdint>
+#include <vector>
+#include <opencv2/core.hpp>
+
+/**
+ * @brief Per-pixel kernels shared by the anonymization pipeline
+ *
+ * The kernels work on single rows so that callers can restrict them to
+ * arbitrary spans of the image. The EMA background is stored as a 8.8 fixed
+ * point accumulator (see EmaBackgroundModel), the CNT background as plain
+ * 8-bit images (see CntBackgroundModel).
+ */
+
+/**
+ * @brief Fused masked EMA update and background composite for one row
+ *
+ * Reads every frame, mask and background pixel once and produces, in the same pass:
+ * - where mask is zero: acc = (1 - alpha) * acc + alpha * src (rounded), and dst = src
+ * - where mask is non-zero: acc is left untouched, and dst = acc / 256 (rounded)
+ *
+ * Uses SIMD instructions when available and falls back to
+ * emaCompositeRowScalar() otherwise. Both versions give bit-exact results.
+ *
+ * @param src Frame row (width * cn bytes)
+ * @param mask Person mask row (width bytes), or nullptr if there are no persons in the row
+ * @param acc Background accumulator row (width * cn values), updated in place
+ * @param dst Output row (width * cn bytes). May be equal to src. If nullptr, only acc is updated
+ * @param width Number of pixels in the row
+ * @param cn Number of channels
+ * @param alpha Learning rate in Q16 format [0, 65535]. 0 leaves acc unchanged
+ */
+void emaCompositeRow(const uchar* src, const uchar* mask, uint16_t* acc, uchar* dst,
+                     int width, int cn, uint16_t alpha);
+
+/**
+ * @brief Scalar reference implementation of emaCompositeRow()
+ */
+void emaCompositeRowScalar(const uchar* src, const uchar* mask, uint16_t* acc, uchar* dst,
+                           int width, int cn, uint16_t alpha);
+
+/**
+ * @brief Apply emaCompositeRow() to a whole image
+ *
+ * @param frame Input frame (CV_8UC1 or CV_8UC3)
+ * @param mask Person mask (CV_8UC1), or an empty Mat if there are no persons
+ * @param accumulator Background accumulator (CV_16UC(n)) with the same size as frame
+ * @param dst Output image. Allocated if needed. May share the data of frame
+ * @param alpha Learning rate in Q16 format [0, 65535]. 0 leaves acc unchanged
+ * @param useSimd Use the vectorized implementation if available
+ */
+void emaComposite(const cv::Mat& frame, const cv::Mat& mask, cv::Mat& accumulator, cv::Mat& dst,
+                  uint16_t alpha, bool useSimd = true);
+
+/**
+ * @brief Apply emaCompositeRow() to a whole image, reading the mask only inside some regions
+ *
+ * Pixels outside of the regions are considered free of persons and take the
+ * mask-free path of the kernel. When dst shares the data of frame, that path
+ * only updates the background.
+ *
+ * @param frame Input frame (CV_8UC1 or CV_8UC3)
+ * @param mask Person mask (CV_8UC1). Only read inside the regions
+ * @param regions Non-overlapping rectangles inside the frame, sorted by x
+ * @param accumulator Background accumulator (CV_16UC(n)) with the same size as frame
+ * @param dst Output image. Allocated if needed. May share the data of frame
+ * @param alpha Learning rate in Q16 format [0, 65535]. 0 leaves acc unchanged
+ * @param useSimd Use the vectorized implementation if available
+ */
+void emaCompositeRegions(const cv::Mat& frame, const cv::Mat& mask, const std::vector<cv::Rect>& regions,
+                         cv::Mat& accumulator, cv::Mat& dst, uint16_t alpha, bool useSimd = true);
+
+/**
+ * @brief Settings of the CNT kernels
+ */
+struct CntKernelParams {
+    int threshold;         ///< Largest channel difference between two values of the same pixel
+    int minStability;      ///< Number of stable frames before a value becomes the background
+    bool hideForeground;   ///< Also output the background where the frame is foreground
+};
+
+/**
+ * @brief Fused CNT (pixel stability counting) update and background composite for one row
+ *
+ * Every pixel keeps a candidate value and the number of consecutive frames
+ * the frame stayed within threshold of it. Where mask is zero:
+ * - if the frame is within threshold of the candidate, stability is incremented
+ *   (saturating at 255), otherwise the frame becomes the new candidate and
+ *   stability restarts at 0
+ * - once stability reaches minStability, the frame is copied to the background
+ *
+ * Where mask is non-zero the state is left untouched. Then, for every pixel:
+ * - fg = 255 if any channel differs from the background by more than threshold, else 0
+ * - dst = bg where mask is non-zero (or fg is set and hideForeground is true), src elsewhere
+ *
+ * Differences are the maximum of the channel absolute differences, so the
+ * kernel is integer only. Uses SIMD instructions when available and falls back
+ * to cntCompositeRowScalar() otherwise. Both versions give bit-exact results.
+ *
+ * @param src Frame row (width * cn bytes)
+ * @param mask Person mask row (width bytes), or nullptr if there are no persons in the row
+ * @param bg Background row (width * cn bytes), updated in place
+ * @param candidate Candidate row (width * cn bytes), updated in place
+ * @param stability Stability counter row (width bytes), updated in place
+ * @param fg Foreground output row (width bytes), or nullptr if not needed
+ * @param dst Output row (width * cn bytes). May be equal to src. If nullptr, only the model is updated
+ * @param width Number of pixels in the row
+ * @param cn Number of channels
+ * @param params Kernel settings
+ */
+void cntCompositeRow(const uchar* src, const uchar* mask, uchar* bg, uchar* candidate, uchar* stability,
+                     uchar* fg, uchar* dst, int width, int cn, const CntKernelParams& params);
+
+/**
+ * @brief Scalar reference implementation of cntCompositeRow()
+ */
+void cntCompositeRowScalar(const uchar* src, const uchar* mask, uchar* bg, uchar* candidate, uchar* stability,
+                           uchar* fg, uchar* dst, int width, int cn, const CntKernelParams& params);
+
+/**
+ * @brief Apply cntCompositeRow() to a whole image, reading the mask only inside some regions
+ *
+ * Pixels outside of the regions are considered free of persons. If regions is
+ * empty, the mask (if any) is read everywhere.
+ *
+ * @param frame Input frame (CV_8UC1 or CV_8UC3)
+ * @param mask Person mask (CV_8UC1), or an empty Mat if there are no persons
+ * @param regions Non-overlapping rectangles inside the frame, sorted by x
+ * @param background Background (same type as frame), updated in place
+ * @param candidate Candidate values (same type as frame), updated in place
+ * @param stability Stability counters (CV_8UC1), updated in place
+ * @param foreground Foreground output (CV_8UC1). Allocated if needed
+ * @param dst Output image. Allocated if needed. May share the data of frame
+ * @param params Kernel settings
+ * @param useSimd Use the vectorized implementation if available
+ */
+void cntComposite(const cv::Mat& frame, const cv::Mat& mask, const std::vector<cv::Rect>& regions,
+                  cv::Mat& background, cv::Mat& candidate, cv::Mat& stability, cv::Mat& foreground,
+                  cv::Mat& dst, const CntKernelParams& params, bool useSimd = true);
+
+#endif // ANONYMIZER_KERNELS_H
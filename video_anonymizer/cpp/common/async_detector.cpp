@@ -0,0 +1,104 @@
+#include "async_detector.h"
+#include <iostream>
+
+#include "tracer.h"
+
+#define TAG "AsyncDetector"
+
+AsyncDetector::AsyncDetector(IDetector& detector)
+    : mDetector(detector), mRunning(false), mPendingId(0), mPendingTraceFrame(0), mHasPending(false),
+      mResultId(0), mHasResult(false) {
+}
+
+AsyncDetector::~AsyncDetector() {
+    stop();
+}
+
+void AsyncDetector::start() {
+    if (mRunning.exchange(true)) {
+        return;
+    }
+    mThread = std::thread(&AsyncDetector::workerThread, this);
+}
+
+void AsyncDetector::stop() {
+    if (!mRunning.exchange(false)) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mFrameMutex);
+        mHasPending = false;
+    }
+    mFrameCondition.notify_all();
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+}
+
+bool AsyncDetector::submit(const cv::Mat& frame, uint64_t frameId) {
+    if (!mRunning.load() || frame.empty()) {
+        return false;
+    }
+
+    // Copy outside of the lock, the worker only holds it to swap buffers
+    frame.copyTo(mStaging);
+
+    std::unique_lock<std::mutex> lock(mFrameMutex, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        return false;
+    }
+    // Replaces any frame the worker did not take yet
+    cv::swap(mStaging, mPending);
+    mPendingId = frameId;
+    mPendingTraceFrame = Tracer::currentFrame();
+    mHasPending = true;
+    lock.unlock();
+
+    mFrameCondition.notify_one();
+    return true;
+}
+
+bool AsyncDetector::fetch(std::vector<IDetector::Detection>& detections, uint64_t& frameId) {
+    std::unique_lock<std::mutex> lock(mResultMutex, std::try_to_lock);
+    if (!lock.owns_lock() || !mHasResult) {
+        return false;
+    }
+    detections.swap(mResult);
+    frameId = mResultId;
+    mHasResult = false;
+    return true;
+}
+
+void AsyncDetector::workerThread() {
+    TRACE_THREAD_NAME("detector");
+    while (true) {
+        uint64_t frameId;
+        {
+            TRACE_SCOPE("detector.wait");
+            std::unique_lock<std::mutex> lock(mFrameMutex);
+            mFrameCondition.wait(lock, [this] { return mHasPending || !mRunning.load(); });
+            if (!mRunning.load()) {
+                break;
+            }
+            cv::swap(mPending, mWorking);
+            frameId = mPendingId;
+            TRACE_SET_FRAME(mPendingTraceFrame);
+            mHasPending = false;
+        }
+
+        TRACE_SCOPE("detector.detect");
+        mWorkingDetections.clear();
+        mDetector.setFrameIndex(frameId);
+        if (!mDetector.detect(mWorking, mWorkingDetections)) {
+            std::cerr << TAG << ": Human detection failed on frame " << frameId << std::endl;
+            continue;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mResultMutex);
+            mResult.swap(mWorkingDetections);
+            mResultId = frameId;
+            mHasResult = true;
+        }
+    }
+}
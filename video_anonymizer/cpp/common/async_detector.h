@@ -0,0 +1,103 @@
+#ifndef ASYNC_DETECTOR_H
+#define ASYNC_DETECTOR_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <opencv2/core.hpp>
+
+#include "idetector.h"
+
+/**
+ * @brief Runs a detector on its own worker thread
+ *
+ * The caller submits every frame and the worker always takes the newest one,
+ * so frames submitted while a detection is running are simply replaced.
+ * Results are published with the id of the frame they were computed on, which
+ * lets the caller measure how old the detections are.
+ *
+ * submit() and fetch() never wait for the worker: if the worker holds a lock,
+ * the frame is skipped or the previous result is kept. The frame buffers are
+ * rotated between the caller and the worker, so the steady state does not
+ * allocate.
+ */
+class AsyncDetector {
+public:
+    /**
+     * @brief Constructor
+     *
+     * @param detector Initialized detector. Must outlive this object, and must
+     *                 not be used by anyone else while the worker is running
+     */
+    explicit AsyncDetector(IDetector& detector);
+
+    /**
+     * @brief Destructor. Stops the worker
+     */
+    ~AsyncDetector();
+
+    AsyncDetector(const AsyncDetector&) = delete;
+    AsyncDetector& operator=(const AsyncDetector&) = delete;
+
+    /**
+     * @brief Start the worker thread
+     */
+    void start();
+
+    /**
+     * @brief Stop the worker thread. Waits for the running detection to finish
+     */
+    void stop();
+
+    /**
+     * @brief Hand a frame over to the worker
+     *
+     * The frame is copied, so the caller may modify it afterwards.
+     *
+     * @param frame Input frame
+     * @param frameId Id of the frame, returned with the detections and passed
+     *                to IDetector::setFrameIndex() before detecting
+     * @return true if the frame was queued, false if it was skipped
+     */
+    bool submit(const cv::Mat& frame, uint64_t frameId);
+
+    /**
+     * @brief Get the latest detections if they are newer than the last fetched ones
+     *
+     * @param detections Replaced with the new detections. Left untouched if there are none
+     * @param frameId Id of the frame the detections were computed on
+     * @return true if new detections were returned
+     */
+    bool fetch(std::vector<IDetector::Detection>& detections, uint64_t& frameId);
+
+private:
+    void workerThread();
+
+    IDetector& mDetector;
+    std::thread mThread;
+    std::atomic<bool> mRunning;
+
+    // Caller side copy of the frame, swapped with mPending under mFrameMutex
+    cv::Mat mStaging;
+    cv::Mat mPending;
+    uint64_t mPendingId;
+    uint64_t mPendingTraceFrame;   // Trace id of the pending frame
+    bool mHasPending;
+    std::mutex mFrameMutex;
+    std::condition_variable mFrameCondition;
+
+    // Worker side
+    cv::Mat mWorking;
+    std::vector<IDetector::Detection> mWorkingDetections;
+
+    // Latest published result
+    std::vector<IDetector::Detection> mResult;
+    uint64_t mResultId;
+    bool mHasResult;
+    std::mutex mResultMutex;
+};
+
+#endif // ASYNC_DETECTOR_H
@@ -0,0 +1,28 @@
+#include "background_model_factory.h"
+#include "ema_background_model.h"
+#include "cnt_background_model.h"
+
+std::unique_ptr<IBackgroundModel> BackgroundModelFactory::createBackgroundModel(const Parameters& params) {
+    std::unique_ptr<IBackgroundModel> model;
+    if (params.type == Type::CNT) {
+        CntBackgroundModel::Parameters cntParams;
+        cntParams.threshold = params.cntThreshold;
+        cntParams.minStability = params.cntMinStability;
+        model = std::make_unique<CntBackgroundModel>(cntParams);
+    } else {
+        model = std::make_unique<EmaBackgroundModel>(params.learningRate);
+    }
+    model->setForegroundMasking(params.foregroundMasking);
+    return model;
+}
+
+bool BackgroundModelFactory::parseType(const std::string& name, Type& type) {
+    if (name == "ema") {
+        type = Type::EMA;
+    } else if (name == "cnt") {
+        type = Type::CNT;
+    } else {
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,55 @@
+#ifndef BACKGROUND_MODEL_FACTORY_H
+#define BACKGROUND_MODEL_FACTORY_H
+
+#include <memory>
+#include <string>
+#include "ibackground_model.h"
+
+/**
+ * @brief Factory class for creating the background model selected in the parameters
+ */
+class BackgroundModelFactory {
+public:
+    /// Available background models
+    enum class Type {
+        EMA,   ///< Masked running average (EmaBackgroundModel)
+        CNT    ///< Pixel stability counting (CntBackgroundModel)
+    };
+
+    /**
+     * @brief Parameters for background model creation
+     */
+    struct Parameters {
+        Type type;                 ///< Background model implementation
+        float learningRate;        ///< EMA: weight of the new frame [0.0-1.0]
+        int cntThreshold;          ///< CNT: largest channel difference of a stable pixel [0-255]
+        int cntMinStability;       ///< CNT: number of stable frames before a value becomes the background
+        bool foregroundMasking;    ///< Also hide the foreground pixels, if the model has a foreground
+        // Constructor with default values
+        Parameters()
+            : type(Type::EMA),
+              learningRate(0.2f),
+              cntThreshold(20),
+              cntMinStability(15),
+              foregroundMasking(false) {}
+    };
+
+    /**
+     * @brief Create a background model
+     *
+     * @param params Parameters for the model configuration
+     * @return std::unique_ptr<IBackgroundModel> Background model implementation
+     */
+    static std::unique_ptr<IBackgroundModel> createBackgroundModel(const Parameters& params = Parameters());
+
+    /**
+     * @brief Parse a background model name ("ema" or "cnt")
+     *
+     * @param name Name of the model
+     * @param type Parsed model type
+     * @return true if the name is valid
+     */
+    static bool parseType(const std::string& name, Type& type);
+};
+
+#endif // BACKGROUND_MODEL_FACTORY_H
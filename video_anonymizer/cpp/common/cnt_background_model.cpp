@@ -0,0 +1,107 @@
+#include "cnt_background_model.h"
+#include <algorithm>
+#include <iostream>
+
+CntBackgroundModel::CntBackgroundModel(const Parameters& params) {
+    mKernelParams.threshold = std::min(std::max(params.threshold, 0), 255);
+    mKernelParams.minStability = std::min(std::max(params.minStability, 0), 255);
+    mKernelParams.hideForeground = params.hideForeground;
+}
+
+void CntBackgroundModel::setLearningRate(float) {
+}
+
+void CntBackgroundModel::initialize(const cv::Size& size, int channels, uchar value) {
+    mBackground.create(size, CV_8UC(channels));
+    mBackground.setTo(cv::Scalar::all(value));
+    mBackground.copyTo(mCandidate);
+    mStability.create(size, CV_8UC1);
+    mStability.setTo(cv::Scalar(0));
+    mForeground.create(size, CV_8UC1);
+    mForeground.setTo(cv::Scalar(0));
+}
+
+bool CntBackgroundModel::empty() const {
+    return mBackground.empty();
+}
+
+bool CntBackgroundModel::prepare(const cv::Mat& frame, const cv::Mat& mask) {
+    if (frame.empty() || frame.depth() != CV_8U) {
+        std::cerr << "CntBackgroundModel: unsupported frame type " << frame.type() << std::endl;
+        return false;
+    }
+    if (!mask.empty() && (mask.size() != frame.size() || mask.type() != CV_8UC1)) {
+        std::cerr << "CntBackgroundModel: mask does not match the frame geometry" << std::endl;
+        return false;
+    }
+
+    // (Re)initialize with a grey image if the frame geometry changed
+    if (mBackground.size() != frame.size() || mBackground.channels() != frame.channels()) {
+        initialize(frame.size(), frame.channels());
+    }
+    return true;
+}
+
+void CntBackgroundModel::update(const cv::Mat& frame, const cv::Mat& excludeMask) {
+    if (!prepare(frame, excludeMask)) {
+        return;
+    }
+
+    const int cn = frame.channels();
+    for (int y = 0; y < frame.rows; ++y) {
+        cntCompositeRow(frame.ptr<uchar>(y),
+                        excludeMask.empty() ? nullptr : excludeMask.ptr<uchar>(y),
+                        mBackground.ptr<uchar>(y), mCandidate.ptr<uchar>(y),
+                        mStability.ptr<uchar>(y), mForeground.ptr<uchar>(y),
+                        nullptr, frame.cols, cn, mKernelParams);
+    }
+}
+
+void CntBackgroundModel::updateAndComposite(const cv::Mat& frame, const cv::Mat& mask, cv::Mat& dst) {
+    if (!prepare(frame, mask)) {
+        if (dst.data != frame.data) {
+            frame.copyTo(dst);
+        }
+        return;
+    }
+
+    cntComposite(frame, mask, std::vector<cv::Rect>(), mBackground, mCandidate, mStability,
+                 mForeground, dst, mKernelParams);
+}
+
+void CntBackgroundModel::updateAndComposite(const cv::Mat& frame, const cv::Mat& mask,
+                                            const std::vector<cv::Rect>& regions, cv::Mat& dst) {
+    if (!prepare(frame, mask)) {
+        if (dst.data != frame.data) {
+            frame.copyTo(dst);
+        }
+        return;
+    }
+
+    // Without regions there are no persons
+    cntComposite(frame, regions.empty() ? cv::Mat() : mask, regions, mBackground, mCandidate,
+                 mStability, mForeground, dst, mKernelParams);
+}
+
+const cv::Mat& CntBackgroundModel::getBackground() const {
+    return mBackground;
+}
+
+bool CntBackgroundModel::hasForeground() const {
+    return true;
+}
+
+const cv::Mat& CntBackgroundModel::getForeground() const {
+    return mForeground;
+}
+
+void CntBackgroundModel::setForegroundMasking(bool enable) {
+    mKernelParams.hideForeground = enable;
+}
+
+void CntBackgroundModel::reset() {
+    mBackground.release();
+    mCandidate.release();
+    mStability.release();
+    mForeground.release();
+}
@@ -0,0 +1,90 @@
+#ifndef CNT_BACKGROUND_MODEL_H
+#define CNT_BACKGROUND_MODEL_H
+
+#include <vector>
+#include <opencv2/core.hpp>
+
+#include "ibackground_model.h"
+#include "anonymizer_kernels.h"
+
+/**
+ * @brief Background model based on pixel stability counting (CNT)
+ *
+ * C++ counterpart of the CNT background subtractor of the Python
+ * implementation. A pixel value becomes the background once it stayed
+ * (within a threshold) the same for minStability consecutive frames. The
+ * state is three 8-bit images (background, candidate and stability counter),
+ * and the update only uses 8-bit integer comparisons and selects, which map
+ * directly to SIMD instructions (see cntCompositeRow()).
+ *
+ * Unlike the EMA model, the background does not blend moving objects in, and
+ * every update also produces a foreground mask: the pixels that differ from
+ * the background. It can be used as a backup anonymization mask, to hide
+ * moving persons the detector missed.
+ */
+class CntBackgroundModel : public IBackgroundModel {
+public:
+    /// Grey level used to initialize an empty model
+    static constexpr uchar kInitialValue = 127;
+
+    /**
+     * @brief Model parameters
+     */
+    struct Parameters {
+        int threshold;         ///< Largest channel difference between two values of the same pixel [0-255]
+        int minStability;      ///< Number of stable frames before a value becomes the background [0-255]
+        bool hideForeground;   ///< Also replace the foreground pixels with the background
+        // Constructor with default values
+        Parameters()
+            : threshold(20),
+              minStability(15),
+              hideForeground(false) {}
+    };
+
+    /**
+     * @brief Constructor
+     *
+     * @param params Model parameters
+     */
+    explicit CntBackgroundModel(const Parameters& params = Parameters());
+
+    /**
+     * @brief Ignored, the background follows any value that stays stable long enough
+     */
+    void setLearningRate(float learningRate) override;
+
+    /**
+     * @brief Allocate the model and fill the background with a constant grey level
+     *
+     * The candidates start from the same grey level, so nothing is considered
+     * stable until the scene has been seen for minStability frames.
+     *
+     * @param size Frame size
+     * @param channels Number of channels of the frames
+     * @param value Initial background intensity
+     */
+    void initialize(const cv::Size& size, int channels, uchar value = kInitialValue);
+
+    bool empty() const override;
+    void update(const cv::Mat& frame, const cv::Mat& excludeMask = cv::Mat()) override;
+    void updateAndComposite(const cv::Mat& frame, const cv::Mat& mask, cv::Mat& dst) override;
+    void updateAndComposite(const cv::Mat& frame, const cv::Mat& mask,
+                            const std::vector<cv::Rect>& regions, cv::Mat& dst) override;
+    const cv::Mat& getBackground() const override;
+    bool hasForeground() const override;
+    const cv::Mat& getForeground() const override;
+    void setForegroundMasking(bool enable) override;
+    void reset() override;
+
+private:
+    // Validate the inputs and (re)initialize the model if needed
+    bool prepare(const cv::Mat& frame, const cv::Mat& mask);
+
+    CntKernelParams mKernelParams;
+    cv::Mat mBackground;
+    cv::Mat mCandidate;
+    cv::Mat mStability;
+    cv::Mat mForeground;
+};
+
+#endif // CNT_BACKGROUND_MODEL_H
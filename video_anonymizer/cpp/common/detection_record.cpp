@@ -0,0 +1,407 @@
+#include "detection_record.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+static const char kMagic[4] = {'V', 'A', 'D', 'R'};
+
+// Fixed size fields of a detection, before its mask runs
+static constexpr size_t kDetectionSize = 4 * 4 + 4 + 4 + 2 * 2 + 4;
+// Fixed size fields of the mask union, besides its instances
+static constexpr size_t kUnionSize = 4 + 4 * 4 + 2 * 2 + 4;
+// Frame index, frame size and detection count
+static constexpr size_t kFrameHeaderSize = 8 + 2 * 2 + 4;
+
+static void putU16(std::vector<uint8_t>& out, uint32_t v) {
+    out.push_back(static_cast<uint8_t>(v));
+    out.push_back(static_cast<uint8_t>(v >> 8));
+}
+
+static void putU32(std::vector<uint8_t>& out, uint32_t v) {
+    for (int shift = 0; shift < 32; shift += 8) {
+        out.push_back(static_cast<uint8_t>(v >> shift));
+    }
+}
+
+static void putU64(std::vector<uint8_t>& out, uint64_t v) {
+    putU32(out, static_cast<uint32_t>(v));
+    putU32(out, static_cast<uint32_t>(v >> 32));
+}
+
+static void putFloat(std::vector<uint8_t>& out, float f) {
+    uint32_t v;
+    std::memcpy(&v, &f, sizeof(v));
+    putU32(out, v);
+}
+
+static void setU32(std::vector<uint8_t>& out, size_t offset, uint32_t v) {
+    for (int i = 0; i < 4; ++i) {
+        out[offset + i] = static_cast<uint8_t>(v >> (8 * i));
+    }
+}
+
+static void putVarint(std::vector<uint8_t>& out, uint32_t v) {
+    while (v >= 0x80) {
+        out.push_back(static_cast<uint8_t>(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(v));
+}
+
+// Bounds checked little-endian reader
+class RecordReader {
+public:
+    RecordReader(const uint8_t* data, size_t size) : mPos(data), mEnd(data + size) {}
+
+    bool has(size_t n) const { return static_cast<size_t>(mEnd - mPos) >= n; }
+    const uint8_t* position() const { return mPos; }
+    void skip(size_t n) { mPos += n; }
+
+    uint32_t u16() {
+        const uint32_t v = mPos[0] | (mPos[1] << 8);
+        mPos += 2;
+        return v;
+    }
+    uint32_t u32() {
+        const uint32_t v = static_cast<uint32_t>(mPos[0]) | (static_cast<uint32_t>(mPos[1]) << 8) |
+                           (static_cast<uint32_t>(mPos[2]) << 16) | (static_cast<uint32_t>(mPos[3]) << 24);
+        mPos += 4;
+        return v;
+    }
+    uint64_t u64() {
+        const uint64_t low = u32();
+        return low | (static_cast<uint64_t>(u32()) << 32);
+    }
+    float f32() {
+        const uint32_t v = u32();
+        float f;
+        std::memcpy(&f, &v, sizeof(f));
+        return f;
+    }
+    bool varint(uint32_t& v) {
+        v = 0;
+        for (int shift = 0; shift < 35 && mPos < mEnd; shift += 7) {
+            const uint8_t byte = *mPos++;
+            v |= static_cast<uint32_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    const uint8_t* mPos;
+    const uint8_t* mEnd;
+};
+
+// Lengths of the alternating zero / non-zero runs, starting with zeros
+static void encodeMask(const cv::Mat& mask, std::vector<uint8_t>& out) {
+    bool set = false;
+    uint32_t run = 0;
+    for (int y = 0; y < mask.rows; ++y) {
+        const uchar* row = mask.ptr<uchar>(y);
+        for (int x = 0; x < mask.cols; ++x) {
+            if ((row[x] != 0) != set) {
+                putVarint(out, run);
+                set = !set;
+                run = 0;
+            }
+            ++run;
+        }
+    }
+    // The last run is implied by the mask size
+    if (run > 0) {
+        putVarint(out, run);
+    }
+}
+
+static bool decodeMask(const uint8_t* data, size_t size, int rows, int cols, cv::Mat& mask) {
+    mask.create(rows, cols, CV_8UC1);
+    uchar* pixels = mask.ptr<uchar>();
+    const size_t total = mask.total();
+    RecordReader reader(data, size);
+    size_t filled = 0;
+    bool set = false;
+    while (reader.has(1) && filled < total) {
+        uint32_t run;
+        if (!reader.varint(run) || run > total - filled) {
+            return false;
+        }
+        std::memset(pixels + filled, set ? 255 : 0, run);
+        filled += run;
+        set = !set;
+    }
+    // A missing last run is a run of the remaining pixels
+    std::memset(pixels + filled, set ? 255 : 0, total - filled);
+    return true;
+}
+
+// Mask size and runs. Only 8-bit masks are recorded
+static void putMask(std::vector<uint8_t>& out, const cv::Mat& mask) {
+    const bool hasMask = !mask.empty() && mask.type() == CV_8UC1;
+    putU16(out, hasMask ? static_cast<uint32_t>(mask.cols) : 0);
+    putU16(out, hasMask ? static_cast<uint32_t>(mask.rows) : 0);
+    const size_t runsOffset = out.size();
+    putU32(out, 0);
+    if (hasMask) {
+        encodeMask(mask, out);
+    }
+    setU32(out, runsOffset, static_cast<uint32_t>(out.size() - runsOffset - 4));
+}
+
+static bool readMask(RecordReader& reader, cv::Mat& mask) {
+    const int maskCols = static_cast<int>(reader.u16());
+    const int maskRows = static_cast<int>(reader.u16());
+    const uint32_t runsSize = reader.u32();
+    if (!reader.has(runsSize)) {
+        return false;
+    }
+    if (maskCols > 0 && maskRows > 0 && !decodeMask(reader.position(), runsSize, maskRows, maskCols, mask)) {
+        return false;
+    }
+    reader.skip(runsSize);
+    return true;
+}
+
+static void putRect(std::vector<uint8_t>& out, const cv::Rect& rect) {
+    putU32(out, static_cast<uint32_t>(rect.x));
+    putU32(out, static_cast<uint32_t>(rect.y));
+    putU32(out, static_cast<uint32_t>(rect.width));
+    putU32(out, static_cast<uint32_t>(rect.height));
+}
+
+static cv::Rect readRect(RecordReader& reader) {
+    cv::Rect rect;
+    rect.x = static_cast<int32_t>(reader.u32());
+    rect.y = static_cast<int32_t>(reader.u32());
+    rect.width = static_cast<int32_t>(reader.u32());
+    rect.height = static_cast<int32_t>(reader.u32());
+    return rect;
+}
+
+void DetectionRecord::writeHeader(std::vector<uint8_t>& out) {
+    out.insert(out.end(), kMagic, kMagic + sizeof(kMagic));
+    putU32(out, kVersion);
+}
+
+bool DetectionRecord::checkHeader(const uint8_t* data, size_t size) {
+    if (size < kHeaderSize || std::memcmp(data, kMagic, sizeof(kMagic)) != 0) {
+        return false;
+    }
+    RecordReader reader(data + sizeof(kMagic), size - sizeof(kMagic));
+    return reader.u32() == kVersion;
+}
+
+void DetectionRecord::appendFrame(uint64_t frameIndex, const cv::Size& frameSize,
+                                  const std::vector<IDetector::Detection>& detections,
+                                  const IDetector::MaskUnion& maskUnion, std::vector<uint8_t>& out) {
+    const size_t sizeOffset = out.size();
+    putU32(out, 0);
+    putU64(out, frameIndex);
+    putU16(out, static_cast<uint32_t>(frameSize.width));
+    putU16(out, static_cast<uint32_t>(frameSize.height));
+    putU32(out, static_cast<uint32_t>(detections.size()));
+
+    for (const IDetector::Detection& det : detections) {
+        putRect(out, det.bbox);
+        putFloat(out, det.confidence);
+        putU32(out, static_cast<uint32_t>(det.classId));
+        putMask(out, det.mask);
+    }
+
+    // A union without mask has no instances either
+    const bool hasUnion = !maskUnion.mask.empty() && maskUnion.mask.type() == CV_8UC1;
+    putU32(out, hasUnion ? static_cast<uint32_t>(maskUnion.instances.size()) : 0);
+    if (hasUnion) {
+        for (int instance : maskUnion.instances) {
+            putU32(out, static_cast<uint32_t>(instance));
+        }
+    }
+    putRect(out, hasUnion ? maskUnion.bbox : cv::Rect());
+    putMask(out, hasUnion ? maskUnion.mask : cv::Mat());
+    setU32(out, sizeOffset, static_cast<uint32_t>(out.size() - sizeOffset - 4));
+}
+
+std::vector<DetectionRecord::Entry> DetectionRecord::indexFrames(const uint8_t* data, size_t size) {
+    std::vector<Entry> entries;
+    if (!checkHeader(data, size)) {
+        return entries;
+    }
+    size_t offset = kHeaderSize;
+    while (size - offset >= 4) {
+        RecordReader reader(data + offset, size - offset);
+        const uint32_t recordSize = reader.u32();
+        if (!reader.has(recordSize) || recordSize < kFrameHeaderSize) {
+            break;   // Truncated last record
+        }
+        entries.push_back(Entry{offset, reader.u64()});
+        offset += 4 + recordSize;
+    }
+    return entries;
+}
+
+bool DetectionRecord::readFrame(const uint8_t* data, size_t size, size_t offset, cv::Size& frameSize,
+                                std::vector<IDetector::Detection>& detections, IDetector::MaskUnion& maskUnion) {
+    detections.clear();
+    maskUnion = IDetector::MaskUnion();
+    if (offset > size || size - offset < 4) {
+        return false;
+    }
+    RecordReader record(data + offset, size - offset);
+    const uint32_t recordSize = record.u32();
+    if (!record.has(recordSize) || recordSize < kFrameHeaderSize) {
+        return false;
+    }
+
+    RecordReader reader(record.position(), recordSize);
+    reader.skip(8);   // Frame index, see indexFrames()
+    frameSize.width = static_cast<int>(reader.u16());
+    frameSize.height = static_cast<int>(reader.u16());
+    const uint32_t count = reader.u32();
+
+    detections.reserve(std::min<size_t>(count, recordSize / kDetectionSize));
+    for (uint32_t i = 0; i < count; ++i) {
+        if (!reader.has(kDetectionSize)) {
+            return false;
+        }
+        IDetector::Detection det;
+        det.bbox = readRect(reader);
+        det.confidence = reader.f32();
+        det.classId = static_cast<int32_t>(reader.u32());
+        if (!readMask(reader, det.mask)) {
+            return false;
+        }
+        detections.push_back(det);
+    }
+
+    if (!reader.has(4)) {
+        return false;
+    }
+    const uint32_t instances = reader.u32();
+    if (instances > count || !reader.has(static_cast<size_t>(instances) * 4 + kUnionSize - 4)) {
+        return false;
+    }
+    maskUnion.instances.reserve(instances);
+    for (uint32_t i = 0; i < instances; ++i) {
+        const uint32_t instance = reader.u32();
+        if (instance >= count || (i > 0 && instance <= static_cast<uint32_t>(maskUnion.instances.back()))) {
+            return false;   // Must be sorted indices of the detections
+        }
+        maskUnion.instances.push_back(static_cast<int>(instance));
+    }
+    maskUnion.bbox = readRect(reader);
+    if (!readMask(reader, maskUnion.mask)) {
+        return false;
+    }
+    if (maskUnion.mask.empty()) {
+        maskUnion = IDetector::MaskUnion();
+    }
+    return true;
+}
+
+// Parse "[n, n, ...]" at text, return the position after the closing bracket
+static const char* parseNumbers(const char* text, std::vector<double>& values) {
+    values.clear();
+    while (*text == ' ') {
+        ++text;
+    }
+    if (*text != '[') {
+        return nullptr;
+    }
+    ++text;
+    for (;;) {
+        while (*text == ' ' || *text == ',') {
+            ++text;
+        }
+        if (*text == ']') {
+            return text + 1;
+        }
+        char* end;
+        const double value = std::strtod(text, &end);
+        if (end == text) {
+            return nullptr;
+        }
+        values.push_back(value);
+        text = end;
+    }
+}
+
+// Position of the value of a key in a JSON line, nullptr if missing
+static const char* findValue(const std::string& line, const char* key) {
+    const size_t pos = line.find(key);
+    if (pos == std::string::npos) {
+        return nullptr;
+    }
+    const size_t colon = line.find(':', pos + std::strlen(key));
+    return colon == std::string::npos ? nullptr : line.c_str() + colon + 1;
+}
+
+bool DetectionRecord::importSscmaLog(const std::string& path, std::vector<uint8_t>& recording) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    recording.clear();
+    writeHeader(recording);
+    size_t frames = 0;
+    std::string line;
+    std::vector<double> values;
+    std::vector<IDetector::Detection> detections;
+    while (std::getline(file, line)) {
+        if (line.find("\"invoke\"") == std::string::npos) {
+            continue;
+        }
+        const char* boxes = findValue(line, "\"boxes\"");
+        if (!boxes) {
+            continue;
+        }
+
+        // Boxes are at the model resolution
+        cv::Size frameSize(640, 640);
+        const char* resolution = findValue(line, "\"resolution\"");
+        if (resolution && parseNumbers(resolution, values) && values.size() == 2) {
+            frameSize = cv::Size(static_cast<int>(values[0]), static_cast<int>(values[1]));
+        }
+
+        // "boxes":[[cx,cy,w,h,score,class],...]
+        detections.clear();
+        const char* p = boxes;
+        while (*p == ' ') {
+            ++p;
+        }
+        if (*p != '[') {
+            continue;
+        }
+        ++p;
+        bool valid = true;
+        for (;;) {
+            while (*p == ' ' || *p == ',') {
+                ++p;
+            }
+            if (*p == ']') {
+                break;
+            }
+            p = parseNumbers(p, values);
+            if (!p || values.size() < 6) {
+                valid = false;
+                break;
+            }
+            const double w = values[2];
+            const double h = values[3];
+            IDetector::Detection det(cv::Rect(cvRound(values[0] - w / 2), cvRound(values[1] - h / 2),
+                                              cvRound(w), cvRound(h)),
+                                     static_cast<float>(values[4] / 100.0), static_cast<int>(values[5]));
+            detections.push_back(det);
+        }
+        if (!valid) {
+            continue;
+        }
+
+        appendFrame(frames, frameSize, detections, IDetector::MaskUnion(), recording);
+        ++frames;
+    }
+    return frames > 0;
+}
@@ -0,0 +1,116 @@
+#ifndef DETECTION_RECORD_H
+#define DETECTION_RECORD_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <opencv2/core.hpp>
+
+#include "idetector.h"
+
+/**
+ * @brief File format of the recorded detections
+ *
+ * A recording is an 8 byte header ("VADR" and the format version) followed
+ * by one record per detector run:
+ *
+ *     uint32 size of the rest of the record
+ *     uint64 index of the frame the detector ran on
+ *     uint16 frame width, uint16 frame height, uint32 detection count
+ *     per detection:
+ *         int32 x, y, width, height; float confidence; int32 class id;
+ *         uint16 mask width, uint16 mask height;
+ *         uint32 size of the mask runs; mask runs
+ *     union of the person masks (see IDetector::MaskUnion), without
+ *     instances if the detector returned none:
+ *         uint32 instance count; int32 detection index per instance;
+ *         int32 x, y, width, height; uint16 mask width, uint16 mask height;
+ *         uint32 size of the mask runs; mask runs
+ *
+ * Numbers are little-endian. Masks are binary and run-length encoded: the
+ * lengths of the alternating runs of zero and non-zero pixels (row-major,
+ * starting with zeros) as LEB128 varints. A person mask usually takes a few
+ * hundred bytes.
+ *
+ * Records are appended as the detector runs, so a recording stopped abruptly
+ * is still readable up to its last complete record.
+ */
+class DetectionRecord {
+public:
+    static constexpr uint32_t kVersion = 4;
+    static constexpr size_t kHeaderSize = 8;
+
+    /**
+     * @brief Position of a record in a recording
+     */
+    struct Entry {
+        size_t offset;          ///< Offset of the record
+        uint64_t frameIndex;    ///< Index of the frame the detector ran on
+    };
+
+    /**
+     * @brief Append the file header
+     */
+    static void writeHeader(std::vector<uint8_t>& out);
+
+    /**
+     * @brief Check the file header
+     *
+     * @return true if the data starts with the header of a supported version
+     */
+    static bool checkHeader(const uint8_t* data, size_t size);
+
+    /**
+     * @brief Append the record of one detector run
+     *
+     * @param frameIndex Index of the frame the detections were computed on
+     * @param frameSize Size of the frame the detections were computed on
+     * @param detections Detections of the frame
+     * @param maskUnion Union of the person masks of the detections, empty if none
+     * @param out Buffer the record is appended to
+     */
+    static void appendFrame(uint64_t frameIndex, const cv::Size& frameSize,
+                            const std::vector<IDetector::Detection>& detections,
+                            const IDetector::MaskUnion& maskUnion, std::vector<uint8_t>& out);
+
+    /**
+     * @brief Find the records of a recording
+     *
+     * @param data Recording, header included
+     * @param size Size of the recording
+     * @return std::vector<Entry> Every complete record, in file order
+     */
+    static std::vector<Entry> indexFrames(const uint8_t* data, size_t size);
+
+    /**
+     * @brief Decode a record
+     *
+     * @param data Recording
+     * @param size Size of the recording
+     * @param offset Offset of the record, from indexFrames()
+     * @param frameSize Size of the frame the detections were computed on
+     * @param detections Replaced with the detections of the record
+     * @param maskUnion Replaced with the union of the person masks of the record
+     * @return true if the record is valid
+     */
+    static bool readFrame(const uint8_t* data, size_t size, size_t offset, cv::Size& frameSize,
+                          std::vector<IDetector::Detection>& detections, IDetector::MaskUnion& maskUnion);
+
+    /**
+     * @brief Convert an SSCMA detection log to a recording
+     *
+     * Reads the JSON lines written by the reCamera inference node (the
+     * recamera_detections.log files of simple-tracker-tests): one "invoke"
+     * message per frame, with boxes [center x, center y, width, height,
+     * score in percent, class] at the model resolution. The messages are
+     * numbered as consecutive frames from 0. The recording has no masks.
+     *
+     * @param path Path of the log
+     * @param recording Replaced with the recording, header included
+     * @return true if at least one frame was read
+     */
+    static bool importSscmaLog(const std::string& path, std::vector<uint8_t>& recording);
+};
+
+#endif // DETECTION_RECORD_H
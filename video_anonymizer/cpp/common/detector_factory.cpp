@@ -1,4 +1,6 @@
 #include "detector_factory.h"
+#include "recording_detector.h"
+#include "replay_detector.h"
 
 // Include platform-specific implementations
 #ifdef TARGET_RECAMERA
@@ -8,15 +10,25 @@
 #endif
 
 std::unique_ptr<IDetector> DetectorFactory::createDetector(const Parameters& params) {
+    if (!params.replayPath.empty()) {
+        return std::make_unique<ReplayDetector>(params.replayPath, params.labelsPath, params.replayLoop);
+    }
+
+    std::unique_ptr<IDetector> detector;
 #ifdef TARGET_RECAMERA
     // Create RecameraDetector for ReCamera platform
-    return std::make_unique<RecameraDetector>(
+    detector = std::make_unique<RecameraDetector>(
         params.modelPath.empty() ? "yolo11n-seg.cvimodel" : params.modelPath,
         params.labelsPath,
         params.confidenceThreshold
     );
 #else
     // Create YolosCppDetector for x86_64 platform
-    return std::make_unique<YolosCppDetector>(params);
+    detector = std::make_unique<YolosCppDetector>(params);
 #endif
+
+    if (!params.recordPath.empty()) {
+        return std::make_unique<RecordingDetector>(std::move(detector), params.recordPath);
+    }
+    return detector;
 }
@@ -24,6 +24,9 @@ public:
         float iouThreshold;            ///< IoU threshold for NMS [0.0-1.0]
         bool useGPU;                   ///< Whether to use GPU for inference (if available)
         bool debugMode;                ///< Whether to enable debug mode
+        std::string recordPath;        ///< Record the detections to this file (if not empty)
+        std::string replayPath;        ///< Replay the detections of this recording instead of running a model (if not empty)
+        bool replayLoop;               ///< Start the replay over after its last frame instead of failing (benchmarks)
         // Constructor with default values
         Parameters() 
             : modelPath(""),
@@ -31,7 +34,10 @@ public:
               confidenceThreshold(0.5f),
               iouThreshold(0.45f),
               useGPU(false),
-              debugMode(false) {}
+              debugMode(false),
+              recordPath(""),
+              replayPath(""),
+              replayLoop(false) {}
     };
     
     /**
@@ -40,6 +46,10 @@ public:
      * Will create the appropriate detector implementation based on the current platform:
      * - On ReCamera (TARGET_RECAMERA defined): Creates a RecameraDetector
      * - Otherwise: Creates a YolosCppDetector
+     *
+     * With replayPath set, creates a ReplayDetector instead, on any platform.
+     * With recordPath set, the platform detector is wrapped in a
+     * RecordingDetector.
      * 
      * @param params Parameters for the detector configuration
      * @return std::unique_ptr<IDetector> Platform-specific detector implementation
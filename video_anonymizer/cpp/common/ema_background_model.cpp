@@ -0,0 +1,137 @@
+#include "ema_background_model.h"
+#include "anonymizer_kernels.h"
+#include <algorithm>
+#include <iostream>
+
+EmaBackgroundModel::EmaBackgroundModel(float learningRate)
+    : mBackgroundDirty(true), mLearningRate(0.0f), mAlpha(1) {
+    setLearningRate(learningRate);
+}
+
+void EmaBackgroundModel::setLearningRate(float learningRate) {
+    mLearningRate = std::min(std::max(learningRate, 0.0f), 1.0f);
+    // Keep alpha in [0, 65535] so that both weights fit in 16 bits. Only a
+    // learning rate of 0 gives 0, which freezes the background.
+    int alpha = static_cast<int>(mLearningRate * 65536.0f + 0.5f);
+    mAlpha = static_cast<uint16_t>(std::min(std::max(alpha, mLearningRate > 0.0f ? 1 : 0), 65535));
+}
+
+float EmaBackgroundModel::getLearningRate() const {
+    return mLearningRate;
+}
+
+uint16_t EmaBackgroundModel::getAlpha() const {
+    return mAlpha;
+}
+
+void EmaBackgroundModel::initialize(const cv::Size& size, int channels, uchar value) {
+    mAccumulator.create(size, CV_16UC(channels));
+    mAccumulator.setTo(cv::Scalar::all(value << kFractionBits));
+    mBackgroundDirty = true;
+}
+
+bool EmaBackgroundModel::empty() const {
+    return mAccumulator.empty();
+}
+
+bool EmaBackgroundModel::prepare(const cv::Mat& frame, const cv::Mat& mask) {
+    if (frame.empty() || frame.depth() != CV_8U) {
+        std::cerr << "EmaBackgroundModel: unsupported frame type " << frame.type() << std::endl;
+        return false;
+    }
+    if (!mask.empty() && (mask.size() != frame.size() || mask.type() != CV_8UC1)) {
+        std::cerr << "EmaBackgroundModel: mask does not match the frame geometry" << std::endl;
+        return false;
+    }
+
+    // (Re)initialize with a grey image if the frame geometry changed
+    if (mAccumulator.size() != frame.size() || mAccumulator.channels() != frame.channels()) {
+        initialize(frame.size(), frame.channels());
+    }
+    return true;
+}
+
+void EmaBackgroundModel::update(const cv::Mat& frame, const cv::Mat& excludeMask) {
+    if (!prepare(frame, excludeMask)) {
+        return;
+    }
+
+    for (int y = 0; y < frame.rows; ++y) {
+        emaCompositeRow(frame.ptr<uchar>(y),
+                        excludeMask.empty() ? nullptr : excludeMask.ptr<uchar>(y),
+                        mAccumulator.ptr<uint16_t>(y),
+                        nullptr, frame.cols, frame.channels(), mAlpha);
+    }
+
+    mBackgroundDirty = true;
+}
+
+void EmaBackgroundModel::updateAndComposite(const cv::Mat& frame, const cv::Mat& mask, cv::Mat& dst) {
+    if (!prepare(frame, mask)) {
+        if (dst.data != frame.data) {
+            frame.copyTo(dst);
+        }
+        return;
+    }
+
+    emaComposite(frame, mask, mAccumulator, dst, mAlpha);
+    mBackgroundDirty = true;
+}
+
+void EmaBackgroundModel::updateAndComposite(const cv::Mat& frame, const cv::Mat& mask,
+                                            const std::vector<cv::Rect>& regions, cv::Mat& dst) {
+    if (!prepare(frame, mask)) {
+        if (dst.data != frame.data) {
+            frame.copyTo(dst);
+        }
+        return;
+    }
+
+    emaCompositeRegions(frame, mask, regions, mAccumulator, dst, mAlpha);
+    mBackgroundDirty = true;
+}
+
+const cv::Mat& EmaBackgroundModel::getBackground() const {
+    if (mAccumulator.empty()) {
+        mBackground.release();
+    } else if (mBackgroundDirty) {
+        // Rounds half up, like the composite kernels (convertTo would round
+        // half to even). The buffer is reused between calls.
+        mBackground.create(mAccumulator.size(), CV_8UC(mAccumulator.channels()));
+        const int values = mAccumulator.cols * mAccumulator.channels();
+        for (int y = 0; y < mAccumulator.rows; ++y) {
+            const uint16_t* acc = mAccumulator.ptr<uint16_t>(y);
+            uchar* out = mBackground.ptr<uchar>(y);
+            for (int i = 0; i < values; ++i) {
+                out[i] = static_cast<uchar>((acc[i] + (1 << (kFractionBits - 1))) >> kFractionBits);
+            }
+        }
+        mBackgroundDirty = false;
+    }
+    return mBackground;
+}
+
+cv::Mat& EmaBackgroundModel::getAccumulator() {
+    return mAccumulator;
+}
+
+void EmaBackgroundModel::markModified() {
+    mBackgroundDirty = true;
+}
+
+bool EmaBackgroundModel::hasForeground() const {
+    return false;
+}
+
+const cv::Mat& EmaBackgroundModel::getForeground() const {
+    return mForeground;
+}
+
+void EmaBackgroundModel::setForegroundMasking(bool) {
+}
+
+void EmaBackgroundModel::reset() {
+    mAccumulator.release();
+    mBackground.release();
+    mBackgroundDirty = true;
+}
@@ -0,0 +1,157 @@
+#ifndef EMA_BACKGROUND_MODEL_H
+#define EMA_BACKGROUND_MODEL_H
+
+#include <cstdint>
+#include <vector>
+#include <opencv2/core.hpp>
+
+#include "ibackground_model.h"
+
+/**
+ * @brief Masked running average (EMA) background model stored in fixed point
+ *
+ * The model is kept in its own accumulator format, a CV_16UC(n) image holding
+ * the background intensity multiplied by 256 (8.8 fixed point). Every update
+ * modifies the accumulator in place with integer arithmetic, so no temporary
+ * floating point images are created per frame. The 8-bit background image is
+ * only produced when it is requested through getBackground().
+ *
+ * The model has no foreground output.
+ */
+class EmaBackgroundModel : public IBackgroundModel {
+public:
+    /// Number of fractional bits of the accumulator
+    static constexpr int kFractionBits = 8;
+
+    /// Grey level used to initialize an empty model
+    static constexpr uchar kInitialValue = 127;
+
+    /**
+     * @brief Constructor
+     *
+     * @param learningRate Weight of the new frame in the running average [0.0-1.0]
+     */
+    explicit EmaBackgroundModel(float learningRate = 0.2f);
+
+    /**
+     * @brief Set the learning rate of the running average
+     *
+     * @param learningRate Weight of the new frame [0.0-1.0]
+     */
+    void setLearningRate(float learningRate) override;
+
+    /**
+     * @brief Get the learning rate of the running average
+     *
+     * @return float Current learning rate
+     */
+    float getLearningRate() const;
+
+    /**
+     * @brief Get the learning rate in the Q16 format used by the update kernel
+     *
+     * @return uint16_t Learning rate multiplied by 65536, clamped to [0, 65535].
+     *         0 only for a learning rate of 0, which freezes the background
+     */
+    uint16_t getAlpha() const;
+
+    /**
+     * @brief Allocate the accumulator and fill it with a constant grey level
+     *
+     * @param size Frame size
+     * @param channels Number of channels of the frames
+     * @param value Initial background intensity
+     */
+    void initialize(const cv::Size& size, int channels, uchar value = kInitialValue);
+
+    /**
+     * @brief Check whether the model has been initialized
+     *
+     * @return true if there is no background yet
+     */
+    bool empty() const override;
+
+    /**
+     * @brief Update the background with a new frame
+     *
+     * For every pixel where excludeMask is zero: bg = (1 - alpha) * bg + alpha * frame.
+     * Pixels where excludeMask is non-zero keep their previous value.
+     * The model is (re)initialized if the frame geometry changes.
+     *
+     * @param frame Input frame (CV_8UC1 or CV_8UC3)
+     * @param excludeMask Optional CV_8UC1 mask of pixels that must not be learned
+     */
+    void update(const cv::Mat& frame, const cv::Mat& excludeMask = cv::Mat()) override;
+
+    /**
+     * @brief Update the background and replace the masked pixels in a single pass
+     *
+     * Equivalent to update(frame, mask) followed by copying the background into
+     * dst where mask is non-zero and the frame elsewhere, but every pixel of
+     * frame, mask and background is only read once.
+     *
+     * @param frame Input frame (CV_8UC1 or CV_8UC3)
+     * @param mask CV_8UC1 mask of person pixels, or an empty Mat if there are none
+     * @param dst Anonymized output. Allocated if needed. May be the same Mat as frame
+     */
+    void updateAndComposite(const cv::Mat& frame, const cv::Mat& mask, cv::Mat& dst) override;
+
+    /**
+     * @brief Same as updateAndComposite(), with the persons restricted to some regions
+     *
+     * The mask is only read inside the regions. Everywhere else the frame is
+     * learned and copied to dst (nothing is copied if dst shares the data of frame).
+     *
+     * @param frame Input frame (CV_8UC1 or CV_8UC3)
+     * @param mask CV_8UC1 mask of person pixels, or an empty Mat if there are none
+     * @param regions Non-overlapping rectangles containing all the person pixels, sorted by x
+     * @param dst Anonymized output. Allocated if needed. May be the same Mat as frame
+     */
+    void updateAndComposite(const cv::Mat& frame, const cv::Mat& mask,
+                            const std::vector<cv::Rect>& regions, cv::Mat& dst) override;
+
+    /**
+     * @brief Get the 8-bit background image
+     *
+     * The conversion from the accumulator only happens if the model changed
+     * since the last call. It rounds like the composite kernels, so the
+     * image matches the pixels they output.
+     *
+     * @return const cv::Mat& Background image with the same type as the frames
+     */
+    const cv::Mat& getBackground() const override;
+
+    /**
+     * @brief Get the raw fixed point accumulator
+     *
+     * @return cv::Mat& CV_16UC(n) image with the background multiplied by 256
+     */
+    cv::Mat& getAccumulator();
+
+    /**
+     * @brief Mark the 8-bit view as outdated after modifying the accumulator directly
+     */
+    void markModified();
+
+    bool hasForeground() const override;
+    const cv::Mat& getForeground() const override;
+    void setForegroundMasking(bool enable) override;
+
+    /**
+     * @brief Release the model
+     */
+    void reset() override;
+
+private:
+    // Validate the inputs and (re)initialize the accumulator if needed
+    bool prepare(const cv::Mat& frame, const cv::Mat& mask);
+
+    cv::Mat mAccumulator;
+    mutable cv::Mat mBackground;
+    mutable bool mBackgroundDirty;
+    cv::Mat mForeground;   // Always empty
+    float mLearningRate;
+    uint16_t mAlpha;
+};
+
+#endif // EMA_BACKGROUND_MODEL_H
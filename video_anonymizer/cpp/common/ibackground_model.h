@@ -0,0 +1,110 @@
+#ifndef IBACKGROUND_MODEL_H
+#define IBACKGROUND_MODEL_H
+
+#include <vector>
+#include <opencv2/core.hpp>
+
+/**
+ * @brief Interface for the background models of the Video Anonymizer
+ *
+ * A background model learns the static scene from the pixels that are not
+ * covered by persons, and provides the background used to replace them.
+ * Implementations update their state incrementally, one frame at a time,
+ * and fuse the update with the composition of the anonymized output.
+ *
+ * Some models also classify the pixels of every frame as background or
+ * foreground. Their foreground may be used as a backup mask, to hide moving
+ * objects that the detector missed.
+ */
+class IBackgroundModel {
+public:
+    /**
+     * @brief Virtual destructor
+     */
+    virtual ~IBackgroundModel() = default;
+
+    /**
+     * @brief Set the learning rate of the model
+     *
+     * Models whose update does not depend on a rate ignore it.
+     *
+     * @param learningRate Weight of the new frame [0.0-1.0]
+     */
+    virtual void setLearningRate(float learningRate) = 0;
+
+    /**
+     * @brief Check whether the model has been initialized
+     *
+     * @return true if there is no background yet
+     */
+    virtual bool empty() const = 0;
+
+    /**
+     * @brief Update the background with a new frame
+     *
+     * Pixels where excludeMask is non-zero are not learned. The model is
+     * (re)initialized if the frame geometry changes.
+     *
+     * @param frame Input frame (CV_8UC1 or CV_8UC3)
+     * @param excludeMask Optional CV_8UC1 mask of pixels that must not be learned
+     */
+    virtual void update(const cv::Mat& frame, const cv::Mat& excludeMask = cv::Mat()) = 0;
+
+    /**
+     * @brief Update the background and replace the masked pixels in a single pass
+     *
+     * @param frame Input frame (CV_8UC1 or CV_8UC3)
+     * @param mask CV_8UC1 mask of person pixels, or an empty Mat if there are none
+     * @param dst Anonymized output. Allocated if needed. May be the same Mat as frame
+     */
+    virtual void updateAndComposite(const cv::Mat& frame, const cv::Mat& mask, cv::Mat& dst) = 0;
+
+    /**
+     * @brief Same as updateAndComposite(), with the persons restricted to some regions
+     *
+     * @param frame Input frame (CV_8UC1 or CV_8UC3)
+     * @param mask CV_8UC1 mask of person pixels, only read inside the regions
+     * @param regions Non-overlapping rectangles containing all the person pixels, sorted by x
+     * @param dst Anonymized output. Allocated if needed. May be the same Mat as frame
+     */
+    virtual void updateAndComposite(const cv::Mat& frame, const cv::Mat& mask,
+                                    const std::vector<cv::Rect>& regions, cv::Mat& dst) = 0;
+
+    /**
+     * @brief Get the 8-bit background image
+     *
+     * @return const cv::Mat& Background image with the same type as the frames
+     */
+    virtual const cv::Mat& getBackground() const = 0;
+
+    /**
+     * @brief Check whether the model computes a foreground mask
+     *
+     * @return true if getForeground() and setForegroundMasking() are supported
+     */
+    virtual bool hasForeground() const = 0;
+
+    /**
+     * @brief Get the foreground of the last update
+     *
+     * @return const cv::Mat& CV_8UC1 mask, 255 where the frame differs from the
+     *         background. Empty if the model has no foreground
+     */
+    virtual const cv::Mat& getForeground() const = 0;
+
+    /**
+     * @brief Also replace the foreground pixels in updateAndComposite()
+     *
+     * Ignored by models without foreground.
+     *
+     * @param enable Use the foreground as a backup mask
+     */
+    virtual void setForegroundMasking(bool enable) = 0;
+
+    /**
+     * @brief Release the model
+     */
+    virtual void reset() = 0;
+};
+
+#endif // IBACKGROUND_MODEL_H
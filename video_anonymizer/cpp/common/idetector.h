@@ -1,6 +1,7 @@
 #ifndef IDETECTOR_H
 #define IDETECTOR_H
 
+#include <cstdint>
 #include <vector>
 #include <opencv2/core.hpp>
 #include <string>
@@ -16,12 +17,17 @@ class IDetector {
 public:
     /**
      * @brief Detection result structure representing a detected object
+     *
+     * The mask only covers the bounding box, so its memory does not depend on
+     * the frame size. It may be computed at a lower resolution than the frame:
+     * users stretch it to the box. Masks covering the whole frame are still
+     * accepted by the pipeline.
      */
     struct Detection {
         cv::Rect bbox;         ///< Bounding box in pixel coordinates
         float confidence;      ///< Detection confidence [0-1]
         int classId;           ///< Class ID (0 = person in COCO)
-        cv::Mat mask;          ///< Segmentation mask (if available)
+        cv::Mat mask;          ///< Segmentation mask (if available), covering bbox only. Stretched to bbox when used
         
         // Default constructor
         Detection() : bbox(), confidence(0.0f), classId(-1), mask() {}
@@ -31,6 +37,22 @@ public:
             : bbox(bbox), confidence(confidence), classId(classId), mask() {}
     };
     
+    /**
+     * @brief Union of the person masks of one detector run
+     *
+     * Lets a detector return a single mask for all the persons at its native
+     * mask resolution, instead of one mask per person. The mask covers bbox
+     * and is stretched to it when used, like Detection::mask.
+     */
+    struct MaskUnion {
+        cv::Mat mask;          ///< Union of the person masks covering bbox (empty if not available)
+        cv::Rect bbox;         ///< Area of the frame covered by mask, in pixel coordinates
+        std::vector<int> instances;   ///< Sorted indices of the detections whose mask is in the union (their own mask is empty)
+
+        // Default constructor
+        MaskUnion() : mask(), bbox(), instances() {}
+    };
+
     /**
      * @brief Virtual destructor
      */
@@ -47,6 +69,19 @@ public:
      */
     virtual bool initialize() = 0;
     
+    /**
+     * @brief Set the index of the frame the next detection runs on
+     *
+     * Called before detect() with the index of the frame in the stream, on
+     * the thread running the detection. Lets the detections be recorded and
+     * replayed frame by frame. Ignored by default.
+     *
+     * @param frameIndex Index of the frame, from 0
+     */
+    virtual void setFrameIndex(uint64_t frameIndex) {
+        (void)frameIndex;
+    }
+
     /**
      * @brief Detect objects in an image
      * 
@@ -57,6 +92,26 @@ public:
      */
     virtual bool detect(const cv::Mat& img, 
                         std::vector<Detection>& detections) = 0;
+
+    /**
+     * @brief Detect objects, returning the union of the person masks
+     *
+     * The person detections only carry their metadata (box, confidence,
+     * class), their masks are ORed into maskUnion. The default implementation
+     * calls detect() and leaves maskUnion empty, so that the detections keep
+     * their own masks.
+     *
+     * @param img Input image (BGR format)
+     * @param detections Output vector of detected objects
+     * @param maskUnion Union of the person masks
+     * @return true if detection succeeded
+     * @return false if detection failed
+     */
+    virtual bool detectWithMaskUnion(const cv::Mat& img, std::vector<Detection>& detections,
+                                     MaskUnion& maskUnion) {
+        maskUnion = MaskUnion();
+        return detect(img, detections);
+    }
     
     /**
      * @brief Get the input size required by the model
@@ -0,0 +1,273 @@
+#include "logger.h"
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+#ifdef __linux__
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Writer wake-up period when no warning or error arrives
+static constexpr std::chrono::milliseconds kWriterPeriod(50);
+// Period of the "repeated" summaries of collapsed messages
+static constexpr int64_t kRepeatSummaryMs = 1000;
+
+// Sequence-numbered slot of the ring (bounded queue of D. Vyukov): a slot is
+// free for position p when its sequence is p, and holds the message of
+// position p when its sequence is p + 1
+struct Logger::Slot {
+    std::atomic<size_t> sequence;
+    LogLevel level;
+    const char* tag;
+    int64_t timeMs;
+    size_t length;
+    char text[kMaxMessageLength];
+};
+
+static_assert((Logger::kCapacity & (Logger::kCapacity - 1)) == 0, "Logger capacity must be a power of 2");
+
+Logger& Logger::instance() {
+    static Logger logger;
+    return logger;
+}
+
+Logger::Logger()
+    : mStart(std::chrono::steady_clock::now()),
+      mSlots(new Slot[kCapacity]),
+      mTail(0),
+      mHead(0),
+      mLevel(LOG_MIN_LEVEL),
+      mDropped(0),
+      mLastLevel(LogLevel::NONE),
+      mLastTag(nullptr),
+      mLastLength(0),
+      mLastTimeMs(0),
+      mRepeats(0),
+      mRepeatsSinceMs(0),
+      mReportedDropped(0),
+      mRunning(true) {
+    for (size_t i = 0; i < kCapacity; ++i) {
+        mSlots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    mThread = std::thread(&Logger::writerThread, this);
+}
+
+Logger::~Logger() {
+    mRunning = false;
+    mWakeUp.notify_one();
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+}
+
+void Logger::setLevel(LogLevel level) {
+    mLevel.store(std::max(static_cast<int>(level), LOG_MIN_LEVEL), std::memory_order_relaxed);
+}
+
+Logger::Slot* Logger::acquire(LogLevel level, size_t& position) {
+    position = mTail.load(std::memory_order_relaxed);
+    for (;;) {
+        // The last quarter of the ring is kept for the warnings and errors
+        if (level < LogLevel::WARN && position - mHead.load(std::memory_order_relaxed) >= kCapacity - kCapacity / 4) {
+            mDropped.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        Slot& slot = mSlots[position & (kCapacity - 1)];
+        const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+        const intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+        if (diff == 0) {
+            if (mTail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                return &slot;
+            }
+        } else if (diff < 0) {
+            // Not read yet by the writer: the ring is full
+            mDropped.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        } else {
+            position = mTail.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+void Logger::publish(Slot* slot, size_t position, LogLevel level) {
+    slot->level = level;
+    slot->timeMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - mStart).count();
+    slot->sequence.store(position + 1, std::memory_order_release);
+
+    // Warnings and errors are written right away, the rest on the next period
+    if (level >= LogLevel::WARN) {
+        mWakeUp.notify_one();
+    }
+}
+
+void Logger::write(LogLevel level, const char* tag, const char* text, size_t length) {
+    size_t position;
+    Slot* slot = acquire(level, position);
+    if (!slot) {
+        return;
+    }
+    slot->tag = tag;
+    slot->length = std::min(length, kMaxMessageLength);
+    std::memcpy(slot->text, text, slot->length);
+    publish(slot, position, level);
+}
+
+void Logger::writef(LogLevel level, const char* tag, const char* format, ...) {
+    size_t position;
+    Slot* slot = acquire(level, position);
+    if (!slot) {
+        return;
+    }
+    slot->tag = tag;
+
+    // Formatted straight into the slot
+    va_list args;
+    va_start(args, format);
+    const int length = std::vsnprintf(slot->text, kMaxMessageLength, format, args);
+    va_end(args);
+    slot->length = length < 0 ? 0 : std::min(static_cast<size_t>(length), kMaxMessageLength - 1);
+    publish(slot, position, level);
+}
+
+void Logger::flush() {
+    const size_t target = mTail.load(std::memory_order_acquire);
+    mWakeUp.notify_one();
+    std::unique_lock<std::mutex> lock(mMutex);
+    mDrained.wait_for(lock, std::chrono::seconds(1), [this, target] {
+        return mHead.load(std::memory_order_acquire) >= target;
+    });
+}
+
+bool Logger::parseLevel(const std::string& name, LogLevel& level) {
+    if (name == "debug") {
+        level = LogLevel::DEBUG;
+    } else if (name == "info") {
+        level = LogLevel::INFO;
+    } else if (name == "warn") {
+        level = LogLevel::WARN;
+    } else if (name == "error") {
+        level = LogLevel::ERROR;
+    } else if (name == "none") {
+        level = LogLevel::NONE;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void Logger::writerThread() {
+#ifdef __linux__
+    // Lowest priority: the console only gets the CPU time left by the pipeline
+    setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), 19);
+#endif
+
+    for (;;) {
+        const bool running = mRunning.load();
+        const size_t written = drain();
+
+        if (mRepeats > 0) {
+            const int64_t nowMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - mStart).count();
+            if (nowMs - mRepeatsSinceMs >= kRepeatSummaryMs || !running) {
+                printRepeats();
+            }
+        }
+
+        const uint64_t dropped = mDropped.load(std::memory_order_relaxed);
+        if (dropped != mReportedDropped) {
+            std::fprintf(stderr, "Logger: %llu messages dropped\n",
+                         static_cast<unsigned long long>(dropped - mReportedDropped));
+            mReportedDropped = dropped;
+        }
+
+        std::fflush(stdout);
+        std::fflush(stderr);
+
+        std::unique_lock<std::mutex> lock(mMutex);
+        mDrained.notify_all();
+        if (!running) {
+            break;
+        }
+        if (written == 0) {
+            mWakeUp.wait_for(lock, kWriterPeriod);
+        }
+    }
+}
+
+size_t Logger::drain() {
+    size_t count = 0;
+    size_t head = mHead.load(std::memory_order_relaxed);
+    for (;;) {
+        Slot& slot = mSlots[head & (kCapacity - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != head + 1) {
+            break;
+        }
+
+        // Collapse consecutive identical messages
+        const bool repeated = slot.level == mLastLevel && slot.tag == mLastTag && slot.length == mLastLength &&
+                              std::memcmp(slot.text, mLastText, slot.length) == 0;
+        if (repeated) {
+            if (mRepeats++ == 0) {
+                mRepeatsSinceMs = slot.timeMs;
+            }
+            mLastTimeMs = slot.timeMs;
+        } else {
+            printRepeats();
+            print(slot.level, slot.tag, slot.timeMs, slot.text, slot.length);
+            mLastLevel = slot.level;
+            mLastTag = slot.tag;
+            mLastLength = slot.length;
+            mLastTimeMs = slot.timeMs;
+            std::memcpy(mLastText, slot.text, slot.length);
+        }
+
+        slot.sequence.store(head + kCapacity, std::memory_order_release);
+        ++head;
+        ++count;
+        mHead.store(head, std::memory_order_release);
+    }
+    return count;
+}
+
+void Logger::print(LogLevel level, const char* tag, int64_t timeMs, const char* text, size_t length) {
+    static const char kLevels[] = {'D', 'I', 'W', 'E'};
+    FILE* out = level >= LogLevel::WARN ? stderr : stdout;
+
+    // The line feed is added here
+    while (length > 0 && text[length - 1] == '\n') {
+        --length;
+    }
+    std::fprintf(out, "%4lld.%03lld %c %s: %.*s\n",
+                 static_cast<long long>(timeMs / 1000), static_cast<long long>(timeMs % 1000),
+                 kLevels[std::min(static_cast<int>(level), 3)], tag ? tag : "-", static_cast<int>(length), text);
+}
+
+void Logger::printRepeats() {
+    if (mRepeats == 0) {
+        return;
+    }
+    char text[64];
+    const int length = std::snprintf(text, sizeof(text), "last message repeated %llu times",
+                                     static_cast<unsigned long long>(mRepeats));
+    print(mLastLevel, mLastTag, mLastTimeMs, text, static_cast<size_t>(length));
+    mRepeats = 0;
+}
+
+LogLine::LogLine(LogLevel level, const char* tag)
+    : mLevel(level),
+      mTag(tag),
+      mEnabled(Logger::instance().enabled(level)),
+      mBuffer(mText, sizeof(mText)),
+      mStream(&mBuffer) {
+}
+
+LogLine::~LogLine() {
+    if (mEnabled) {
+        Logger::instance().write(mLevel, mTag, mText, mBuffer.length());
+    }
+}
@@ -0,0 +1,220 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <thread>
+
+/**
+ * @brief Severity of a log message
+ */
+enum class LogLevel : int {
+    DEBUG = 0,   ///< Per-frame details, compiled out of the release builds
+    INFO = 1,    ///< Normal operation
+    WARN = 2,    ///< Unexpected but recoverable
+    ERROR = 3,   ///< Failures
+    NONE = 4     ///< Disables logging
+};
+
+/**
+ * Lowest level compiled in (0 = DEBUG ... 4 = NONE). The messages below it
+ * cost nothing: their stream expressions and format arguments are never
+ * evaluated, and the compiler removes them.
+ */
+#ifndef LOG_MIN_LEVEL
+#ifdef NDEBUG
+#define LOG_MIN_LEVEL 1
+#else
+#define LOG_MIN_LEVEL 0
+#endif
+#endif
+
+/**
+ * @brief Asynchronous project logger
+ *
+ * Logging a message only formats it into a slot of a lock-free ring buffer
+ * (no lock, no allocation, no system call). A low-priority thread drains the
+ * ring and writes the messages to the console, so the pipeline threads never
+ * wait for the console. When the ring is full, messages are dropped and the
+ * number of dropped messages is reported later. The last quarter of the ring
+ * only takes warnings and errors, so a burst of messages does not hide them.
+ *
+ * Consecutive identical messages are collapsed: the first one is written, the
+ * repetitions are counted and summarized at most once per second.
+ *
+ * Use the LOGD / LOGI / LOGW / LOGE stream macros or their printf-style
+ * LOGD_FMT ... LOGE_FMT counterparts rather than the class directly. Tags
+ * must be string literals (only the pointer is stored).
+ */
+class Logger {
+public:
+    /// Longest message, longer ones are truncated
+    static constexpr size_t kMaxMessageLength = 192;
+    /// Number of messages the ring holds (power of 2)
+    static constexpr size_t kCapacity = 256;
+
+    /**
+     * @brief Get the process logger. Starts the writer thread on the first call
+     */
+    static Logger& instance();
+
+    /**
+     * @brief Destructor. Writes the pending messages and stops the writer thread
+     */
+    ~Logger();
+
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+
+    /**
+     * @brief Set the lowest level written at run time
+     *
+     * Levels below LOG_MIN_LEVEL are compiled out and cannot be re-enabled.
+     *
+     * @param level Lowest level written
+     */
+    void setLevel(LogLevel level);
+
+    /**
+     * @brief Check whether a level is written
+     */
+    bool enabled(LogLevel level) const {
+        return static_cast<int>(level) >= mLevel.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Queue a message
+     *
+     * @param level Message level
+     * @param tag Module name, string literal
+     * @param text Message, truncated to kMaxMessageLength
+     * @param length Length of text
+     */
+    void write(LogLevel level, const char* tag, const char* text, size_t length);
+
+    /**
+     * @brief Queue a printf-style message
+     */
+    void writef(LogLevel level, const char* tag, const char* format, ...)
+#if defined(__GNUC__)
+        __attribute__((format(printf, 4, 5)))
+#endif
+        ;
+
+    /**
+     * @brief Wait until the queued messages are written (at most one second)
+     */
+    void flush();
+
+    /**
+     * @brief Parse a level name ("debug", "info", "warn", "error" or "none")
+     *
+     * @param name Name of the level
+     * @param level Parsed level
+     * @return true if the name is valid
+     */
+    static bool parseLevel(const std::string& name, LogLevel& level);
+
+private:
+    struct Slot;
+
+    Logger();
+
+    // Reserve the next slot, nullptr if the ring is full
+    Slot* acquire(LogLevel level, size_t& position);
+    // Hand a filled slot over to the writer
+    void publish(Slot* slot, size_t position, LogLevel level);
+    void writerThread();
+    // Write every queued message, return the number written
+    size_t drain();
+    void print(LogLevel level, const char* tag, int64_t timeMs, const char* text, size_t length);
+    void printRepeats();
+
+    std::chrono::steady_clock::time_point mStart;
+    std::unique_ptr<Slot[]> mSlots;
+    std::atomic<size_t> mTail;       // Next slot reserved by the producers
+    std::atomic<size_t> mHead;       // Next slot read by the writer
+    std::atomic<int> mLevel;
+    std::atomic<uint64_t> mDropped;
+
+    // Writer state, only used by the writer thread
+    LogLevel mLastLevel;
+    const char* mLastTag;
+    char mLastText[kMaxMessageLength];
+    size_t mLastLength;
+    int64_t mLastTimeMs;
+    uint64_t mRepeats;
+    int64_t mRepeatsSinceMs;
+    uint64_t mReportedDropped;
+
+    std::thread mThread;
+    std::atomic<bool> mRunning;
+    std::mutex mMutex;
+    std::condition_variable mWakeUp;
+    std::condition_variable mDrained;
+};
+
+/**
+ * @brief Stream of one message, queued by its destructor
+ *
+ * Formats into a fixed buffer on the stack, so building a message does not
+ * allocate.
+ */
+class LogLine {
+public:
+    LogLine(LogLevel level, const char* tag);
+    ~LogLine();
+
+    LogLine(const LogLine&) = delete;
+    LogLine& operator=(const LogLine&) = delete;
+
+    std::ostream& stream() { return mStream; }
+
+private:
+    // Stream buffer writing into mText, silently truncating
+    class Buffer : public std::streambuf {
+    public:
+        Buffer(char* begin, size_t size) { setp(begin, begin + size); }
+        size_t length() const { return static_cast<size_t>(pptr() - pbase()); }
+    protected:
+        int_type overflow(int_type ch) override { return traits_type::not_eof(ch); }
+    };
+
+    LogLevel mLevel;
+    const char* mTag;
+    bool mEnabled;
+    char mText[Logger::kMaxMessageLength];
+    Buffer mBuffer;
+    std::ostream mStream;
+};
+
+// Stream and printf-style messages of a given level, compiled out below LOG_MIN_LEVEL
+#define LOG_STREAM(level, tag) \
+    if (static_cast<int>(level) < LOG_MIN_LEVEL || !Logger::instance().enabled(level)) {} \
+    else LogLine(level, tag).stream()
+#define LOG_FMT(level, tag, ...) \
+    do { \
+        if (static_cast<int>(level) >= LOG_MIN_LEVEL && Logger::instance().enabled(level)) { \
+            Logger::instance().writef(level, tag, __VA_ARGS__); \
+        } \
+    } while (0)
+
+#define LOGD(tag) LOG_STREAM(LogLevel::DEBUG, tag)
+#define LOGI(tag) LOG_STREAM(LogLevel::INFO, tag)
+#define LOGW(tag) LOG_STREAM(LogLevel::WARN, tag)
+#define LOGE(tag) LOG_STREAM(LogLevel::ERROR, tag)
+
+#define LOGD_FMT(tag, ...) LOG_FMT(LogLevel::DEBUG, tag, __VA_ARGS__)
+#define LOGI_FMT(tag, ...) LOG_FMT(LogLevel::INFO, tag, __VA_ARGS__)
+#define LOGW_FMT(tag, ...) LOG_FMT(LogLevel::WARN, tag, __VA_ARGS__)
+#define LOGE_FMT(tag, ...) LOG_FMT(LogLevel::ERROR, tag, __VA_ARGS__)
+
+#endif // LOGGER_H
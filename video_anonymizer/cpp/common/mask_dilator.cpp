@@ -0,0 +1,207 @@
+#include "mask_dilator.h"
+#include <algorithm>
+#include <cstdint>
+
+// View of a scratch buffer with the requested geometry. The storage only
+// grows, so that the steady state does not allocate when the size of the
+// dilated regions changes from frame to frame.
+static cv::Mat scratch(cv::Mat& storage, int rows, int cols, int type) {
+    if (storage.type() != type || storage.rows < rows || storage.cols < cols) {
+        storage.create(std::max(rows, storage.rows), std::max(cols, storage.cols), type);
+    }
+    return storage(cv::Rect(0, 0, cols, rows));
+}
+
+MaskDilator::MaskDilator(Shape shape)
+    : mShape(shape) {
+}
+
+void MaskDilator::setShape(Shape shape) {
+    mShape = shape;
+}
+
+MaskDilator::Shape MaskDilator::getShape() const {
+    return mShape;
+}
+
+bool MaskDilator::parseShape(const std::string& name, Shape& shape) {
+    if (name == "none") {
+        shape = Shape::NONE;
+    } else if (name == "disk") {
+        shape = Shape::DISK;
+    } else if (name == "rect") {
+        shape = Shape::RECT;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void MaskDilator::dilate(const cv::Mat& src, cv::Mat& dst, int radius) {
+    CV_Assert(src.type() == CV_8UC1);
+    CV_Assert(dst.empty() || dst.data != src.data);
+
+    if (mShape == Shape::NONE || radius <= 0) {
+        cv::compare(src, 0, dst, cv::CMP_NE);
+        return;
+    }
+
+    if (mShape == Shape::RECT) {
+        dilateRect(src, dst, radius);
+    } else {
+        dilateDisk(src, dst, radius);
+    }
+}
+
+void MaskDilator::dilateDisk(const cv::Mat& src, cv::Mat& dst, int radius) {
+    // Distance of every pixel to the closest mask pixel, with the 5x5 chamfer
+    // approximation of L2 (weights 5, 7 and 11 for the steps of 1, sqrt(2)
+    // and sqrt(5) pixels), in two passes whatever the radius is. Same as
+    // cv::distanceTransform(DIST_L2, DIST_MASK_5), which allocates its buffers
+    // on every call. The distances are clamped just above the radius, that is
+    // all the threshold needs, and the buffer has a 2 pixel border at that
+    // value so that the passes need no bound checks.
+    const int kA = 5;
+    const int kB = 7;
+    const int kC = 11;
+    const int kBorder = 2;
+    const int rows = src.rows;
+    const int cols = src.cols;
+    const int32_t limit = kA * radius;
+    const int32_t far = limit + 1;
+
+    cv::Mat distance = scratch(mDistance, rows + 2 * kBorder, cols + 2 * kBorder, CV_32SC1);
+    distance.rowRange(0, kBorder).setTo(cv::Scalar(far));
+    distance.rowRange(rows + kBorder, rows + 2 * kBorder).setTo(cv::Scalar(far));
+    distance.colRange(0, kBorder).setTo(cv::Scalar(far));
+    distance.colRange(cols + kBorder, cols + 2 * kBorder).setTo(cv::Scalar(far));
+
+    // Forward pass: neighbours above and to the left
+    for (int y = 0; y < rows; ++y) {
+        const uchar* in = src.ptr<uchar>(y);
+        int32_t* d0 = distance.ptr<int32_t>(y + kBorder) + kBorder;
+        const int32_t* d1 = distance.ptr<int32_t>(y + kBorder - 1) + kBorder;
+        const int32_t* d2 = distance.ptr<int32_t>(y + kBorder - 2) + kBorder;
+        for (int x = 0; x < cols; ++x) {
+            if (in[x]) {
+                d0[x] = 0;
+                continue;
+            }
+            int32_t d = std::min(d0[x - 1], d1[x]) + kA;
+            d = std::min(d, std::min(d1[x - 1], d1[x + 1]) + kB);
+            d = std::min(d, std::min(std::min(d1[x - 2], d1[x + 2]), std::min(d2[x - 1], d2[x + 1])) + kC);
+            d0[x] = std::min(d, far);
+        }
+    }
+
+    // Backward pass: neighbours below and to the right. The distances are
+    // final, so the output is written in the same pass.
+    dst.create(src.size(), CV_8UC1);
+    for (int y = rows - 1; y >= 0; --y) {
+        uchar* out = dst.ptr<uchar>(y);
+        int32_t* d0 = distance.ptr<int32_t>(y + kBorder) + kBorder;
+        const int32_t* d1 = distance.ptr<int32_t>(y + kBorder + 1) + kBorder;
+        const int32_t* d2 = distance.ptr<int32_t>(y + kBorder + 2) + kBorder;
+        for (int x = cols - 1; x >= 0; --x) {
+            int32_t d = d0[x];
+            if (d > 0) {
+                d = std::min(d, std::min(d0[x + 1], d1[x]) + kA);
+                d = std::min(d, std::min(d1[x + 1], d1[x - 1]) + kB);
+                d = std::min(d, std::min(std::min(d1[x + 2], d1[x - 2]), std::min(d2[x + 1], d2[x - 1])) + kC);
+                d0[x] = std::min(d, far);
+            }
+            out[x] = d <= limit ? 255 : 0;
+        }
+    }
+}
+
+void MaskDilator::maxFilter1D(const uchar* in, uchar* out, int n, int radius,
+                              uchar* prefix, uchar* suffix) {
+    // van Herk/Gil-Werman: split the zero padded line in blocks of the window
+    // size, and compute the running maximum from the start (prefix) and from
+    // the end (suffix) of every block. Any window covers the end of one block
+    // and the start of the next one, so its maximum is max(suffix, prefix).
+    const int window = 2 * radius + 1;
+    const int len = n + 2 * radius;
+    auto value = [&](int i) -> uchar {
+        return (i >= radius && i < radius + n) ? in[i - radius] : 0;
+    };
+
+    for (int start = 0; start < len; start += window) {
+        const int end = std::min(start + window, len);
+        prefix[start] = value(start);
+        for (int i = start + 1; i < end; ++i) {
+            prefix[i] = std::max(prefix[i - 1], value(i));
+        }
+        suffix[end - 1] = value(end - 1);
+        for (int i = end - 2; i >= start; --i) {
+            suffix[i] = std::max(suffix[i + 1], value(i));
+        }
+    }
+
+    for (int j = 0; j < n; ++j) {
+        out[j] = std::max(suffix[j], prefix[j + 2 * radius]);
+    }
+}
+
+void MaskDilator::dilateRect(const cv::Mat& src, cv::Mat& dst, int radius) {
+    const int rows = src.rows;
+    const int cols = src.cols;
+    const int window = 2 * radius + 1;
+
+    // Horizontal pass, one row at a time
+    cv::Mat rowMax = scratch(mRowMax, rows, cols, CV_8UC1);
+    if (mLinePrefix.size() < static_cast<size_t>(cols + 2 * radius)) {
+        mLinePrefix.resize(cols + 2 * radius);
+        mLineSuffix.resize(cols + 2 * radius);
+    }
+    for (int y = 0; y < rows; ++y) {
+        maxFilter1D(src.ptr<uchar>(y), rowMax.ptr<uchar>(y), cols, radius,
+                    mLinePrefix.data(), mLineSuffix.data());
+    }
+
+    // Vertical pass. Same algorithm, but on whole rows so that every step is
+    // a vectorized maximum of two rows. Row i of the prefix and suffix images
+    // corresponds to row i - radius of the image, and is zero outside of it.
+    const int len = rows + 2 * radius;
+    cv::Mat prefix = scratch(mPrefix, len, cols, CV_8UC1);
+    cv::Mat suffix = scratch(mSuffix, len, cols, CV_8UC1);
+    auto padded = [&](cv::Mat& buffer, int i) {
+        cv::Mat row = buffer.row(i);
+        if (i >= radius && i < radius + rows) {
+            rowMax.row(i - radius).copyTo(row);
+        } else {
+            row.setTo(cv::Scalar(0));
+        }
+    };
+    // buffer[i] = max(buffer[from], padded input row i)
+    auto accumulate = [&](cv::Mat& buffer, int i, int from) {
+        cv::Mat row = buffer.row(i);
+        if (i >= radius && i < radius + rows) {
+            cv::max(buffer.row(from), rowMax.row(i - radius), row);
+        } else {
+            buffer.row(from).copyTo(row);
+        }
+    };
+
+    for (int start = 0; start < len; start += window) {
+        const int end = std::min(start + window, len);
+        padded(prefix, start);
+        for (int i = start + 1; i < end; ++i) {
+            accumulate(prefix, i, i - 1);
+        }
+        padded(suffix, end - 1);
+        for (int i = end - 2; i >= start; --i) {
+            accumulate(suffix, i, i + 1);
+        }
+    }
+
+    dst.create(src.size(), CV_8UC1);
+    for (int y = 0; y < rows; ++y) {
+        cv::Mat out = dst.row(y);
+        cv::max(suffix.row(y), prefix.row(y + 2 * radius), out);
+    }
+
+    // The input may hold any non-zero value, the output is 0 or 255
+    cv::compare(dst, 0, dst, cv::CMP_NE);
+}
@@ -0,0 +1,91 @@
+#ifndef MASK_DILATOR_H
+#define MASK_DILATOR_H
+
+#include <opencv2/core.hpp>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Binary mask dilation whose cost does not depend on the radius
+ *
+ * cv::dilate with a large elliptic structuring element costs O(kernel area)
+ * per pixel, which is far too slow on the device for the radii needed to
+ * cover the edges of people. MaskDilator provides two O(1) per pixel
+ * alternatives:
+ * - DISK: threshold of a chamfer (5x5) approximation of the L2 distance
+ *   transform, which gives a circular dilation like MORPH_ELLIPSE
+ * - RECT: van Herk/Gil-Werman running maximum, applied separately on the
+ *   rows and on the columns (square structuring element)
+ *
+ * The temporary buffers are kept between calls and only grow, so dilating
+ * regions of varying size does not allocate once the largest one was seen.
+ */
+class MaskDilator {
+public:
+    /// Shape of the structuring element
+    enum class Shape {
+        NONE,   ///< No dilation, the mask is copied
+        DISK,   ///< Circle of the given radius
+        RECT    ///< Square of side 2 * radius + 1
+    };
+
+    /**
+     * @brief Constructor
+     *
+     * @param shape Shape of the structuring element
+     */
+    explicit MaskDilator(Shape shape = Shape::DISK);
+
+    /**
+     * @brief Set the shape of the structuring element
+     *
+     * @param shape New shape
+     */
+    void setShape(Shape shape);
+
+    /**
+     * @brief Get the shape of the structuring element
+     *
+     * @return Shape Current shape
+     */
+    Shape getShape() const;
+
+    /**
+     * @brief Dilate a binary mask
+     *
+     * @param src CV_8UC1 mask. Any non-zero pixel is foreground
+     * @param dst CV_8UC1 dilated mask with values 0 or 255. Allocated if needed.
+     *            Must not share the data of src
+     * @param radius Radius of the structuring element in pixels
+     */
+    void dilate(const cv::Mat& src, cv::Mat& dst, int radius);
+
+    /**
+     * @brief Parse a shape name ("none", "disk" or "rect")
+     *
+     * @param name Shape name
+     * @param shape Parsed shape
+     * @return true if the name is valid
+     */
+    static bool parseShape(const std::string& name, Shape& shape);
+
+private:
+    void dilateDisk(const cv::Mat& src, cv::Mat& dst, int radius);
+    void dilateRect(const cv::Mat& src, cv::Mat& dst, int radius);
+
+    // Running maximum over a centered window of 2 * radius + 1 values, with
+    // zeros outside of the line. in and out hold n values, the scratch
+    // buffers n + 2 * radius
+    static void maxFilter1D(const uchar* in, uchar* out, int n, int radius,
+                            uchar* prefix, uchar* suffix);
+
+    Shape mShape;
+    cv::Mat mDistance;
+    cv::Mat mRowMax;
+    cv::Mat mPrefix;
+    cv::Mat mSuffix;
+    std::vector<uchar> mLinePrefix;
+    std::vector<uchar> mLineSuffix;
+};
+
+#endif // MASK_DILATOR_H
@@ -0,0 +1,84 @@
+#include "mask_propagator.h"
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+
+MaskPropagator::MaskPropagator(const Parameters& params)
+    : mParams(params) {
+    mParams.decimation = std::max(mParams.decimation, 1);
+    mParams.searchRadius = std::max(mParams.searchRadius, 1);
+}
+
+void MaskPropagator::computeLuma(const cv::Mat& frame, cv::Mat& luma) {
+    // Downscale first, so that the color conversion runs on the small image
+    cv::Size size(std::max(frame.cols / mParams.decimation, 1), std::max(frame.rows / mParams.decimation, 1));
+    if (frame.channels() == 1) {
+        cv::resize(frame, luma, size, 0, 0, cv::INTER_AREA);
+    } else {
+        cv::resize(frame, mSmall, size, 0, 0, cv::INTER_AREA);
+        cv::cvtColor(mSmall, luma, cv::COLOR_BGR2GRAY);
+    }
+}
+
+void MaskPropagator::setReference(const cv::Mat& frame, std::vector<IDetector::Detection>& detections) {
+    const cv::Rect frameRect(0, 0, frame.cols, frame.rows);
+
+    for (auto& det : detections) {
+        // Keep only the part of the full frame mask inside the box. This is a
+        // view, no pixels are copied.
+        if (!det.mask.empty() && det.mask.size() == frame.size()) {
+            det.bbox &= frameRect;
+            det.mask = det.bbox.empty() ? cv::Mat() : det.mask(det.bbox);
+        }
+    }
+
+    computeLuma(frame, mPrevLuma);
+}
+
+void MaskPropagator::propagate(const cv::Mat& frame, std::vector<IDetector::Detection>& detections) {
+    if (mPrevLuma.empty()) {
+        setReference(frame, detections);
+        return;
+    }
+
+    computeLuma(frame, mLuma);
+    if (mLuma.size() != mPrevLuma.size()) {
+        // The frame geometry changed, the detections cannot be matched
+        cv::swap(mPrevLuma, mLuma);
+        return;
+    }
+
+    const int d = mParams.decimation;
+    const int r = mParams.searchRadius;
+    const cv::Rect frameRect(0, 0, frame.cols, frame.rows);
+    const cv::Rect lumaRect(0, 0, mLuma.cols, mLuma.rows);
+
+    for (auto& det : detections) {
+        // The person as it appeared in the previous frame
+        cv::Rect box = det.bbox & frameRect;
+        cv::Rect templ = cv::Rect(box.x / d, box.y / d, box.width / d, box.height / d) & lumaRect;
+        if (templ.width < mParams.minTemplateSize || templ.height < mParams.minTemplateSize) {
+            continue;
+        }
+
+        // Best match in the new frame, at most r decimated pixels away
+        cv::Rect search = cv::Rect(templ.x - r, templ.y - r, templ.width + 2 * r, templ.height + 2 * r) & lumaRect;
+        cv::matchTemplate(mLuma(search), mPrevLuma(templ), mScores, cv::TM_SQDIFF);
+        cv::Point best;
+        cv::minMaxLoc(mScores, nullptr, nullptr, &best);
+
+        cv::Point shift = search.tl() + best - templ.tl();
+        det.bbox.x += shift.x * d;
+        det.bbox.y += shift.y * d;
+    }
+
+    cv::swap(mPrevLuma, mLuma);
+}
+
+bool MaskPropagator::hasReference() const {
+    return !mPrevLuma.empty();
+}
+
+void MaskPropagator::reset() {
+    mPrevLuma.release();
+    mLuma.release();
+}
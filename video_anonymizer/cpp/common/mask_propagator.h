@@ -0,0 +1,85 @@
+#ifndef MASK_PROPAGATOR_H
+#define MASK_PROPAGATOR_H
+
+#include <vector>
+#include <opencv2/core.hpp>
+
+#include "idetector.h"
+
+/**
+ * @brief Moves person detections forward between detector runs
+ *
+ * When the detector does not run on every frame, the last detections are
+ * reused and moving persons leak out of their masks. MaskPropagator estimates
+ * the translation of every person from one frame to the next with block
+ * matching on a decimated luma image, restricted to the area around each
+ * bounding box, and shifts the boxes and masks accordingly.
+ *
+ * The masks are cropped to their bounding box when the reference is set, so
+ * that moving a person only changes its bbox.
+ */
+class MaskPropagator {
+public:
+    /**
+     * @brief Propagation parameters
+     */
+    struct Parameters {
+        int decimation;       ///< Downscaling factor of the luma image used for matching
+        int searchRadius;     ///< Largest displacement searched per frame, in decimated pixels
+        int minTemplateSize;  ///< Persons smaller than this (decimated pixels) are not moved
+        // Constructor with default values
+        Parameters()
+            : decimation(4),
+              searchRadius(6),
+              minTemplateSize(4) {}
+    };
+
+    /**
+     * @brief Constructor
+     *
+     * @param params Propagation parameters
+     */
+    explicit MaskPropagator(const Parameters& params = Parameters());
+
+    /**
+     * @brief Start from new detections
+     *
+     * Full frame masks are replaced with views cropped to the bounding box.
+     *
+     * @param frame Frame the detections correspond to (BGR or grayscale)
+     * @param detections Detections, modified in place
+     */
+    void setReference(const cv::Mat& frame, std::vector<IDetector::Detection>& detections);
+
+    /**
+     * @brief Move the detections from the previous frame to this one
+     *
+     * @param frame New frame (BGR or grayscale)
+     * @param detections Detections of the previous frame, moved in place
+     */
+    void propagate(const cv::Mat& frame, std::vector<IDetector::Detection>& detections);
+
+    /**
+     * @brief Check whether a reference frame was set
+     *
+     * @return true if propagate() can be called
+     */
+    bool hasReference() const;
+
+    /**
+     * @brief Forget the reference frame
+     */
+    void reset();
+
+private:
+    // Decimated luma of a frame
+    void computeLuma(const cv::Mat& frame, cv::Mat& luma);
+
+    Parameters mParams;
+    cv::Mat mPrevLuma;
+    cv::Mat mLuma;
+    cv::Mat mSmall;
+    cv::Mat mScores;
+};
+
+#endif // MASK_PROPAGATOR_H
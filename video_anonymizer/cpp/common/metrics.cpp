@@ -0,0 +1,170 @@
+#include "metrics.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+static constexpr uint64_t kSubBuckets = 1u << LatencyHistogram::kSubBucketBits;
+
+// Index of the most significant bit of a non-zero value
+static int highestBit(uint64_t v) {
+#if defined(__GNUC__)
+    return 63 - __builtin_clzll(v);
+#else
+    int bit = 0;
+    while (v >>= 1) {
+        ++bit;
+    }
+    return bit;
+#endif
+}
+
+LatencyHistogram::LatencyHistogram() : mCount(0), mSum(0), mMax(0) {
+    for (auto& bucket : mBuckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+size_t LatencyHistogram::bucketIndex(uint64_t us) {
+    if (us < kSubBuckets) {
+        return static_cast<size_t>(us);
+    }
+    us = std::min<uint64_t>(us, (uint64_t(1) << kMaxBits) - 1);
+    // Octave of the value, then its position among the sub-buckets of the octave
+    const int bit = highestBit(us);
+    const int shift = bit - kSubBucketBits;
+    return (static_cast<size_t>(bit - kSubBucketBits + 1) << kSubBucketBits) +
+           static_cast<size_t>((us >> shift) & (kSubBuckets - 1));
+}
+
+uint64_t LatencyHistogram::bucketLowest(size_t index) {
+    if (index < kSubBuckets) {
+        return index;
+    }
+    const int shift = static_cast<int>(index >> kSubBucketBits) - 1;
+    return (kSubBuckets + (index & (kSubBuckets - 1))) << shift;
+}
+
+void LatencyHistogram::record(uint64_t us) {
+    mBuckets[bucketIndex(us)].fetch_add(1, std::memory_order_relaxed);
+    mCount.fetch_add(1, std::memory_order_relaxed);
+    mSum.fetch_add(us, std::memory_order_relaxed);
+
+    uint64_t previous = mMax.load(std::memory_order_relaxed);
+    while (us > previous && !mMax.compare_exchange_weak(previous, us, std::memory_order_relaxed)) {
+    }
+}
+
+uint64_t LatencyHistogram::percentile(double fraction) const {
+    // The total is taken from the buckets, which may be ahead of mCount
+    uint64_t total = 0;
+    for (const auto& bucket : mBuckets) {
+        total += bucket.load(std::memory_order_relaxed);
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    const double clamped = std::min(std::max(fraction, 0.0), 1.0);
+    const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(clamped * total)));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBucketCount; ++i) {
+        seen += mBuckets[i].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            // Middle of the bucket, never above the largest value seen
+            const uint64_t lowest = bucketLowest(i);
+            const uint64_t width = bucketLowest(i + 1) - lowest;
+            return std::min(lowest + width / 2, std::max(max(), lowest));
+        }
+    }
+    return max();
+}
+
+double LatencyHistogram::mean() const {
+    const uint64_t n = count();
+    return n > 0 ? static_cast<double>(mSum.load(std::memory_order_relaxed)) / n : 0.0;
+}
+
+void LatencyHistogram::reset() {
+    for (auto& bucket : mBuckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    mCount.store(0, std::memory_order_relaxed);
+    mSum.store(0, std::memory_order_relaxed);
+    mMax.store(0, std::memory_order_relaxed);
+}
+
+std::vector<std::string> MetricsSnapshot::format() const {
+    std::vector<std::string> lines;
+    char line[160];
+    for (const Stage& s : stages) {
+        std::snprintf(line, sizeof(line), "%-28s n=%-7llu p50=%.2f p95=%.2f p99=%.2f max=%.2f ms",
+                      s.name.c_str(), static_cast<unsigned long long>(s.count),
+                      s.p50Us / 1000.0, s.p95Us / 1000.0, s.p99Us / 1000.0, s.maxUs / 1000.0);
+        lines.emplace_back(line);
+    }
+    for (const Counter& c : counters) {
+        std::snprintf(line, sizeof(line), "%-28s %llu", c.name.c_str(), static_cast<unsigned long long>(c.value));
+        lines.emplace_back(line);
+    }
+    return lines;
+}
+
+MetricsRegistry& MetricsRegistry::instance() {
+    static MetricsRegistry registry;
+    return registry;
+}
+
+LatencyHistogram& MetricsRegistry::histogram(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::unique_ptr<LatencyHistogram>& histogram = mHistograms[name];
+    if (!histogram) {
+        histogram.reset(new LatencyHistogram());
+    }
+    return *histogram;
+}
+
+MetricCounter& MetricsRegistry::counter(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::unique_ptr<MetricCounter>& counter = mCounters[name];
+    if (!counter) {
+        counter.reset(new MetricCounter());
+    }
+    return *counter;
+}
+
+MetricsSnapshot MetricsRegistry::snapshot(bool reset) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    MetricsSnapshot snapshot;
+
+    snapshot.stages.reserve(mHistograms.size());
+    for (const auto& entry : mHistograms) {
+        LatencyHistogram& h = *entry.second;
+        MetricsSnapshot::Stage stage;
+        stage.name = entry.first;
+        stage.count = h.count();
+        stage.meanUs = h.mean();
+        stage.p50Us = h.percentile(0.50);
+        stage.p95Us = h.percentile(0.95);
+        stage.p99Us = h.percentile(0.99);
+        stage.maxUs = h.max();
+        snapshot.stages.push_back(stage);
+        if (reset) {
+            h.reset();
+        }
+    }
+
+    snapshot.counters.reserve(mCounters.size());
+    for (const auto& entry : mCounters) {
+        snapshot.counters.push_back({entry.first, entry.second->value()});
+        if (reset) {
+            entry.second->reset();
+        }
+    }
+    return snapshot;
+}
+
+uint64_t MetricsRegistry::nowUs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
@@ -0,0 +1,188 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Monotonic event counter
+ *
+ * Lock-free, may be incremented from any thread.
+ */
+class MetricCounter {
+public:
+    MetricCounter() : mValue(0) {}
+
+    void add(uint64_t n = 1) { mValue.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t value() const { return mValue.load(std::memory_order_relaxed); }
+    void reset() { mValue.store(0, std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> mValue;
+};
+
+/**
+ * @brief Latency histogram with a bounded relative error (HDR-style)
+ *
+ * Values are in microseconds. Values below 16 have their own bucket, larger
+ * values are split in 16 linear sub-buckets per power of 2, so a percentile
+ * is within 1/16 (6.25%) of the exact value, from 1 us up to 19 hours. The
+ * buckets are atomic counters: recording is lock-free and costs a few
+ * instructions, from any thread.
+ */
+class LatencyHistogram {
+public:
+    /// Linear sub-buckets per power of 2 (log2)
+    static constexpr int kSubBucketBits = 4;
+    /// Largest recorded value is 2^kMaxBits - 1 us, larger values are clamped
+    static constexpr int kMaxBits = 36;
+    static constexpr size_t kBucketCount = (kMaxBits - kSubBucketBits + 1) << kSubBucketBits;
+
+    LatencyHistogram();
+
+    /**
+     * @brief Record a latency
+     *
+     * @param us Latency in microseconds
+     */
+    void record(uint64_t us);
+
+    /**
+     * @brief Number of recorded values
+     */
+    uint64_t count() const { return mCount.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Value under which a fraction of the recorded values fall
+     *
+     * @param fraction Fraction in [0, 1] (0.99 for p99)
+     * @return uint64_t Latency in microseconds, 0 if nothing was recorded
+     */
+    uint64_t percentile(double fraction) const;
+
+    uint64_t max() const { return mMax.load(std::memory_order_relaxed); }
+    double mean() const;
+
+    /**
+     * @brief Forget the recorded values
+     */
+    void reset();
+
+    // Bucket of a value, and lowest value of a bucket
+    static size_t bucketIndex(uint64_t us);
+    static uint64_t bucketLowest(size_t index);
+
+private:
+    std::array<std::atomic<uint64_t>, kBucketCount> mBuckets;
+    std::atomic<uint64_t> mCount;
+    std::atomic<uint64_t> mSum;
+    std::atomic<uint64_t> mMax;
+};
+
+/**
+ * @brief Point-in-time copy of the registered metrics
+ */
+struct MetricsSnapshot {
+    struct Stage {
+        std::string name;
+        uint64_t count;
+        double meanUs;
+        uint64_t p50Us;
+        uint64_t p95Us;
+        uint64_t p99Us;
+        uint64_t maxUs;
+    };
+    struct Counter {
+        std::string name;
+        uint64_t value;
+    };
+
+    std::vector<Stage> stages;       ///< One entry per histogram, sorted by name
+    std::vector<Counter> counters;   ///< One entry per counter, sorted by name
+
+    /**
+     * @brief One line per stage ("name n=.. p50=.. p95=.. p99=.. max=.. ms") and counter
+     */
+    std::vector<std::string> format() const;
+};
+
+/**
+ * @brief Process-wide registry of the pipeline metrics
+ *
+ * Metrics are created on their first lookup and live until the end of the
+ * process, so the references returned can be kept. Lookups take a lock: call
+ * sites look their metrics up once and keep the reference, only the
+ * recording is on the hot path.
+ */
+class MetricsRegistry {
+public:
+    /**
+     * @brief Get the process registry
+     */
+    static MetricsRegistry& instance();
+
+    /**
+     * @brief Get (or create) a latency histogram
+     *
+     * @param name Stage name, for example "detector.inference"
+     */
+    LatencyHistogram& histogram(const std::string& name);
+
+    /**
+     * @brief Get (or create) a counter
+     *
+     * @param name Counter name, for example "encoder.bytes"
+     */
+    MetricCounter& counter(const std::string& name);
+
+    /**
+     * @brief Copy the current values of every metric
+     *
+     * The metrics keep being updated while they are read, so the values of
+     * different metrics may be a few events apart.
+     *
+     * @param reset Also reset the metrics, so the next snapshot covers a new period
+     * @return MetricsSnapshot Percentiles of every stage and values of every counter
+     */
+    MetricsSnapshot snapshot(bool reset = false);
+
+    /**
+     * @brief Current time of the clock used for the latencies
+     *
+     * @return uint64_t Monotonic time in microseconds
+     */
+    static uint64_t nowUs();
+
+private:
+    MetricsRegistry() = default;
+
+    std::mutex mMutex;
+    std::map<std::string, std::unique_ptr<LatencyHistogram>> mHistograms;
+    std::map<std::string, std::unique_ptr<MetricCounter>> mCounters;
+};
+
+/**
+ * @brief Records the lifetime of a scope into a histogram
+ */
+class ScopedLatency {
+public:
+    explicit ScopedLatency(LatencyHistogram& histogram)
+        : mHistogram(histogram), mStart(MetricsRegistry::nowUs()) {}
+    ~ScopedLatency() { mHistogram.record(MetricsRegistry::nowUs() - mStart); }
+
+    ScopedLatency(const ScopedLatency&) = delete;
+    ScopedLatency& operator=(const ScopedLatency&) = delete;
+
+private:
+    LatencyHistogram& mHistogram;
+    uint64_t mStart;
+};
+
+#endif // METRICS_H
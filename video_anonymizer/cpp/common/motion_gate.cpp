@@ -0,0 +1,63 @@
+#include "motion_gate.h"
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+#include <cmath>
+
+MotionGate::MotionGate(const Parameters& params)
+    : mParams(params), mChangedBlocks(0) {
+    mParams.decimation = std::max(mParams.decimation, 1);
+    mParams.blockSize = std::max(mParams.blockSize, 1);
+    mParams.minChangedBlocks = std::max(mParams.minChangedBlocks, 1);
+}
+
+void MotionGate::computeLuma(const cv::Mat& frame, cv::Mat& luma) {
+    // Downscale first, so that the color conversion runs on the small image.
+    // The area average also removes most of the sensor noise.
+    cv::Size size(std::max(frame.cols / mParams.decimation, 1), std::max(frame.rows / mParams.decimation, 1));
+    if (frame.channels() == 1) {
+        cv::resize(frame, luma, size, 0, 0, cv::INTER_AREA);
+    } else {
+        cv::resize(frame, mSmall, size, 0, 0, cv::INTER_AREA);
+        cv::cvtColor(mSmall, luma, cv::COLOR_BGR2GRAY);
+    }
+}
+
+bool MotionGate::hasChanged(const cv::Mat& frame) {
+    mChangedBlocks = 0;
+    if (mReference.empty()) {
+        return true;
+    }
+
+    computeLuma(frame, mLuma);
+    if (mLuma.size() != mReference.size()) {
+        // The frame geometry changed
+        return true;
+    }
+
+    // Mean absolute difference of every block. The area resize averages the
+    // partial blocks at the borders too.
+    cv::absdiff(mLuma, mReference, mDiff);
+    const cv::Size blocks((mDiff.cols + mParams.blockSize - 1) / mParams.blockSize,
+                          (mDiff.rows + mParams.blockSize - 1) / mParams.blockSize);
+    cv::resize(mDiff, mBlocks, blocks, 0, 0, cv::INTER_AREA);
+    cv::compare(mBlocks, std::floor(mParams.blockThreshold), mChanged, cv::CMP_GT);
+    mChangedBlocks = cv::countNonZero(mChanged);
+    return mChangedBlocks >= mParams.minChangedBlocks;
+}
+
+void MotionGate::setReference(const cv::Mat& frame) {
+    computeLuma(frame, mReference);
+}
+
+int MotionGate::getChangedBlocks() const {
+    return mChangedBlocks;
+}
+
+const MotionGate::Parameters& MotionGate::getParameters() const {
+    return mParams;
+}
+
+void MotionGate::reset() {
+    mReference.release();
+    mChangedBlocks = 0;
+}
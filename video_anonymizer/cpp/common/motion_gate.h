@@ -0,0 +1,90 @@
+#ifndef MOTION_GATE_H
+#define MOTION_GATE_H
+
+#include <opencv2/core.hpp>
+
+/**
+ * @brief Finds the frames that did not change since the last detection
+ *
+ * Compares a frame with the frame the detector last ran on, on a heavily
+ * decimated luma image: the mean absolute difference (SAD) of every block of
+ * decimated pixels is compared with a threshold. When no block changed, the
+ * scene is static and the previous detections are still valid, so the
+ * detector can be skipped.
+ *
+ * The gate only compares images. The caller decides when the comparison
+ * applies (no person in view, refresh interval not reached).
+ */
+class MotionGate {
+public:
+    /**
+     * @brief Gate parameters
+     */
+    struct Parameters {
+        int decimation;        ///< Downscaling factor of the luma image
+        int blockSize;         ///< Side of the compared blocks, in decimated pixels
+        float blockThreshold;  ///< Mean absolute luma difference of a changed block [0-255]
+        int minChangedBlocks;  ///< Number of changed blocks that make the frame changed
+        int refreshInterval;   ///< Frames after which the detector runs even without change
+        // Constructor with default values
+        Parameters()
+            : decimation(16),
+              blockSize(4),
+              blockThreshold(8.0f),
+              minChangedBlocks(1),
+              refreshInterval(30) {}
+    };
+
+    /**
+     * @brief Constructor
+     *
+     * @param params Gate parameters
+     */
+    explicit MotionGate(const Parameters& params = Parameters());
+
+    /**
+     * @brief Compare a frame with the reference
+     *
+     * @param frame Frame (BGR or grayscale)
+     * @return true if the frame changed, or if there is no comparable reference
+     */
+    bool hasChanged(const cv::Mat& frame);
+
+    /**
+     * @brief Make a frame the reference, usually the frame the detector ran on
+     *
+     * @param frame Frame (BGR or grayscale)
+     */
+    void setReference(const cv::Mat& frame);
+
+    /**
+     * @brief Get the number of changed blocks found by the last comparison
+     */
+    int getChangedBlocks() const;
+
+    /**
+     * @brief Get the gate parameters
+     */
+    const Parameters& getParameters() const;
+
+    /**
+     * @brief Forget the reference frame
+     */
+    void reset();
+
+private:
+    // Decimated luma of a frame
+    void computeLuma(const cv::Mat& frame, cv::Mat& luma);
+
+    Parameters mParams;
+    cv::Mat mReference;
+    int mChangedBlocks;
+    // Working buffers, reused between frames
+    cv::Mat mSmall;
+    cv::Mat mLuma;
+    cv::Mat mDiff;
+    cv::Mat mBlocks;
+    cv::Mat mChanged;
+};
+
+#endif // MOTION_GATE_H
@@ -0,0 +1,112 @@
+#include "packed_mask_decoder.h"
+#include <cstring>
+
+// Expansion of every byte value to 8 mask pixels, least significant bit first
+struct BitTable {
+    uint8_t pixels[256][8];
+};
+
+static const BitTable& bitTable() {
+    static const BitTable table = [] {
+        BitTable t;
+        for (int v = 0; v < 256; ++v) {
+            for (int k = 0; k < 8; ++k) {
+                t.pixels[v][k] = ((v >> k) & 1) ? 255 : 0;
+            }
+        }
+        return t;
+    }();
+    return table;
+}
+
+PackedMaskDecoder::PackedMaskDecoder() {
+    // Build the table now rather than on the first frame
+    bitTable();
+}
+
+void PackedMaskDecoder::decodeRow(const uint8_t* row, size_t rowBytes, int x0, int count, uchar* dst) {
+    const BitTable& table = bitTable();
+    const int end = x0 + count;
+    // Bits past the data decode as zeros
+    const int validEnd = rowBytes >= static_cast<size_t>(end + 7) / 8 ? end : static_cast<int>(rowBytes * 8);
+
+    int x = x0;
+    // Leading bits up to the next byte boundary
+    for (; x < validEnd && (x & 7) != 0; ++x) {
+        *dst++ = ((row[x >> 3] >> (x & 7)) & 1) ? 255 : 0;
+    }
+    // Whole bytes, 8 pixels at a time
+    for (; x + 8 <= validEnd; x += 8, dst += 8) {
+        std::memcpy(dst, table.pixels[row[x >> 3]], 8);
+    }
+    // Trailing bits
+    for (; x < validEnd; ++x) {
+        *dst++ = ((row[x >> 3] >> (x & 7)) & 1) ? 255 : 0;
+    }
+    if (x < end) {
+        std::memset(dst, 0, end - x);
+    }
+}
+
+// First byte of row y and the number of bytes available from it
+static const uint8_t* rowStart(const uint8_t* data, size_t size, int width, int y, size_t& rowBytes) {
+    const size_t start = static_cast<size_t>(y) * width / 8;
+    if (start >= size) {
+        rowBytes = 0;
+        return data;
+    }
+    rowBytes = size - start;
+    return data + start;
+}
+
+void PackedMaskDecoder::decode(const uint8_t* data, size_t size, int width, int height,
+                               const cv::Rect& roi, cv::Mat& dst) {
+    const cv::Rect r = roi & cv::Rect(0, 0, width, height);
+    dst.create(r.size(), CV_8UC1);
+
+    for (int y = 0; y < r.height; ++y) {
+        size_t rowBytes;
+        const uint8_t* row = rowStart(data, size, width, r.y + y, rowBytes);
+        decodeRow(row, rowBytes, r.x, r.width, dst.ptr<uchar>(y));
+    }
+}
+
+void PackedMaskDecoder::decode(const uint8_t* data, size_t size, int width, int height,
+                               const cv::Rect& roi, const cv::Size& dstSize, cv::Mat& dst) {
+    const cv::Rect r = roi & cv::Rect(0, 0, width, height);
+    dst.create(dstSize, CV_8UC1);
+    if (dst.empty()) {
+        return;
+    }
+    if (r.empty()) {
+        dst.setTo(cv::Scalar(0));
+        return;
+    }
+
+    // Nearest neighbor: output pixel x samples the roi at floor(x * roi / dst)
+    mColumns.resize(dstSize.width);
+    for (int x = 0; x < dstSize.width; ++x) {
+        mColumns[x] = static_cast<int>(static_cast<int64_t>(x) * r.width / dstSize.width);
+    }
+    mRow.resize(r.width);
+
+    int previous = -1;
+    for (int y = 0; y < dstSize.height; ++y) {
+        const int srcY = r.y + static_cast<int>(static_cast<int64_t>(y) * r.height / dstSize.height);
+        uchar* out = dst.ptr<uchar>(y);
+
+        // Upscaled rows repeat the previous one
+        if (srcY == previous) {
+            std::memcpy(out, dst.ptr<uchar>(y - 1), dstSize.width);
+            continue;
+        }
+
+        size_t rowBytes;
+        const uint8_t* row = rowStart(data, size, width, srcY, rowBytes);
+        decodeRow(row, rowBytes, r.x, r.width, mRow.data());
+        for (int x = 0; x < dstSize.width; ++x) {
+            out[x] = mRow[mColumns[x]];
+        }
+        previous = srcY;
+    }
+}
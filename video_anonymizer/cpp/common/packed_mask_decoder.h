@@ -0,0 +1,77 @@
+#ifndef PACKED_MASK_DECODER_H
+#define PACKED_MASK_DECODER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <opencv2/core.hpp>
+
+/**
+ * @brief Decoder of the bit-packed segmentation masks returned by SSCMA
+ *
+ * The mask is a bit stream of width x height bits. Row i starts at byte
+ * i * width / 8, and pixel j of the row is bit (j % 8) of byte j / 8 of the
+ * row (least significant bit first). Bytes past the end of the data decode
+ * as zeros.
+ *
+ * Whole bytes are expanded 8 pixels at a time through a 256-entry table of
+ * 8-byte patterns, so decoding costs one load and one 8-byte store per 8
+ * pixels. Only the requested region of interest is decoded, optionally
+ * resampled (nearest neighbor) straight to a target size.
+ */
+class PackedMaskDecoder {
+public:
+    /**
+     * @brief Constructor
+     */
+    PackedMaskDecoder();
+
+    /**
+     * @brief Decode a region of the mask at its native resolution
+     *
+     * @param data Packed mask
+     * @param size Number of bytes of data
+     * @param width Width of the mask in pixels
+     * @param height Height of the mask in pixels
+     * @param roi Region to decode, in mask pixels. Clipped to the mask
+     * @param dst CV_8UC1 output with the size of the clipped roi, 0 or 255
+     */
+    void decode(const uint8_t* data, size_t size, int width, int height,
+                const cv::Rect& roi, cv::Mat& dst);
+
+    /**
+     * @brief Decode a region of the mask resampled to a target size
+     *
+     * Equivalent to decoding the roi and resizing it with nearest neighbor
+     * interpolation, without the intermediate image.
+     *
+     * @param data Packed mask
+     * @param size Number of bytes of data
+     * @param width Width of the mask in pixels
+     * @param height Height of the mask in pixels
+     * @param roi Region to decode, in mask pixels. Clipped to the mask
+     * @param dstSize Size of the output
+     * @param dst CV_8UC1 output of size dstSize, 0 or 255
+     */
+    void decode(const uint8_t* data, size_t size, int width, int height,
+                const cv::Rect& roi, const cv::Size& dstSize, cv::Mat& dst);
+
+    /**
+     * @brief Decode count bits of a row, starting at bit x0
+     *
+     * @param row First byte of the row
+     * @param rowBytes Number of bytes available from row (bits past them decode as zeros)
+     * @param x0 Index of the first bit
+     * @param count Number of bits to decode
+     * @param dst Output, count bytes set to 0 or 255
+     */
+    static void decodeRow(const uint8_t* row, size_t rowBytes, int x0, int count, uchar* dst);
+
+private:
+    // Source column of every output column when resampling
+    std::vector<int> mColumns;
+    // Native resolution row of the roi when resampling
+    std::vector<uchar> mRow;
+};
+
+#endif // PACKED_MASK_DECODER_H
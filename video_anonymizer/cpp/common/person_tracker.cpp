@@ -0,0 +1,242 @@
+#include "person_tracker.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+void PersonTracker::KalmanAxis::init(float position, float measurementNoise) {
+    x = position;
+    v = 0.0f;
+    p00 = measurementNoise * measurementNoise;
+    p01 = 0.0f;
+    // The velocity is unknown at first
+    p11 = 100.0f;
+}
+
+void PersonTracker::KalmanAxis::predict(float dt, float q) {
+    // x' = F x with F = [1 dt; 0 1], P' = F P F^T + Q (white noise acceleration)
+    const float q2 = q * q;
+    const float dt2 = dt * dt;
+    x += v * dt;
+    p00 += 2.0f * dt * p01 + dt2 * p11 + q2 * dt2 * dt2 * 0.25f;
+    p01 += dt * p11 + q2 * dt2 * dt * 0.5f;
+    p11 += q2 * dt2;
+}
+
+void PersonTracker::KalmanAxis::correct(float z, float r) {
+    // Only the position is measured: H = [1 0]
+    const float s = p00 + r * r;
+    const float k0 = p00 / s;
+    const float k1 = p01 / s;
+    const float y = z - x;
+    x += k0 * y;
+    v += k1 * y;
+    p11 -= k1 * p01;
+    p00 *= 1.0f - k0;
+    p01 *= 1.0f - k0;
+}
+
+PersonTracker::PersonTracker(const Parameters& params)
+    : mParams(params), mNextId(0), mLastFrame(0), mHasFrame(false) {
+}
+
+float PersonTracker::iou(const cv::Rect& a, const cv::Rect& b) {
+    const int intersection = (a & b).area();
+    const int unionArea = a.area() + b.area() - intersection;
+    return unionArea > 0 ? static_cast<float>(intersection) / unionArea : 0.0f;
+}
+
+void PersonTracker::solveAssignment(const std::vector<float>& cost, int rows, int cols,
+                                    std::vector<int>& assignment) {
+    // Hungarian algorithm (potentials version) on the cost matrix padded to a
+    // square. Padding has the cost of a zero IoU, and is dropped at the end.
+    const int n = std::max(rows, cols);
+    const float inf = std::numeric_limits<float>::max();
+    auto at = [&](int r, int c) {
+        return (r < rows && c < cols) ? cost[r * cols + c] : 1.0f;
+    };
+
+    // 1-based arrays, index 0 is a virtual column. They keep their capacity
+    // between updates.
+    std::vector<float>& u = mHungarianU;
+    std::vector<float>& v = mHungarianV;
+    std::vector<float>& minv = mHungarianMinV;
+    std::vector<int>& p = mHungarianP;
+    std::vector<int>& way = mHungarianWay;
+    std::vector<bool>& used = mHungarianUsed;
+    u.assign(n + 1, 0.0f);
+    v.assign(n + 1, 0.0f);
+    minv.resize(n + 1);
+    p.assign(n + 1, 0);
+    way.assign(n + 1, 0);
+    used.resize(n + 1);
+
+    for (int i = 1; i <= n; ++i) {
+        p[0] = i;
+        int j0 = 0;
+        std::fill(minv.begin(), minv.end(), inf);
+        std::fill(used.begin(), used.end(), false);
+        do {
+            used[j0] = true;
+            const int i0 = p[j0];
+            float delta = inf;
+            int j1 = 0;
+            for (int j = 1; j <= n; ++j) {
+                if (used[j]) {
+                    continue;
+                }
+                const float cur = at(i0 - 1, j - 1) - u[i0] - v[j];
+                if (cur < minv[j]) {
+                    minv[j] = cur;
+                    way[j] = j0;
+                }
+                if (minv[j] < delta) {
+                    delta = minv[j];
+                    j1 = j;
+                }
+            }
+            for (int j = 0; j <= n; ++j) {
+                if (used[j]) {
+                    u[p[j]] += delta;
+                    v[j] -= delta;
+                } else {
+                    minv[j] -= delta;
+                }
+            }
+            j0 = j1;
+        } while (p[j0] != 0);
+        do {
+            const int j1 = way[j0];
+            p[j0] = p[j1];
+            j0 = j1;
+        } while (j0 != 0);
+    }
+
+    assignment.assign(rows, -1);
+    for (int j = 1; j <= n; ++j) {
+        if (p[j] >= 1 && p[j] <= rows && j <= cols) {
+            assignment[p[j] - 1] = j - 1;
+        }
+    }
+}
+
+void PersonTracker::initTrack(Track& track, const IDetector::Detection& det,
+                              const cv::Size& frameSize, uint64_t frameIndex) {
+    const cv::Rect& b = det.bbox;
+    track.id = mNextId++;
+    track.axes[0].init(b.x + b.width * 0.5f, mParams.measurementNoise);
+    track.axes[1].init(b.y + b.height * 0.5f, mParams.measurementNoise);
+    track.axes[2].init(static_cast<float>(b.width), mParams.measurementNoise);
+    track.axes[3].init(static_cast<float>(b.height), mParams.measurementNoise);
+    track.hits = 0;
+    correctTrack(track, det, frameSize, frameIndex);
+}
+
+void PersonTracker::correctTrack(Track& track, const IDetector::Detection& det,
+                                 const cv::Size& frameSize, uint64_t frameIndex) {
+    const cv::Rect& b = det.bbox;
+    const float r = mParams.measurementNoise;
+    track.axes[0].correct(b.x + b.width * 0.5f, r);
+    track.axes[1].correct(b.y + b.height * 0.5f, r);
+    track.axes[2].correct(static_cast<float>(b.width), r);
+    track.axes[3].correct(static_cast<float>(b.height), r);
+
+    // Keep the mask cropped to its box, so that it can be moved with the box
+    const cv::Rect box = b & cv::Rect(0, 0, frameSize.width, frameSize.height);
+    if (det.mask.size() == frameSize && !box.empty()) {
+        track.mask = det.mask(box);
+        track.lastBox = box;
+    } else {
+        // Empty, or already covering the box
+        track.mask = det.mask;
+        track.lastBox = b;
+    }
+
+    track.confidence = det.confidence;
+    track.hits++;
+    track.lastSeen = frameIndex;
+}
+
+cv::Rect PersonTracker::predictedBox(const Track& track) const {
+    // The mask covers the box, and is stretched to the predicted size when used
+    const float cx = track.axes[0].x;
+    const float cy = track.axes[1].x;
+    const float w = std::max(track.axes[2].x, 1.0f);
+    const float h = std::max(track.axes[3].x, 1.0f);
+    return cv::Rect(cvRound(cx - w * 0.5f), cvRound(cy - h * 0.5f), cvRound(w), cvRound(h));
+}
+
+void PersonTracker::update(std::vector<IDetector::Detection>& detections, uint64_t frameIndex,
+                           const cv::Size& frameSize, int personClassId) {
+    // Frames elapsed since the last update, the detector may not run on every frame
+    const float dt = mHasFrame && frameIndex > mLastFrame ? static_cast<float>(frameIndex - mLastFrame) : 1.0f;
+    mLastFrame = frameIndex;
+    mHasFrame = true;
+
+    for (auto& track : mTracks) {
+        for (auto& axis : track.axes) {
+            axis.predict(dt, mParams.processNoise);
+        }
+    }
+
+    mPersons.clear();
+    for (size_t i = 0; i < detections.size(); ++i) {
+        if (detections[i].classId == personClassId) {
+            mPersons.push_back(static_cast<int>(i));
+        }
+    }
+
+    // Associate the tracks and the detections, cost = 1 - IoU
+    const int numTracks = static_cast<int>(mTracks.size());
+    const int numPersons = static_cast<int>(mPersons.size());
+    mMatched.assign(numPersons, false);
+    if (numTracks > 0 && numPersons > 0) {
+        mCost.resize(numTracks * numPersons);
+        for (int t = 0; t < numTracks; ++t) {
+            const cv::Rect predicted = predictedBox(mTracks[t]);
+            for (int d = 0; d < numPersons; ++d) {
+                mCost[t * numPersons + d] = 1.0f - iou(predicted, detections[mPersons[d]].bbox);
+            }
+        }
+        solveAssignment(mCost, numTracks, numPersons, mAssignment);
+
+        for (int t = 0; t < numTracks; ++t) {
+            const int d = mAssignment[t];
+            if (d >= 0 && 1.0f - mCost[t * numPersons + d] >= mParams.iouThreshold) {
+                correctTrack(mTracks[t], detections[mPersons[d]], frameSize, frameIndex);
+                mMatched[d] = true;
+            }
+        }
+    }
+
+    // New persons start new tracks
+    for (int d = 0; d < numPersons; ++d) {
+        if (!mMatched[d]) {
+            mTracks.emplace_back();
+            initTrack(mTracks.back(), detections[mPersons[d]], frameSize, frameIndex);
+        }
+    }
+
+    // Forget the tracks that were missed for too long
+    mTracks.erase(std::remove_if(mTracks.begin(), mTracks.end(), [&](const Track& track) {
+        return frameIndex - track.lastSeen > static_cast<uint64_t>(mParams.trackHistory);
+    }), mTracks.end());
+
+    // Missed persons are still anonymized at their predicted position
+    for (const auto& track : mTracks) {
+        if (track.lastSeen == frameIndex || track.hits < mParams.minHits) {
+            continue;
+        }
+        IDetector::Detection coasting(predictedBox(track), track.confidence, personClassId);
+        coasting.mask = track.mask;
+        detections.push_back(coasting);
+    }
+}
+
+size_t PersonTracker::getTrackCount() const {
+    return mTracks.size();
+}
+
+void PersonTracker::reset() {
+    mTracks.clear();
+    mHasFrame = false;
+}
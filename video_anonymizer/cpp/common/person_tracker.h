@@ -0,0 +1,125 @@
+#ifndef PERSON_TRACKER_H
+#define PERSON_TRACKER_H
+
+#include <cstdint>
+#include <vector>
+#include <opencv2/core.hpp>
+
+#include "idetector.h"
+
+/**
+ * @brief Multi-object tracker for person detections
+ *
+ * C++ counterpart of the tracking of the Python implementation. Detections
+ * are associated with the existing tracks by IoU with an optimal (Hungarian)
+ * assignment. Every track predicts its box with constant velocity Kalman
+ * filters, one per box coordinate (center x, center y, width, height).
+ *
+ * When the detector misses a person that was tracked, the track keeps
+ * "coasting" for up to trackHistory frames: its predicted box and its last
+ * mask are added to the detections, so that the person stays anonymized.
+ */
+class PersonTracker {
+public:
+    /**
+     * @brief Tracking parameters
+     */
+    struct Parameters {
+        float iouThreshold;       ///< Minimum IoU between a detection and a predicted box to associate them
+        int trackHistory;         ///< Number of frames a track is kept without detections
+        int minHits;              ///< Number of detections before a track may coast
+        float processNoise;       ///< Kalman process noise (acceleration, pixels/frame^2)
+        float measurementNoise;   ///< Kalman measurement noise (pixels)
+        // Constructor with default values
+        Parameters()
+            : iouThreshold(0.3f),
+              trackHistory(15),
+              minHits(1),
+              processNoise(1.0f),
+              measurementNoise(4.0f) {}
+    };
+
+    /**
+     * @brief Constructor
+     *
+     * @param params Tracking parameters
+     */
+    explicit PersonTracker(const Parameters& params = Parameters());
+
+    /**
+     * @brief Update the tracks with the detections of a new detector run
+     *
+     * Detections of other classes are left untouched. The coasting tracks are
+     * appended to the detections, with their predicted box and last mask.
+     *
+     * @param detections Detections of the frame, extended in place
+     * @param frameIndex Index of the frame the detections were computed on
+     * @param frameSize Size of the frame
+     * @param personClassId Class ID of persons
+     */
+    void update(std::vector<IDetector::Detection>& detections, uint64_t frameIndex,
+                const cv::Size& frameSize, int personClassId);
+
+    /**
+     * @brief Get the number of active tracks
+     *
+     * @return size_t Number of tracks, coasting or not
+     */
+    size_t getTrackCount() const;
+
+    /**
+     * @brief Remove all the tracks
+     */
+    void reset();
+
+private:
+    // Constant velocity Kalman filter of one coordinate
+    struct KalmanAxis {
+        float x, v;            // State: position and velocity (per frame)
+        float p00, p01, p11;   // Covariance
+        void init(float position, float measurementNoise);
+        void predict(float dt, float q);
+        void correct(float z, float r);
+    };
+
+    struct Track {
+        int id;
+        KalmanAxis axes[4];    // Center x, center y, width, height
+        cv::Mat mask;          // Last mask, covering lastBox (may be empty)
+        cv::Rect lastBox;
+        float confidence;
+        int hits;
+        uint64_t lastSeen;     // Frame index of the last associated detection
+    };
+
+    static float iou(const cv::Rect& a, const cv::Rect& b);
+
+    // Minimum cost assignment. assignment[row] is the column of row, or -1.
+    void solveAssignment(const std::vector<float>& cost, int rows, int cols,
+                         std::vector<int>& assignment);
+
+    void initTrack(Track& track, const IDetector::Detection& det, const cv::Size& frameSize, uint64_t frameIndex);
+    void correctTrack(Track& track, const IDetector::Detection& det, const cv::Size& frameSize, uint64_t frameIndex);
+    cv::Rect predictedBox(const Track& track) const;
+
+    Parameters mParams;
+    std::vector<Track> mTracks;
+    int mNextId;
+    uint64_t mLastFrame;
+    bool mHasFrame;
+
+    // Reused between updates
+    std::vector<int> mPersons;
+    std::vector<float> mCost;
+    std::vector<int> mAssignment;
+    std::vector<bool> mMatched;
+    // Potentials, minima, matching and path of the Hungarian algorithm
+    std::vector<float> mHungarianU;
+    std::vector<float> mHungarianV;
+    std::vector<float> mHungarianMinV;
+    std::vector<int> mHungarianP;
+    std::vector<int> mHungarianWay;
+    std::vector<bool> mHungarianUsed;
+};
+
+#endif // PERSON_TRACKER_H
@@ -0,0 +1,146 @@
+#include "qos_governor.h"
+#include <algorithm>
+#include <sstream>
+
+#include "metrics.h"
+
+// Decisions of the governor
+struct QosMetrics {
+    MetricCounter& stepDown;
+    MetricCounter& stepUp;
+    MetricCounter& fallbackOn;
+    MetricCounter& fallbackOff;
+
+    QosMetrics()
+        : stepDown(MetricsRegistry::instance().counter("qos.step_down")),
+          stepUp(MetricsRegistry::instance().counter("qos.step_up")),
+          fallbackOn(MetricsRegistry::instance().counter("qos.fallback_on")),
+          fallbackOff(MetricsRegistry::instance().counter("qos.fallback_off")) {}
+};
+
+static QosMetrics& metrics() {
+    static QosMetrics m;
+    return m;
+}
+
+static const char* modeName(RegionAnonymizer::Mode mode) {
+    switch (mode) {
+        case RegionAnonymizer::Mode::BACKGROUND: return "background";
+        case RegionAnonymizer::Mode::BLUR: return "blur";
+        case RegionAnonymizer::Mode::PIXELATE: return "pixelate";
+        case RegionAnonymizer::Mode::SOLID: return "solid";
+    }
+    return "unknown";
+}
+
+QosGovernor::QosGovernor(const Parameters& params, const Settings& base)
+    : mParams(params), mBase(base), mSettings(base), mLevel(0), mFallback(false), mRestoreCount(0), mLastP90Us(0) {
+    mParams.windowFrames = std::max(mParams.windowFrames, 1);
+    mParams.restoreWindows = std::max(mParams.restoreWindows, 1);
+    mBase.detectionInterval = std::max(mBase.detectionInterval, 1);
+    mBase.fullFrame = false;
+    mWindow.reserve(mParams.windowFrames);
+    updateSettings();
+}
+
+void QosGovernor::updateSettings() {
+    mSettings = mBase;
+    if (mLevel >= 1) {
+        mSettings.detectionInterval = mBase.detectionInterval * 2;
+    }
+    if (mLevel >= 2) {
+        mSettings.detectionInterval = mBase.detectionInterval * 4;
+    }
+    if (mLevel >= 3) {
+        mSettings.dilationShape = MaskDilator::Shape::NONE;
+    }
+    if (mLevel >= 4) {
+        mSettings.anonymizationMode = RegionAnonymizer::Mode::SOLID;
+    }
+    if (mLevel >= 5) {
+        mSettings.qpOffset = mBase.qpOffset + mParams.qpStep;
+    }
+
+    // The whole frame is replaced with the background if there is one. The
+    // blur is computed on a downscaled frame, the other effects would hide
+    // everything as well but look like a broken stream.
+    if (mFallback) {
+        mSettings.fullFrame = true;
+        mSettings.anonymizationMode = mBase.anonymizationMode == RegionAnonymizer::Mode::BACKGROUND
+                                          ? RegionAnonymizer::Mode::BACKGROUND
+                                          : RegionAnonymizer::Mode::BLUR;
+    }
+}
+
+bool QosGovernor::update(uint64_t frameUs) {
+    mWindow.push_back(frameUs);
+    if (static_cast<int>(mWindow.size()) < mParams.windowFrames) {
+        return false;
+    }
+
+    auto p90 = mWindow.begin() + (mWindow.size() * 9) / 10;
+    std::nth_element(mWindow.begin(), p90, mWindow.end());
+    mLastP90Us = *p90;
+    mWindow.clear();
+
+    QosMetrics& decisions = metrics();
+    const double budgetUs = mParams.budgetMs * 1000.0;
+    bool changed = false;
+    if (mLastP90Us > budgetUs) {
+        // Over budget: one step down per window, and no more waiting for a
+        // mask when far over it
+        mRestoreCount = 0;
+        if (mLastP90Us > budgetUs * mParams.fallbackFactor && !mFallback) {
+            mFallback = true;
+            decisions.fallbackOn.add();
+            changed = true;
+        }
+        if (mLevel < kLevelCount - 1) {
+            ++mLevel;
+            decisions.stepDown.add();
+            changed = true;
+        }
+    } else if (mLastP90Us < budgetUs * mParams.headroom) {
+        // The fallback frames are cheap and say little about the cost of the
+        // current step, so it is released like a step
+        if (++mRestoreCount >= mParams.restoreWindows) {
+            mRestoreCount = 0;
+            if (mFallback) {
+                mFallback = false;
+                decisions.fallbackOff.add();
+                changed = true;
+            } else if (mLevel > 0) {
+                --mLevel;
+                decisions.stepUp.add();
+                changed = true;
+            }
+        }
+    } else {
+        mRestoreCount = 0;
+    }
+
+    if (changed) {
+        updateSettings();
+    }
+    return changed;
+}
+
+const QosGovernor::Settings& QosGovernor::getSettings() const {
+    return mSettings;
+}
+
+int QosGovernor::getLevel() const {
+    return mLevel;
+}
+
+std::string QosGovernor::describe() const {
+    std::ostringstream text;
+    text << "level " << mLevel << " (p90 " << mLastP90Us / 1000.0 << " ms, budget " << mParams.budgetMs << " ms): "
+         << "detect every " << mSettings.detectionInterval << " frames, dilation "
+         << (mSettings.dilationShape == MaskDilator::Shape::NONE ? "off" : "on") << ", mode "
+         << modeName(mSettings.anonymizationMode) << ", QP +" << mSettings.qpOffset;
+    if (mSettings.fullFrame) {
+        text << ", full frame fallback";
+    }
+    return text.str();
+}
@@ -0,0 +1,122 @@
+#ifndef QOS_GOVERNOR_H
+#define QOS_GOVERNOR_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "mask_dilator.h"
+#include "region_anonymizer.h"
+
+/**
+ * @brief Keeps the processing time of the frames within a budget
+ *
+ * Watches the measured frame latency (the sum of the pipeline stages run on
+ * the capture thread) and trades quality for time when it exceeds the
+ * budget. The 90th percentile of every window of frames is compared with the
+ * budget, and the quality moves one step along a ladder:
+ *
+ *     0  the configured settings
+ *     1  detector run half as often
+ *     2  detector run a quarter as often
+ *     3  no mask dilation
+ *     4  SOLID anonymization
+ *     5  encoder QP range raised
+ *
+ * A step is restored after a few windows with enough headroom. When the
+ * budget is badly exceeded, the whole frame is anonymized without running
+ * the detector (background, or blur if the configured mode has no
+ * background), so that a late mask never lets a person through.
+ *
+ * Every decision is counted in the qos.* metrics.
+ */
+class QosGovernor {
+public:
+    /**
+     * @brief Governor parameters
+     */
+    struct Parameters {
+        float budgetMs;          ///< Target processing time of a frame
+        int windowFrames;        ///< Frames measured per decision
+        float headroom;          ///< Quality is restored below this fraction of the budget
+        int restoreWindows;      ///< Consecutive windows with headroom before restoring a step
+        float fallbackFactor;    ///< Full frame anonymization above this multiple of the budget
+        int qpStep;              ///< QP increase of the last step
+        // Constructor with default values
+        Parameters()
+            : budgetMs(100.0f),
+              windowFrames(30),
+              headroom(0.6f),
+              restoreWindows(3),
+              fallbackFactor(2.0f),
+              qpStep(6) {}
+    };
+
+    /**
+     * @brief Quality knobs
+     */
+    struct Settings {
+        int detectionInterval;                      ///< Run the detector every N frames
+        MaskDilator::Shape dilationShape;           ///< Mask dilation
+        RegionAnonymizer::Mode anonymizationMode;   ///< How the persons are hidden
+        int qpOffset;                               ///< Added to the encoder QP range
+        bool fullFrame;                             ///< Anonymize the whole frame without detection
+        // Constructor with default values
+        Settings()
+            : detectionInterval(1),
+              dilationShape(MaskDilator::Shape::DISK),
+              anonymizationMode(RegionAnonymizer::Mode::BACKGROUND),
+              qpOffset(0),
+              fullFrame(false) {}
+    };
+
+    /// Number of quality steps, the configured settings included
+    static constexpr int kLevelCount = 6;
+
+    /**
+     * @brief Constructor
+     *
+     * @param params Governor parameters
+     * @param base Configured settings, used at full quality
+     */
+    QosGovernor(const Parameters& params, const Settings& base);
+
+    /**
+     * @brief Record the processing time of a frame
+     *
+     * @param frameUs Processing time in microseconds
+     * @return true if the settings changed and have to be applied
+     */
+    bool update(uint64_t frameUs);
+
+    /**
+     * @brief Get the settings of the current step
+     */
+    const Settings& getSettings() const;
+
+    /**
+     * @brief Get the current step, 0 being full quality
+     */
+    int getLevel() const;
+
+    /**
+     * @brief Describe the current step, for the logs
+     */
+    std::string describe() const;
+
+private:
+    // Settings of the current level and fallback state
+    void updateSettings();
+
+    Parameters mParams;
+    Settings mBase;
+    Settings mSettings;
+    int mLevel;
+    bool mFallback;
+    int mRestoreCount;
+    // Latencies of the current window
+    std::vector<uint64_t> mWindow;
+    uint64_t mLastP90Us;
+};
+
+#endif // QOS_GOVERNOR_H
@@ -0,0 +1,84 @@
+#include "recording_detector.h"
+#include <iostream>
+
+#include "detection_record.h"
+
+#define TAG "RecordingDetector"
+
+RecordingDetector::RecordingDetector(std::unique_ptr<IDetector> detector, const std::string& path)
+    : mDetector(std::move(detector)), mPath(path), mFile(nullptr), mFrameIndex(0) {
+}
+
+RecordingDetector::~RecordingDetector() {
+    if (mFile) {
+        std::fclose(mFile);
+    }
+}
+
+bool RecordingDetector::initialize() {
+    if (!mDetector || !mDetector->initialize()) {
+        return false;
+    }
+
+    mFile = std::fopen(mPath.c_str(), "wb");
+    if (!mFile) {
+        std::cerr << TAG << ": Could not create the recording " << mPath << std::endl;
+        return false;
+    }
+    mBuffer.clear();
+    DetectionRecord::writeHeader(mBuffer);
+    return std::fwrite(mBuffer.data(), 1, mBuffer.size(), mFile) == mBuffer.size();
+}
+
+void RecordingDetector::setFrameIndex(uint64_t frameIndex) {
+    mFrameIndex = frameIndex;
+    mDetector->setFrameIndex(frameIndex);
+}
+
+bool RecordingDetector::detect(const cv::Mat& img, std::vector<Detection>& detections) {
+    const uint64_t frameIndex = mFrameIndex++;
+    if (!mDetector->detect(img, detections)) {
+        return false;
+    }
+    writeRecord(frameIndex, img.size(), detections, MaskUnion());
+    return true;
+}
+
+bool RecordingDetector::detectWithMaskUnion(const cv::Mat& img, std::vector<Detection>& detections,
+                                            MaskUnion& maskUnion) {
+    const uint64_t frameIndex = mFrameIndex++;
+    if (!mDetector->detectWithMaskUnion(img, detections, maskUnion)) {
+        return false;
+    }
+    writeRecord(frameIndex, img.size(), detections, maskUnion);
+    return true;
+}
+
+void RecordingDetector::writeRecord(uint64_t frameIndex, const cv::Size& frameSize,
+                                    const std::vector<Detection>& detections, const MaskUnion& maskUnion) {
+    if (!mFile) {
+        return;
+    }
+
+    // Written as a whole and flushed, so that a recording stopped abruptly
+    // ends on a complete record
+    mBuffer.clear();
+    DetectionRecord::appendFrame(frameIndex, frameSize, detections, maskUnion, mBuffer);
+    if (std::fwrite(mBuffer.data(), 1, mBuffer.size(), mFile) != mBuffer.size() || std::fflush(mFile) != 0) {
+        std::cerr << TAG << ": Failed to write to " << mPath << ", recording stopped" << std::endl;
+        std::fclose(mFile);
+        mFile = nullptr;
+    }
+}
+
+cv::Size RecordingDetector::getInputSize() const {
+    return mDetector->getInputSize();
+}
+
+int RecordingDetector::getPersonClassId() const {
+    return mDetector->getPersonClassId();
+}
+
+const std::vector<std::string>& RecordingDetector::getClassNames() const {
+    return mDetector->getClassNames();
+}
@@ -0,0 +1,79 @@
+#ifndef RECORDING_DETECTOR_H
+#define RECORDING_DETECTOR_H
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "idetector.h"
+
+/**
+ * @brief Detector decorator that records the detections of another detector
+ *
+ * Every detect() call is forwarded to the wrapped detector, and its results
+ * are appended to a recording (see DetectionRecord) that ReplayDetector can
+ * serve back later, along with the union of the person masks if the
+ * detector returned one. One record is written per detector run, with the index
+ * of the frame given by setFrameIndex(), so that the replay does not depend
+ * on the detection settings of the recording run. Without setFrameIndex()
+ * calls, the runs are numbered as consecutive frames.
+ */
+class RecordingDetector : public IDetector {
+public:
+    /**
+     * @brief Constructor
+     *
+     * @param detector Detector whose detections are recorded
+     * @param path Path of the recording, overwritten
+     */
+    RecordingDetector(std::unique_ptr<IDetector> detector, const std::string& path);
+
+    /**
+     * @brief Destructor. Closes the recording
+     */
+    ~RecordingDetector() override;
+
+    RecordingDetector(const RecordingDetector&) = delete;
+    RecordingDetector& operator=(const RecordingDetector&) = delete;
+
+    /**
+     * @brief Initialize the wrapped detector and create the recording
+     */
+    bool initialize() override;
+
+    /**
+     * @brief Set the index of the frame of the next record, and forward it
+     */
+    void setFrameIndex(uint64_t frameIndex) override;
+
+    /**
+     * @brief Run the wrapped detector and record its detections
+     */
+    bool detect(const cv::Mat& img, std::vector<Detection>& detections) override;
+
+    /**
+     * @brief Run the wrapped detector with a mask union, and record both
+     */
+    bool detectWithMaskUnion(const cv::Mat& img, std::vector<Detection>& detections,
+                             MaskUnion& maskUnion) override;
+
+    cv::Size getInputSize() const override;
+    int getPersonClassId() const override;
+    const std::vector<std::string>& getClassNames() const override;
+
+private:
+    // Append the record of a detector run to the recording
+    void writeRecord(uint64_t frameIndex, const cv::Size& frameSize, const std::vector<Detection>& detections,
+                     const MaskUnion& maskUnion);
+
+    std::unique_ptr<IDetector> mDetector;
+    std::string mPath;
+    FILE* mFile;
+    uint64_t mFrameIndex;
+    // Record being written, reused between frames
+    std::vector<uint8_t> mBuffer;
+};
+
+#endif // RECORDING_DETECTOR_H
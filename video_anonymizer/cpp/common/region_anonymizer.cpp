@@ -0,0 +1,115 @@
+#include "region_anonymizer.h"
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+
+// Size of the box kernel applied on the downscaled region. Larger blurs are
+// obtained by downscaling more, not with a larger kernel.
+static constexpr int kSmallKernel = 5;
+
+// View of a scratch buffer with the requested geometry. The storage only
+// grows, so that the steady state does not allocate when the size of the
+// person regions changes from frame to frame.
+static cv::Mat scratch(cv::Mat& storage, int rows, int cols, int type) {
+    if (storage.type() != type || storage.rows < rows || storage.cols < cols) {
+        storage.create(std::max(rows, storage.rows), std::max(cols, storage.cols), type);
+    }
+    return storage(cv::Rect(0, 0, cols, rows));
+}
+
+RegionAnonymizer::RegionAnonymizer(const Parameters& params)
+    : mParams(params) {
+}
+
+void RegionAnonymizer::setParameters(const Parameters& params) {
+    mParams = params;
+}
+
+const RegionAnonymizer::Parameters& RegionAnonymizer::getParameters() const {
+    return mParams;
+}
+
+bool RegionAnonymizer::parseMode(const std::string& name, Mode& mode) {
+    if (name == "background") {
+        mode = Mode::BACKGROUND;
+    } else if (name == "blur") {
+        mode = Mode::BLUR;
+    } else if (name == "pixelate") {
+        mode = Mode::PIXELATE;
+    } else if (name == "solid") {
+        mode = Mode::SOLID;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+cv::Mat RegionAnonymizer::blur(const cv::Mat& src) {
+    const int ksize = std::max(mParams.blurStrength, 1);
+    cv::Mat effect = scratch(mEffect, src.rows, src.cols, src.type());
+
+    // cv::blur is already O(1) per pixel, downscaling first divides the
+    // number of pixels it has to filter
+    const int factor = ksize / kSmallKernel;
+    if (factor < 2 || src.cols < 2 * factor || src.rows < 2 * factor) {
+        cv::blur(src, effect, cv::Size(ksize, ksize), cv::Point(-1, -1), cv::BORDER_REPLICATE);
+        return effect;
+    }
+
+    const int smallRows = (src.rows + factor - 1) / factor;
+    const int smallCols = (src.cols + factor - 1) / factor;
+    cv::Mat small = scratch(mSmall, smallRows, smallCols, src.type());
+    cv::Mat smallBlurred = scratch(mSmallBlurred, smallRows, smallCols, src.type());
+    cv::resize(src, small, small.size(), 0, 0, cv::INTER_AREA);
+    cv::blur(small, smallBlurred, cv::Size(kSmallKernel, kSmallKernel), cv::Point(-1, -1), cv::BORDER_REPLICATE);
+    cv::resize(smallBlurred, effect, effect.size(), 0, 0, cv::INTER_LINEAR);
+    return effect;
+}
+
+cv::Mat RegionAnonymizer::pixelate(const cv::Mat& src) {
+    const int block = std::max(mParams.pixelSize, 1);
+    cv::Mat effect = scratch(mEffect, src.rows, src.cols, src.type());
+
+    // One pixel per block, averaged over the block, then blown up again
+    const int smallRows = (src.rows + block - 1) / block;
+    const int smallCols = (src.cols + block - 1) / block;
+    cv::Mat small = scratch(mSmall, smallRows, smallCols, src.type());
+    cv::resize(src, small, small.size(), 0, 0, cv::INTER_AREA);
+    cv::resize(small, effect, effect.size(), 0, 0, cv::INTER_NEAREST);
+    return effect;
+}
+
+void RegionAnonymizer::apply(const cv::Mat& frame, const cv::Mat& mask,
+                             const std::vector<cv::Rect>& regions, cv::Mat& dst) {
+    if (dst.data != frame.data) {
+        frame.copyTo(dst);
+    }
+    if (frame.empty() || mask.empty() || mParams.mode == Mode::BACKGROUND) {
+        return;
+    }
+    CV_Assert(mask.size() == frame.size() && mask.type() == CV_8UC1);
+
+    const cv::Rect frameRect(0, 0, frame.cols, frame.rows);
+    for (const cv::Rect& region : regions) {
+        const cv::Rect r = region & frameRect;
+        if (r.empty()) {
+            continue;
+        }
+        // The regions do not overlap, so the effect only reads pixels that
+        // were not anonymized yet, even in place
+        cv::Mat out = dst(r);
+        const cv::Mat m = mask(r);
+        switch (mParams.mode) {
+            case Mode::SOLID:
+                out.setTo(mParams.solidColor, m);
+                break;
+            case Mode::BLUR:
+                blur(frame(r)).copyTo(out, m);
+                break;
+            case Mode::PIXELATE:
+                pixelate(frame(r)).copyTo(out, m);
+                break;
+            default:
+                break;
+        }
+    }
+}
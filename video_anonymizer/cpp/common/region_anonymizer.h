@@ -0,0 +1,102 @@
+#ifndef REGION_ANONYMIZER_H
+#define REGION_ANONYMIZER_H
+
+#include <opencv2/core.hpp>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Anonymization effects that do not need a background model
+ *
+ * C++ counterpart of the blur and solid modes of the Python implementation,
+ * plus pixelation. The effects are only computed inside the person regions,
+ * then copied to the output through the mask, so their cost follows the area
+ * of the persons and not the frame size:
+ * - BLUR: box blur, applied on a downscaled copy of the region when the
+ *   kernel is large, then upscaled back (O(1) per pixel whatever the strength)
+ * - PIXELATE: area downscaling of the region, upscaled with nearest neighbor
+ * - SOLID: constant color, no temporary image at all
+ *
+ * BACKGROUND is handled by the background models (see IBackgroundModel) and
+ * leaves the frame unchanged here.
+ *
+ * The temporary buffers are kept between calls and only grow.
+ */
+class RegionAnonymizer {
+public:
+    /// Anonymization effect
+    enum class Mode {
+        BACKGROUND,   ///< Replace persons with the background model (not handled here)
+        BLUR,         ///< Blur the persons
+        PIXELATE,     ///< Replace the persons with large blocks
+        SOLID         ///< Fill the persons with a constant color
+    };
+
+    /**
+     * @brief Effect parameters
+     */
+    struct Parameters {
+        Mode mode;              ///< Anonymization effect
+        int blurStrength;       ///< Size of the blur kernel in pixels
+        int pixelSize;          ///< Size of the pixelation blocks in pixels
+        cv::Scalar solidColor;  ///< Fill color of SOLID
+        // Constructor with default values
+        Parameters()
+            : mode(Mode::BLUR),
+              blurStrength(21),
+              pixelSize(16),
+              solidColor(cv::Scalar::all(127)) {}
+    };
+
+    /**
+     * @brief Constructor
+     *
+     * @param params Effect parameters
+     */
+    explicit RegionAnonymizer(const Parameters& params = Parameters());
+
+    /**
+     * @brief Set the effect parameters
+     *
+     * @param params New parameters
+     */
+    void setParameters(const Parameters& params);
+
+    /**
+     * @brief Get the effect parameters
+     *
+     * @return const Parameters& Current parameters
+     */
+    const Parameters& getParameters() const;
+
+    /**
+     * @brief Anonymize the masked pixels
+     *
+     * @param frame Input frame (CV_8UC1 or CV_8UC3)
+     * @param mask CV_8UC1 mask of person pixels, only read inside the regions
+     * @param regions Non-overlapping rectangles containing all the person pixels
+     * @param dst Anonymized output. Allocated if needed. May be the same Mat as frame
+     */
+    void apply(const cv::Mat& frame, const cv::Mat& mask, const std::vector<cv::Rect>& regions, cv::Mat& dst);
+
+    /**
+     * @brief Parse a mode name ("background", "blur", "pixelate" or "solid")
+     *
+     * @param name Name of the mode
+     * @param mode Parsed mode
+     * @return true if the name is valid
+     */
+    static bool parseMode(const std::string& name, Mode& mode);
+
+private:
+    // Effect of one region, returned as a view of mEffect
+    cv::Mat blur(const cv::Mat& src);
+    cv::Mat pixelate(const cv::Mat& src);
+
+    Parameters mParams;
+    cv::Mat mSmall;
+    cv::Mat mSmallBlurred;
+    cv::Mat mEffect;
+};
+
+#endif // REGION_ANONYMIZER_H
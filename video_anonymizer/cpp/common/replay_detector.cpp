@@ -0,0 +1,185 @@
+#include "replay_detector.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define TAG "ReplayDetector"
+
+ReplayDetector::ReplayDetector(const std::string& recordingPath, const std::string& namesPath, bool loop)
+    : mRecordingPath(recordingPath),
+      mLoop(loop),
+      mPersonClassId(0),
+      mMapping(nullptr),
+      mMappingSize(0),
+      mData(nullptr),
+      mSize(0),
+      mFrameIndex(0),
+      mReportedEnd(false) {
+    std::ifstream file(namesPath);
+    std::string line;
+    while (std::getline(file, line)) {
+        if (!line.empty()) {
+            mClassNames.push_back(line);
+        }
+    }
+    auto it = std::find(mClassNames.begin(), mClassNames.end(), "person");
+    if (it != mClassNames.end()) {
+        mPersonClassId = static_cast<int>(std::distance(mClassNames.begin(), it));
+    } else if (mClassNames.empty()) {
+        mClassNames.push_back("person");
+    }
+}
+
+ReplayDetector::~ReplayDetector() {
+    if (mMapping) {
+        munmap(mMapping, mMappingSize);
+    }
+}
+
+bool ReplayDetector::initialize() {
+    const int fd = open(mRecordingPath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << TAG << ": Could not open " << mRecordingPath << std::endl;
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        mMappingSize = static_cast<size_t>(st.st_size);
+        void* mapping = mmap(nullptr, mMappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        mMapping = mapping == MAP_FAILED ? nullptr : mapping;
+    }
+    close(fd);
+    if (!mMapping) {
+        std::cerr << TAG << ": Could not map " << mRecordingPath << std::endl;
+        return false;
+    }
+
+    mData = static_cast<const uint8_t*>(mMapping);
+    mSize = mMappingSize;
+    if (!DetectionRecord::checkHeader(mData, mSize)) {
+        // Not a recording, try an SSCMA log
+        munmap(mMapping, mMappingSize);
+        mMapping = nullptr;
+        if (!DetectionRecord::importSscmaLog(mRecordingPath, mImported)) {
+            std::cerr << TAG << ": " << mRecordingPath << " is neither a recording nor an SSCMA log" << std::endl;
+            return false;
+        }
+        mData = mImported.data();
+        mSize = mImported.size();
+    }
+
+    mRecords = DetectionRecord::indexFrames(mData, mSize);
+    if (mRecords.empty()) {
+        std::cerr << TAG << ": " << mRecordingPath << " has no record" << std::endl;
+        return false;
+    }
+    // The frame indices restart if the recording run was reset. The last
+    // record of a frame is the one served.
+    std::stable_sort(mRecords.begin(), mRecords.end(),
+                     [](const DetectionRecord::Entry& a, const DetectionRecord::Entry& b) {
+                         return a.frameIndex < b.frameIndex;
+                     });
+    std::vector<Detection> first;
+    MaskUnion firstUnion;
+    DetectionRecord::readFrame(mData, mSize, mRecords[0].offset, mInputSize, first, firstUnion);
+    mFrameIndex = 0;
+    mReportedEnd = false;
+
+    std::cout << TAG << ": Replaying " << mRecords.size() << " detector runs from " << mRecordingPath << std::endl;
+    return true;
+}
+
+void ReplayDetector::setFrameIndex(uint64_t frameIndex) {
+    mFrameIndex = frameIndex;
+}
+
+// Box recorded on a frame of another size, scaled to the current frame
+static cv::Rect scaleBox(const cv::Rect& box, double sx, double sy) {
+    const int x0 = cvRound(box.x * sx);
+    const int y0 = cvRound(box.y * sy);
+    const int x1 = cvRound(box.br().x * sx);
+    const int y1 = cvRound(box.br().y * sy);
+    return cv::Rect(x0, y0, x1 - x0, y1 - y0);
+}
+
+bool ReplayDetector::detect(const cv::Mat& img, std::vector<Detection>& detections) {
+    // The persons whose mask is in the union are left without a mask, so
+    // their whole box is anonymized
+    return serveFrame(img, detections, mDroppedUnion);
+}
+
+bool ReplayDetector::detectWithMaskUnion(const cv::Mat& img, std::vector<Detection>& detections,
+                                         MaskUnion& maskUnion) {
+    return serveFrame(img, detections, maskUnion);
+}
+
+bool ReplayDetector::serveFrame(const cv::Mat& img, std::vector<Detection>& detections, MaskUnion& maskUnion) {
+    detections.clear();
+    maskUnion = MaskUnion();
+    uint64_t frameIndex = mFrameIndex++;
+    if (mRecords.empty()) {
+        return false;
+    }
+
+    // Past the end, the detections of other frames would be applied: the
+    // caller anonymizes the whole frame instead
+    const uint64_t lastFrame = mRecords.back().frameIndex;
+    if (frameIndex > lastFrame) {
+        if (!mLoop) {
+            if (!mReportedEnd) {
+                std::cerr << TAG << ": The recording ends at frame " << lastFrame
+                          << ", no detections from frame " << frameIndex << std::endl;
+                mReportedEnd = true;
+            }
+            return false;
+        }
+        frameIndex %= lastFrame + 1;
+    }
+
+    // Latest record at or before the frame
+    auto next = std::upper_bound(mRecords.begin(), mRecords.end(), frameIndex,
+                                 [](uint64_t index, const DetectionRecord::Entry& entry) {
+                                     return index < entry.frameIndex;
+                                 });
+    if (next == mRecords.begin()) {
+        return false;
+    }
+    const DetectionRecord::Entry& record = *(next - 1);
+
+    cv::Size recordedSize;
+    if (!DetectionRecord::readFrame(mData, mSize, record.offset, recordedSize, detections, maskUnion)) {
+        std::cerr << TAG << ": Invalid record of frame " << record.frameIndex << std::endl;
+        detections.clear();
+        maskUnion = MaskUnion();
+        return false;
+    }
+
+    // Masks cover their box and are stretched to it, only the boxes change
+    // with the frame size. They are not clipped to the frame, which would
+    // move the masks.
+    if (!img.empty() && recordedSize.area() > 0 && img.size() != recordedSize) {
+        const double sx = static_cast<double>(img.cols) / recordedSize.width;
+        const double sy = static_cast<double>(img.rows) / recordedSize.height;
+        for (Detection& det : detections) {
+            det.bbox = scaleBox(det.bbox, sx, sy);
+        }
+        maskUnion.bbox = scaleBox(maskUnion.bbox, sx, sy);
+    }
+    return true;
+}
+
+cv::Size ReplayDetector::getInputSize() const {
+    return mInputSize;
+}
+
+int ReplayDetector::getPersonClassId() const {
+    return mPersonClassId;
+}
+
+const std::vector<std::string>& ReplayDetector::getClassNames() const {
+    return mClassNames;
+}
@@ -0,0 +1,113 @@
+#ifndef REPLAY_DETECTOR_H
+#define REPLAY_DETECTOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "detection_record.h"
+#include "idetector.h"
+
+/**
+ * @brief Detector serving the detections of a recording
+ *
+ * Replays a recording made by RecordingDetector, or an SSCMA detection log
+ * (see DetectionRecord::importSscmaLog), without any model. Lets the rest of
+ * the pipeline be benchmarked without the detector, and a video be
+ * re-anonymized with other settings without running the model again.
+ *
+ * Each detect() call returns the record of the frame given by
+ * setFrameIndex(), so the detections stay on the frames they were computed
+ * on whatever the detection interval, motion gate or asynchronous settings
+ * of both runs. A frame without a record of its own gets the latest record
+ * before it, like the recording run used the latest detections. Without
+ * setFrameIndex() calls, the calls are consecutive frames.
+ *
+ * detect() fails on the frames before the first record, and after the last
+ * one unless looping, so that these frames are never shown with masks of
+ * other frames.
+ *
+ * The union of the person masks is served by detectWithMaskUnion() if it
+ * was recorded. detect() leaves the persons of the union without a mask,
+ * so their whole box is anonymized.
+ *
+ * Recordings are memory mapped and decoded one record at a time.
+ * Detections recorded on a frame of another size are scaled to the frame.
+ */
+class ReplayDetector : public IDetector {
+public:
+    /**
+     * @brief Constructor
+     *
+     * @param recordingPath Path of the recording or the SSCMA log
+     * @param namesPath Path of the class names file
+     * @param loop Whether the frames after the last record start over at
+     *             frame 0 of the recording, for benchmarks on a looping input.
+     *             Otherwise detect() fails on them
+     */
+    ReplayDetector(const std::string& recordingPath, const std::string& namesPath, bool loop = false);
+
+    /**
+     * @brief Destructor. Unmaps the recording
+     */
+    ~ReplayDetector() override;
+
+    ReplayDetector(const ReplayDetector&) = delete;
+    ReplayDetector& operator=(const ReplayDetector&) = delete;
+
+    /**
+     * @brief Map and index the recording
+     */
+    bool initialize() override;
+
+    /**
+     * @brief Set the index of the frame of the next detect() call
+     */
+    void setFrameIndex(uint64_t frameIndex) override;
+
+    /**
+     * @brief Return the detections recorded for the current frame
+     */
+    bool detect(const cv::Mat& img, std::vector<Detection>& detections) override;
+
+    /**
+     * @brief Return the detections and the mask union recorded for the current frame
+     */
+    bool detectWithMaskUnion(const cv::Mat& img, std::vector<Detection>& detections,
+                             MaskUnion& maskUnion) override;
+
+    /**
+     * @brief Get the frame size of the first record
+     */
+    cv::Size getInputSize() const override;
+
+    int getPersonClassId() const override;
+    const std::vector<std::string>& getClassNames() const override;
+
+private:
+    // Decode the record of the current frame, and move on to the next frame
+    bool serveFrame(const cv::Mat& img, std::vector<Detection>& detections, MaskUnion& maskUnion);
+
+    std::string mRecordingPath;
+    bool mLoop;
+    std::vector<std::string> mClassNames;
+    int mPersonClassId;
+
+    // Mapped recording, or mImported for an SSCMA log
+    void* mMapping;
+    size_t mMappingSize;
+    std::vector<uint8_t> mImported;
+    const uint8_t* mData;
+    size_t mSize;
+
+    // Records sorted by frame index, in file order for the same frame
+    std::vector<DetectionRecord::Entry> mRecords;
+    uint64_t mFrameIndex;
+    bool mReportedEnd;
+    // Union of the records served by detect()
+    MaskUnion mDroppedUnion;
+    cv::Size mInputSize;
+};
+
+#endif // REPLAY_DETECTOR_H
@@ -0,0 +1,188 @@
+#include "tracer.h"
+#include <cstdio>
+#include <cstring>
+
+#include "metrics.h"
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+static_assert((Tracer::kEventsPerThread & (Tracer::kEventsPerThread - 1)) == 0,
+              "Tracer ring size must be a power of 2");
+
+// The fields are atomics because the export may read a slot while its thread
+// overwrites it. Relaxed accesses compile to plain loads and stores.
+struct Tracer::Event {
+    std::atomic<const char*> name;
+    std::atomic<uint64_t> startUs;
+    std::atomic<uint64_t> durationUs;
+    std::atomic<uint64_t> frame;
+};
+
+// Ring of one thread, written by that thread only. claimed is bumped before
+// a slot is overwritten and written after, so the export can tell which of
+// the slots it copied were overwritten meanwhile.
+struct Tracer::ThreadBuffer {
+    long tid;
+    char name[32];
+    Event events[kEventsPerThread];
+    std::atomic<uint64_t> claimed;
+    std::atomic<uint64_t> written;
+};
+
+thread_local Tracer::ThreadBuffer* Tracer::tBuffer = nullptr;
+static thread_local uint64_t tFrame = 0;
+static thread_local char tThreadName[32] = "";
+
+// Copy of an event taken by the export
+struct EventCopy {
+    const char* name;
+    uint64_t startUs;
+    uint64_t durationUs;
+    uint64_t frame;
+};
+
+Tracer& Tracer::instance() {
+    static Tracer tracer;
+    return tracer;
+}
+
+Tracer::Tracer() : mEnabled(false), mNextFrame(1), mStartUs(MetricsRegistry::nowUs()) {
+}
+
+Tracer::ThreadBuffer& Tracer::threadBuffer() {
+    if (tBuffer) {
+        return *tBuffer;
+    }
+
+    std::unique_ptr<ThreadBuffer> buffer(new ThreadBuffer());
+#ifdef __linux__
+    buffer->tid = static_cast<long>(syscall(SYS_gettid));
+#else
+    buffer->tid = 0;
+#endif
+    buffer->claimed.store(0, std::memory_order_relaxed);
+    buffer->written.store(0, std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (buffer->tid == 0) {
+        buffer->tid = static_cast<long>(mBuffers.size() + 1);
+    }
+    if (tThreadName[0]) {
+        std::snprintf(buffer->name, sizeof(buffer->name), "%s", tThreadName);
+    } else {
+        std::snprintf(buffer->name, sizeof(buffer->name), "thread %ld", buffer->tid);
+    }
+    // Kept until the end of the process, so the events of finished threads
+    // can still be exported
+    tBuffer = buffer.get();
+    mBuffers.push_back(std::move(buffer));
+    return *tBuffer;
+}
+
+void Tracer::record(const char* name, uint64_t startUs, uint64_t durationUs) {
+    ThreadBuffer& buffer = threadBuffer();
+    const uint64_t index = buffer.claimed.load(std::memory_order_relaxed);
+    buffer.claimed.store(index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    Event& event = buffer.events[index & (kEventsPerThread - 1)];
+    event.name.store(name, std::memory_order_relaxed);
+    event.startUs.store(startUs, std::memory_order_relaxed);
+    event.durationUs.store(durationUs, std::memory_order_relaxed);
+    event.frame.store(tFrame, std::memory_order_relaxed);
+
+    buffer.written.store(index + 1, std::memory_order_release);
+}
+
+void Tracer::setThreadName(const char* name) {
+    std::snprintf(tThreadName, sizeof(tThreadName), "%s", name);
+    if (tBuffer) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        std::snprintf(tBuffer->name, sizeof(tBuffer->name), "%s", name);
+    }
+}
+
+bool Tracer::exportJson(const std::string& path) {
+    FILE* file = std::fopen(path.c_str(), "w");
+    if (!file) {
+        return false;
+    }
+
+    // The buffers are never freed, only the list needs the lock
+    std::vector<ThreadBuffer*> buffers;
+    std::vector<std::string> names;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        for (const auto& buffer : mBuffers) {
+            buffers.push_back(buffer.get());
+            names.emplace_back(buffer->name);
+        }
+    }
+
+    std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    const char* separator = "";
+    std::vector<EventCopy> events;
+    for (size_t b = 0; b < buffers.size(); ++b) {
+        ThreadBuffer& buffer = *buffers[b];
+        std::fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%ld,\"args\":{\"name\":\"%s\"}}",
+                     separator, buffer.tid, names[b].c_str());
+        separator = ",\n";
+
+        // Copy the ring, then drop the slots that were overwritten during the copy
+        const uint64_t written = buffer.written.load(std::memory_order_acquire);
+        const uint64_t first = written > kEventsPerThread ? written - kEventsPerThread : 0;
+        events.clear();
+        for (uint64_t i = first; i < written; ++i) {
+            const Event& event = buffer.events[i & (kEventsPerThread - 1)];
+            events.push_back({event.name.load(std::memory_order_relaxed),
+                              event.startUs.load(std::memory_order_relaxed),
+                              event.durationUs.load(std::memory_order_relaxed),
+                              event.frame.load(std::memory_order_relaxed)});
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const uint64_t claimed = buffer.claimed.load(std::memory_order_relaxed);
+        const uint64_t valid = claimed > kEventsPerThread ? claimed - kEventsPerThread : 0;
+        const size_t skip = valid > first ? static_cast<size_t>(valid - first) : 0;
+
+        for (size_t i = skip; i < events.size(); ++i) {
+            const EventCopy& event = events[i];
+            const long long ts = static_cast<long long>(event.startUs) - static_cast<long long>(mStartUs);
+            std::fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%ld,\"ts\":%lld,\"dur\":%llu",
+                         event.name, buffer.tid, ts, static_cast<unsigned long long>(event.durationUs));
+            if (event.frame != 0) {
+                std::fprintf(file, ",\"args\":{\"frame\":%llu}", static_cast<unsigned long long>(event.frame));
+            }
+            std::fputc('}', file);
+        }
+    }
+    std::fprintf(file, "\n]}\n");
+
+    const bool ok = std::ferror(file) == 0;
+    return std::fclose(file) == 0 && ok;
+}
+
+uint64_t Tracer::beginFrame() {
+    tFrame = instance().mNextFrame.fetch_add(1, std::memory_order_relaxed);
+    return tFrame;
+}
+
+void Tracer::setFrame(uint64_t frameId) {
+    tFrame = frameId;
+}
+
+uint64_t Tracer::currentFrame() {
+    return tFrame;
+}
+
+TraceScope::TraceScope(const char* name)
+    : mName(name), mStartUs(Tracer::instance().enabled() ? MetricsRegistry::nowUs() : 0) {
+}
+
+TraceScope::~TraceScope() {
+    if (mStartUs != 0) {
+        Tracer::instance().record(mName, mStartUs, MetricsRegistry::nowUs() - mStartUs);
+    }
+}
@@ -0,0 +1,141 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Timeline of the pipeline threads, exported in the Chrome trace format
+ *
+ * Every thread records its scoped events (name, start, duration and the id of
+ * the frame being worked on) into its own ring buffer, so recording takes no
+ * lock and the threads never wait for each other. A ring keeps the last
+ * kEventsPerThread events of its thread. exportJson() writes the rings as a
+ * Chrome trace (chrome://tracing, https://ui.perfetto.dev), which shows how the
+ * capture, detection, encoding and streaming threads overlap and where they
+ * wait.
+ *
+ * Recording is off until setEnabled(true), and a disabled tracer costs one
+ * load per scope. The TRACE_* macros compile to nothing unless ENABLE_TRACING
+ * is defined, so the release builds do not even pay for that load.
+ */
+class Tracer {
+public:
+    /// Events kept per thread (power of 2), the oldest ones are overwritten
+    static constexpr size_t kEventsPerThread = 4096;
+
+    /**
+     * @brief Get the process tracer
+     */
+    static Tracer& instance();
+
+    Tracer(const Tracer&) = delete;
+    Tracer& operator=(const Tracer&) = delete;
+
+    /**
+     * @brief Start or stop recording
+     */
+    void setEnabled(bool enabled) { mEnabled.store(enabled, std::memory_order_relaxed); }
+    bool enabled() const { return mEnabled.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Record an event of the calling thread
+     *
+     * @param name Event name, string literal (only the pointer is stored)
+     * @param startUs Start time, MetricsRegistry::nowUs() clock
+     * @param durationUs Duration in microseconds
+     */
+    void record(const char* name, uint64_t startUs, uint64_t durationUs);
+
+    /**
+     * @brief Name the calling thread in the exported timeline
+     *
+     * @param name Thread name, copied
+     */
+    void setThreadName(const char* name);
+
+    /**
+     * @brief Write the recorded events as a Chrome trace JSON file
+     *
+     * May be called while the other threads keep recording: events overwritten
+     * during the export are left out.
+     *
+     * @param path Output file
+     * @return true if the file was written
+     */
+    bool exportJson(const std::string& path);
+
+    /**
+     * @brief Allocate a new frame id and make it the frame of the calling thread
+     *
+     * Called where a frame enters the pipeline. Ids start at 1.
+     */
+    static uint64_t beginFrame();
+
+    /**
+     * @brief Set the frame the calling thread works on, 0 for none
+     *
+     * Called by the threads that take a frame over from another thread.
+     */
+    static void setFrame(uint64_t frameId);
+
+    /**
+     * @brief Frame the calling thread works on, 0 for none
+     */
+    static uint64_t currentFrame();
+
+private:
+    struct Event;
+    struct ThreadBuffer;
+
+    Tracer();
+
+    // Ring of the calling thread, created on its first event
+    ThreadBuffer& threadBuffer();
+
+    std::atomic<bool> mEnabled;
+    std::atomic<uint64_t> mNextFrame;
+    uint64_t mStartUs;
+    std::mutex mMutex;   // Guards mBuffers
+    std::vector<std::unique_ptr<ThreadBuffer>> mBuffers;
+
+    static thread_local ThreadBuffer* tBuffer;
+};
+
+/**
+ * @brief Records the lifetime of a scope as a trace event
+ */
+class TraceScope {
+public:
+    explicit TraceScope(const char* name);
+    ~TraceScope();
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* mName;
+    uint64_t mStartUs;   // 0 when the tracer was disabled at construction
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+#ifdef ENABLE_TRACING
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+#define TRACE_BEGIN_FRAME() Tracer::beginFrame()
+#define TRACE_SET_FRAME(frameId) Tracer::setFrame(frameId)
+#define TRACE_THREAD_NAME(name) Tracer::instance().setThreadName(name)
+#else
+#define TRACE_SCOPE(name) do {} while (0)
+#define TRACE_BEGIN_FRAME() do {} while (0)
+#define TRACE_SET_FRAME(frameId) do {} while (0)
+#define TRACE_THREAD_NAME(name) do {} while (0)
+#endif
+
+#endif // TRACER_H
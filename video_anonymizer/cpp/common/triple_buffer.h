@@ -0,0 +1,72 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * @brief Lock-free hand-over of the latest value from one producer to one consumer
+ *
+ * Three slots: the producer writes the back slot, the consumer reads the
+ * front slot, and the middle slot holds the latest published value. Both
+ * sides only exchange their slot index with the middle one, so neither ever
+ * waits for the other, and the values are never copied. A value published
+ * before the consumer takes it is replaced by the next one.
+ *
+ * @tparam T Type of the slots
+ */
+template <typename T>
+class TripleBuffer {
+public:
+    TripleBuffer() : mBack(0), mMiddle(1), mFront(2) {}
+
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    /**
+     * @brief Producer: slot to write the next value in
+     */
+    T& back() { return mSlots[mBack]; }
+
+    /**
+     * @brief Producer: publish the back slot, and take another one to write
+     */
+    void publish() {
+        mBack = mMiddle.exchange(static_cast<uint8_t>(mBack | kDirty), std::memory_order_acq_rel) & kIndexMask;
+    }
+
+    /**
+     * @brief Check if a value was published since the consumer last took one
+     */
+    bool hasNew() const { return (mMiddle.load(std::memory_order_acquire) & kDirty) != 0; }
+
+    /**
+     * @brief Consumer: take the latest published value into the front slot
+     *
+     * @return true if there was a new value, false if the front slot is unchanged
+     */
+    bool update() {
+        if (!hasNew()) {
+            return false;
+        }
+        mFront = mMiddle.exchange(mFront, std::memory_order_acq_rel) & kIndexMask;
+        return true;
+    }
+
+    /**
+     * @brief Consumer: slot holding the value taken by the last update()
+     */
+    T& front() { return mSlots[mFront]; }
+    const T& front() const { return mSlots[mFront]; }
+
+private:
+    static constexpr uint8_t kIndexMask = 0x3;
+    static constexpr uint8_t kDirty = 0x4;
+
+    T mSlots[3];
+    uint8_t mBack;                 ///< Owned by the producer
+    std::atomic<uint8_t> mMiddle;  ///< Index of the middle slot, and kDirty when it was not taken yet
+    uint8_t mFront;                ///< Owned by the consumer
+};
+
+#endif // TRIPLE_BUFFER_H
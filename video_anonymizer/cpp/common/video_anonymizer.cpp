@@ -1,13 +1,99 @@
 #include "video_anonymizer.h"
 #include <opencv2/imgproc.hpp>
+#include <algorithm>
 #include <iostream>
 
 #include "detector_factory.h"
+#include "metrics.h"
+#include "tracer.h"
 
-VideoAnonymizer::VideoAnonymizer(const Parameters& params)
-    : mParams(params), mFrameCount(0), mLastDetectionMask(cv::Mat()), mLastDetections(), mBackground(cv::Mat()) {
-    
-    // Initialize human detector
+// Latencies of the anonymizer stages
+struct AnonymizerMetrics {
+    LatencyHistogram& detect;
+    LatencyHistogram& mask;
+    LatencyHistogram& composite;
+    LatencyHistogram& frame;
+    // Motion gate decisions: the hit rate is skipped / (skipped + changed + forced)
+    MetricCounter& gateSkipped;
+    MetricCounter& gateChanged;
+    MetricCounter& gateForced;
+
+    AnonymizerMetrics()
+        : detect(MetricsRegistry::instance().histogram("anonymizer.detect")),
+          mask(MetricsRegistry::instance().histogram("anonymizer.mask")),
+          composite(MetricsRegistry::instance().histogram("anonymizer.composite")),
+          frame(MetricsRegistry::instance().histogram("anonymizer.frame")),
+          gateSkipped(MetricsRegistry::instance().counter("gate.skipped")),
+          gateChanged(MetricsRegistry::instance().counter("gate.changed")),
+          gateForced(MetricsRegistry::instance().counter("gate.forced")) {}
+};
+
+static AnonymizerMetrics& metrics() {
+    static AnonymizerMetrics m;
+    return m;
+}
+
+// Merge the overlapping rectangles, and sort the result by x
+static void mergeRegions(std::vector<cv::Rect>& regions) {
+    bool merged = true;
+    while (merged) {
+        merged = false;
+        for (size_t i = 0; i < regions.size() && !merged; ++i) {
+            for (size_t j = i + 1; j < regions.size(); ++j) {
+                if ((regions[i] & regions[j]).area() > 0) {
+                    // The union may now overlap rectangles already checked, so start over
+                    regions[i] |= regions[j];
+                    regions.erase(regions.begin() + j);
+                    merged = true;
+                    break;
+                }
+            }
+        }
+    }
+    std::sort(regions.begin(), regions.end(), [](const cv::Rect& a, const cv::Rect& b) { return a.x < b.x; });
+}
+
+// Clear the given regions of a mask
+static void clearRegions(cv::Mat& mask, const std::vector<cv::Rect>& regions) {
+    for (const cv::Rect& r : regions) {
+        mask(r).setTo(cv::Scalar(0));
+    }
+}
+
+// Tracker configuration from the anonymizer parameters
+static PersonTracker::Parameters trackerParameters(const VideoAnonymizer::Parameters& params) {
+    PersonTracker::Parameters trackerParams;
+    trackerParams.trackHistory = params.trackHistory;
+    return trackerParams;
+}
+
+// Motion gate configuration from the anonymizer parameters
+static MotionGate::Parameters motionGateParameters(const VideoAnonymizer::Parameters& params) {
+    MotionGate::Parameters gateParams;
+    gateParams.refreshInterval = params.gateRefreshInterval;
+    return gateParams;
+}
+
+// Background model configuration from the anonymizer parameters
+static BackgroundModelFactory::Parameters backgroundModelParameters(const VideoAnonymizer::Parameters& params) {
+    BackgroundModelFactory::Parameters modelParams;
+    modelParams.type = params.backgroundModel;
+    modelParams.learningRate = params.learningRate;
+    modelParams.foregroundMasking = params.foregroundMasking;
+    return modelParams;
+}
+
+// Effect configuration from the anonymizer parameters
+static RegionAnonymizer::Parameters regionAnonymizerParameters(const VideoAnonymizer::Parameters& params) {
+    RegionAnonymizer::Parameters effectParams;
+    effectParams.mode = params.anonymizationMode;
+    effectParams.blurStrength = params.blurStrength;
+    effectParams.pixelSize = params.pixelSize;
+    return effectParams;
+}
+
+// Detector configuration from the anonymizer parameters
+static DetectorFactory::Parameters detectorParameters(const VideoAnonymizer::Parameters& params) {
     DetectorFactory::Parameters detectorParams;
     detectorParams.modelPath = params.modelPath;
     detectorParams.labelsPath = params.labelsPath;
@@ -15,90 +101,130 @@ VideoAnonymizer::VideoAnonymizer(const Parameters& params)
     detectorParams.iouThreshold = params.iouThreshold;
     detectorParams.useGPU = params.useGPU;
     detectorParams.debugMode = params.debugMode;
+    detectorParams.recordPath = params.recordPath;
+    detectorParams.replayPath = params.replayPath;
+    detectorParams.replayLoop = params.replayLoop;
+    return detectorParams;
+}
+
+VideoAnonymizer::VideoAnonymizer(const Parameters& params)
+    : VideoAnonymizer(params, DetectorFactory::createDetector(detectorParameters(params))) {}
+
+VideoAnonymizer::VideoAnonymizer(const Parameters& params, std::unique_ptr<IDetector> detector)
+    : mParams(params), mDetector(std::move(detector)), mBackgroundModel(BackgroundModelFactory::createBackgroundModel(backgroundModelParameters(params))), mDilator(params.dilationShape), mRegionAnonymizer(regionAnonymizerParameters(params)), mTracker(trackerParameters(params)), mGate(motionGateParameters(params)), mLastDetectionMask(cv::Mat()), mFrameCount(0), mLastDetections(), mMaskFrame(0), mHasMask(false), mMaskAge(-1), mFullFrameFallback(false) {
     
-    mDetector = DetectorFactory::createDetector(detectorParams);
-    
+    if (params.foregroundMasking && !mBackgroundModel->hasForeground()) {
+        std::cerr << "The selected background model has no foreground, foreground masking is ignored" << std::endl;
+    }
+
     if (!mDetector || !mDetector->initialize()) {
         std::cerr << "Failed to initialize detector" << std::endl;
         throw std::runtime_error("Detector initialization failed");
     }
+
+    if (params.asyncDetection) {
+        mAsyncDetector = std::make_unique<AsyncDetector>(*mDetector);
+        mAsyncDetector->start();
+    }
 }
 
 VideoAnonymizer::~VideoAnonymizer() = default;
 
-void VideoAnonymizer::updateBackground(const cv::Mat& frame, const cv::Mat& humanMask) {
-    // If background is not initialized, initialize it with a grey image of the same size
-    if (mBackground.empty()) {
-        //mBackground = cv::Mat(frame.rows, frame.cols, CV_32FC(frame.channels()), cv::Scalar(127, 127, 127));
-        mBackground = cv::Mat(frame.rows, frame.cols, CV_8UC(frame.channels()), cv::Scalar(127, 127, 127));
-    }
-    
-    // Create a mask for areas without humans (inverse of humanMask)
-    cv::Mat bgUpdateMask;
-    cv::bitwise_not(humanMask, bgUpdateMask);
-    
-    // Apply learning rate to update the background
-    // For areas without humans: bg = (1-alpha) * bg + alpha * frame
-    // accumulateWeighted updates mBackground in-place
-    try {
-        cv::Mat backgroundFloat;
-        mBackground.convertTo(backgroundFloat, CV_32FC(frame.channels()));
-        cv::accumulateWeighted(frame, backgroundFloat, mParams.learningRate, bgUpdateMask);
-        backgroundFloat.convertTo(mBackground,CV_8UC(frame.channels()));
-    } catch (const std::exception &e) {
-        std::cerr << "Exception at accumulateWeighted: " << e.what() << std::endl;
-#ifndef TARGET_RECAMERA
-        std::cerr << "frame: channels " << frame.channels() 
-                  << " type " << cv::typeToString(frame.type())
-                  << " size " << frame.size << std::endl;
-        std::cerr << "mBackground: channels " << mBackground.channels() 
-                  << " type " << cv::typeToString(frame.type())
-                  << " size " << mBackground.size << std::endl;
-        std::cerr << "bgUpdateMask: channels " << bgUpdateMask.channels() 
-                  << " type " << cv::typeToString(frame.type())
-                  << " size " << bgUpdateMask.size << std::endl;
-#endif
+void VideoAnonymizer::updateAndApplyBackground(const cv::Mat& frame, const cv::Mat& mask, cv::Mat& output) {
+    // For areas without humans: bg = (1-alpha) * bg + alpha * frame.
+    // Human pixels are replaced with the background in the same pass, so the
+    // frame, the mask and the model are only read once. If the model is not
+    // initialized yet, it starts from a grey image of the same size.
+    // The mask is only read inside the person regions, the rest of the frame
+    // takes the cheaper mask-free path (background update only when in place).
+    // The CNT model may also hide its foreground, as a backup for missed persons.
+    mBackgroundModel->setLearningRate(mParams.learningRate);
+    mBackgroundModel->updateAndComposite(frame, mask, mPersonRegions, output);
+}
+
+void VideoAnonymizer::anonymize(const cv::Mat& frame, const cv::Mat& mask, cv::Mat& output) {
+    if (mParams.anonymizationMode == RegionAnonymizer::Mode::BACKGROUND) {
+        updateAndApplyBackground(frame, mask, output);
+        return;
     }
+
+    // The other modes need no background model. The effect is only computed
+    // inside the person regions.
+    mRegionAnonymizer.setParameters(regionAnonymizerParameters(mParams));
+    mRegionAnonymizer.apply(frame, mask, mPersonRegions, output);
 }
 
 cv::Mat VideoAnonymizer::processFrame(const cv::Mat& frame) {
     if (frame.empty()) {
         return frame;
     }
+
+    // The output buffer of the previous frame is reused, unless the caller
+    // still holds it.
+    if (mResult.u && mResult.u->refcount > 1) {
+        mResult.release();
+    }
+    processFrame(frame, mResult);
+    return mResult;
+}
+
+void VideoAnonymizer::processFrameInPlace(cv::Mat& frame) {
+    processFrame(frame, frame);
+}
+
+void VideoAnonymizer::processFrame(const cv::Mat& frame, cv::Mat& output) {
+    if (frame.empty()) {
+        output = frame;
+        return;
+    }
     
-    // Make a copy of the original frame
-    cv::Mat original = frame.clone();
-    cv::Mat result;
-    
+    AnonymizerMetrics& stages = metrics();
+    const uint64_t frameStart = MetricsRegistry::nowUs();
+
     // Detect humans in the frame
     cv::Mat humanMask;
-    detectHumans(original, humanMask);
-    
-    // If we don't have a background yet, initialize it with the current frame
-    /*if (mBackground.empty()) {
-        std::cout << "Frame " << mFrameCount << " background is empty, initializing with original frame" << std::endl;
-        mBackground = original.clone();
-        mFrameCount++;
-        return original;
-    }*/
-
-    //std::cout << "Frame " << mFrameCount << " humanMask size: " << humanMask.size() << std::endl; //<< " non-zero pixels: " << cv::countNonZero(humanMask) << std::endl;
-    
-    // Create a combined mask for anonymization
-    //cv::Mat combinedMask = createCombinedMask(frame, humanMask);   // TODO: very very slow in reCamera!
-    cv::Mat combinedMask = humanMask;
-    
-    //std::cout << "Frame " << mFrameCount << " combinedMask size: " << combinedMask.size() << std::endl; //<< " non-zero pixels: " << cv::countNonZero(combinedMask) << std::endl;
+    bool maskValid = !mFullFrameFallback;
+    if (maskValid) {
+        TRACE_SCOPE("anonymizer.detect");
+        if (mAsyncDetector) {
+            maskValid = detectHumansAsync(frame, humanMask);
+        } else {
+            maskValid = detectHumans(frame, humanMask);
+        }
+    }
+    const uint64_t detectEnd = MetricsRegistry::nowUs();
+    stages.detect.record(detectEnd - frameStart);
     
-    // Update the background model with the current frame
-    updateBackground(original, combinedMask);
-
-    //std::cout << "Frame " << mFrameCount << " background updated" << std::endl;
+    // Create a combined mask for anonymization. Without a recent mask the
+    // persons could be anywhere, so the whole frame is replaced.
+    cv::Mat combinedMask;
+    {
+        TRACE_SCOPE("anonymizer.mask");
+        combinedMask = maskValid ? createCombinedMask(frame, humanMask) : createFullMask(frame);
+    }
+    const uint64_t maskEnd = MetricsRegistry::nowUs();
+    stages.mask.record(maskEnd - detectEnd);
     
-    // Apply the mask to the frame
-    result = applyMaskToFrame(frame, combinedMask);
+    // The debug view shows the original next to the result. When the output
+    // overwrites the frame, the original is copied first, in debug mode only.
+#ifndef TARGET_RECAMERA
+    cv::Mat original = frame;
+    if (mParams.debugMode && output.data == frame.data) {
+        frame.copyTo(mDebugFrame);
+        original = mDebugFrame;
+    }
+#endif
 
-    //std::cout << "Frame " << mFrameCount << " result size: " << result.size() << std::endl;
+    // Update the background model and replace human pixels with the background,
+    // or apply the selected effect. Detection is done at this point, so the
+    // output may overwrite the frame.
+    {
+        TRACE_SCOPE("anonymizer.composite");
+        anonymize(frame, combinedMask, output);
+    }
+    const uint64_t frameEnd = MetricsRegistry::nowUs();
+    stages.composite.record(frameEnd - maskEnd);
+    stages.frame.record(frameEnd - frameStart);
     
     // Increment frame counter
     mFrameCount++;
@@ -108,11 +234,11 @@ cv::Mat VideoAnonymizer::processFrame(const cv::Mat& frame) {
 #ifndef TARGET_RECAMERA
         // Create debug visualization
         cv::Mat debugView;
-        if (original.type() != result.type()) {
-            std::cerr << "Original and result frames have different types: " << original.type() << " != " << result.type() << std::endl;
-            return result;
+        if (original.type() != output.type()) {
+            std::cerr << "Original and result frames have different types: " << original.type() << " != " << output.type() << std::endl;
+            return;
         }
-        cv::hconcat(original, result, debugView);
+        cv::hconcat(original, output, debugView);
         
         // Scale down if too large
         if (debugView.cols > 1280) {
@@ -120,60 +246,138 @@ cv::Mat VideoAnonymizer::processFrame(const cv::Mat& frame) {
         }
         
         // Show the background model
-        cv::imshow("Background Model", mBackground);
+        if (!mBackgroundModel->empty()) {
+            cv::imshow("Background Model", mBackgroundModel->getBackground());
+        }
+        if (mBackgroundModel->hasForeground() && !mBackgroundModel->getForeground().empty()) {
+            cv::imshow("Foreground", mBackgroundModel->getForeground());
+        }
         
         // Show the combined mask
-        cv::imshow("Mask", combinedMask);
+        if (!combinedMask.empty()) {
+            cv::imshow("Mask", combinedMask);
+        }
 #endif
     }
-    
-    return result;
+}
+
+cv::Mat VideoAnonymizer::scaleMaskToBox(const cv::Mat& mask, const cv::Size& boxSize) {
+    if (mask.size() == boxSize) {
+        return mask;
+    }
+
+    // Reduced resolution mask: stretch it to the box in a buffer that only
+    // grows, so that persons of varying size do not allocate
+    if (mScaledMask.rows < boxSize.height || mScaledMask.cols < boxSize.width) {
+        mScaledMask.create(std::max(boxSize.height, mScaledMask.rows),
+                           std::max(boxSize.width, mScaledMask.cols), CV_8UC1);
+    }
+    cv::Mat scaled = mScaledMask(cv::Rect(cv::Point(0, 0), boxSize));
+    cv::resize(mask, scaled, boxSize, 0, 0, cv::INTER_NEAREST);
+    return scaled;
 }
 
 cv::Mat VideoAnonymizer::createMask(const cv::Mat& frame, const std::vector<IDetector::Detection>& detections) {
-    // Create an empty mask
-    cv::Mat mask = cv::Mat::zeros(frame.size(), CV_8UC1);
+    const cv::Rect frameRect(0, 0, frame.cols, frame.rows);
+    const int radius = getDilationRadius(frame);
+
+    // The mask is kept between frames. Only the regions written by the last
+    // frame have to be cleared, the rest of it is still zero.
+    mPreviousRegions.swap(mPersonRegions);
+    mPersonRegions.clear();
+    if (mHumanMask.size() != frame.size()) {
+        mHumanMask = cv::Mat::zeros(frame.size(), CV_8UC1);
+        mPreviousRegions.clear();
+    } else {
+        clearRegions(mHumanMask, mPreviousRegions);
+    }
     
     // Process each detection
-    for (const auto& det : detections) {
+    const bool hasUnion = !mMaskUnion.mask.empty();
+    size_t nextUnionInstance = 0;
+    for (size_t i = 0; i < detections.size(); ++i) {
+        const auto& det = detections[i];
+
+        // Persons whose mask is in the union only need their region here
+        bool inUnion = false;
+        if (hasUnion && nextUnionInstance < mMaskUnion.instances.size() &&
+            mMaskUnion.instances[nextUnionInstance] == static_cast<int>(i)) {
+            inUnion = true;
+            ++nextUnionInstance;
+        }
+
         // Only put humans in the mask
         if (det.classId != mDetector->getPersonClassId()) {
             continue;
         }
+
+        cv::Rect box = det.bbox & frameRect;
+        if (box.empty()) {
+            continue;
+        }
         
-        // If we have a mask from segmentation, use it
-        if (!det.mask.empty()) {
+        // If we have a mask from segmentation, use it. It normally covers the
+        // bounding box only, possibly at a lower resolution. Full frame masks
+        // are still accepted.
+        cv::Mat personMask;
+        if (det.mask.size() == frame.size()) {
+            personMask = det.mask(box);
+        } else if (!det.mask.empty()) {
+            personMask = scaleMaskToBox(det.mask, det.bbox.size())(box - det.bbox.tl());
+        }
+
+        if (inUnion) {
+            // Painted with the union below
+        } else if (!personMask.empty()) {
             // Add the segmentation mask to our combined mask
-            cv::bitwise_or(mask, det.mask, mask);
+            cv::Mat roi = mHumanMask(box);
+            cv::bitwise_or(roi, personMask, roi);
         } else {
             // If no mask available, use the bounding box
-            cv::rectangle(mask, det.bbox, cv::Scalar(255), -1); // Fill the box
+            mHumanMask(box).setTo(cv::Scalar(255)); // Fill the box
         }
+
+        // Everything the dilation can reach around the person
+        cv::Rect region(box.x - radius, box.y - radius, box.width + 2 * radius, box.height + 2 * radius);
+        mPersonRegions.push_back(region & frameRect);
     }
-    
-    return mask;
-}
 
+    // The union is not required to stay inside the boxes of its instances,
+    // so the whole area it covers is a person region too
+    const cv::Rect unionBox = mMaskUnion.bbox;
+    if (hasUnion) {
+        cv::Rect region(unionBox.x - radius, unionBox.y - radius,
+                        unionBox.width + 2 * radius, unionBox.height + 2 * radius);
+        region &= frameRect;
+        if (!region.empty()) {
+            mPersonRegions.push_back(region);
+        }
+    }
 
-void VideoAnonymizer::detectHumans(const cv::Mat& frame, cv::Mat& mask) {
-    // Use the detector to detect humans
-    std::vector<IDetector::Detection> detections;
-    bool success = mDetector->detect(frame, detections);
-    
-    if (!success) {
-        std::cerr << "Human detection failed" << std::endl;
-        return;
+    // Nothing to mask: skip all the mask work for this frame
+    if (mPersonRegions.empty()) {
+        return cv::Mat();
     }
-    
-    // Create a mask from the detection results
-    mask = createMask(frame, detections);
-    
-    // Store the mask for debug visualization
-    mLastDetectionMask = mask.clone();
-    mLastDetections = detections;
+
+    mergeRegions(mPersonRegions);
+
+    // The union is upscaled once. It lies inside the person regions, which
+    // are the only parts of the mask cleared by the next frame.
+    const cv::Rect unionPart = unionBox & frameRect;
+    if (hasUnion && !unionPart.empty()) {
+        const cv::Mat unionMask = scaleMaskToBox(mMaskUnion.mask, unionBox.size());
+        cv::Mat roi = mHumanMask(unionPart);
+        cv::bitwise_or(roi, unionMask(unionPart - unionBox.tl()), roi);
+    }
+
+    return mHumanMask;
 }
 
-cv::Mat VideoAnonymizer::createCombinedMask(const cv::Mat& frame, const cv::Mat& mask) {
+int VideoAnonymizer::getDilationRadius(const cv::Mat& frame) const {
+    if (mParams.dilationShape == MaskDilator::Shape::NONE) {
+        return 0;
+    }
+
     // Calculate dilation size based on frame dimensions
     int frameSize = std::min(frame.cols, frame.rows);
     float dilationFactor = mFrameCount < mParams.warmupFrames ? mParams.warmupDilationFactor : mParams.dilationFactor;
@@ -182,37 +386,200 @@ cv::Mat VideoAnonymizer::createCombinedMask(const cv::Mat& frame, const cv::Mat&
     // Clamp dilation size to min/max values
     dilationSize = std::max(mParams.minDilation, std::min(dilationSize, mParams.maxDilation));
     
-    // Create structuring element for dilation
-    cv::Mat element = cv::getStructuringElement(
-        cv::MORPH_ELLIPSE,
-        cv::Size(2 * dilationSize + 1, 2 * dilationSize + 1),
-        cv::Point(dilationSize, dilationSize)
-    );
-    
-    // Dilate the mask
-    cv::Mat dilatedMask;
-    cv::dilate(mask, dilatedMask, element, cv::Point(-1, -1), mParams.dilationIterations);
-    
-    return dilatedMask;
+    // Repeated dilations with the same disk or square add up their radii,
+    // so the iterations are done in a single pass with a larger radius
+    return dilationSize * std::max(mParams.dilationIterations, 1);
 }
 
-cv::Mat VideoAnonymizer::applyMaskToFrame(const cv::Mat& frame, const cv::Mat& mask) {
-    // If background is empty, return original frame
-    if (mBackground.empty()) {
-        return frame.clone();
+bool VideoAnonymizer::detectHumans(const cv::Mat& frame, cv::Mat& mask) {
+    // Between detector runs, the last detections are moved to the current frame
+    const int interval = std::max(mParams.detectionInterval, 1);
+    bool runDetector = !mHasMask || mFrameCount - static_cast<int>(mMaskFrame) >= interval;
+    bool sceneStatic = false;
+    if (runDetector && mHasMask && mParams.useMotionGate) {
+        sceneStatic = !gateRequiresDetection(frame);
+        runDetector = !sceneStatic;
+    }
+
+    // The union of the person masks only matches the frame it was detected on
+    mMaskUnion.mask.release();
+    mMaskUnion.instances.clear();
+
+    if (runDetector) {
+        // Use the detector to detect humans. The vector keeps its capacity between frames.
+        mDetections.clear();
+        mDetector->setFrameIndex(static_cast<uint64_t>(mFrameCount));
+        bool success = mParams.useMaskUnion ? mDetector->detectWithMaskUnion(frame, mDetections, mMaskUnion)
+                                            : mDetector->detect(frame, mDetections);
+        
+        if (!success) {
+            // The persons could be anywhere: the caller anonymizes the whole frame
+            std::cerr << "Human detection failed" << std::endl;
+            mDetections.clear();
+            mHasMask = false;
+            mMaskAge = -1;
+            return false;
+        }
+
+        mMaskFrame = mFrameCount;
+        mHasMask = true;
+        if (mParams.useMotionGate) {
+            mGate.setReference(frame);
+        }
+        if (mParams.useTracking) {
+            // Adds the persons the detector missed at their predicted position
+            mTracker.update(mDetections, mMaskFrame, frame.size(), mDetector->getPersonClassId());
+        }
+        // Also at an interval of 1, which may be raised at runtime (see
+        // setDetectionInterval()): the detections must never be matched
+        // against the frame of an older run
+        if (mParams.propagateMasks) {
+            mPropagator.setReference(frame, mDetections);
+        }
+    } else if (mParams.propagateMasks && !sceneStatic) {
+        mPropagator.propagate(frame, mDetections);
     }
+    mMaskAge = mFrameCount - static_cast<int>(mMaskFrame);
     
-    // Create result frame
-    cv::Mat result = frame.clone();
+    // Create a mask from the detection results
+    mask = createMask(frame, mDetections);
+    storeSnapshots(mask);
+    return true;
+}
+
+bool VideoAnonymizer::gateRequiresDetection(const cv::Mat& frame) {
+    AnonymizerMetrics& stages = metrics();
+
+    // A person in view may move without changing enough blocks, so the
+    // detector always runs while there is one, detected or tracked. The
+    // refresh interval bounds the time a person missed on a static scene
+    // stays unnoticed.
+    const int personClassId = mDetector->getPersonClassId();
+    const bool personsInView = mTracker.getTrackCount() > 0 ||
+        std::any_of(mDetections.begin(), mDetections.end(),
+                    [personClassId](const IDetector::Detection& det) { return det.classId == personClassId; });
+    if (personsInView || mFrameCount - static_cast<int>(mMaskFrame) >= mGate.getParameters().refreshInterval) {
+        stages.gateForced.add();
+        return true;
+    }
+
+    if (mGate.hasChanged(frame)) {
+        stages.gateChanged.add();
+        return true;
+    }
+    stages.gateSkipped.add();
+    return false;
+}
+
+bool VideoAnonymizer::detectHumansAsync(const cv::Mat& frame, cv::Mat& mask) {
+    // Never waits: the frame is skipped if the worker is busy taking the previous one
+    mAsyncDetector->submit(frame, mFrameCount);
+
+    uint64_t detectedFrame = 0;
+    // Results of frames submitted before a reset() are ignored
+    if (mAsyncDetector->fetch(mDetections, detectedFrame) && detectedFrame <= static_cast<uint64_t>(mFrameCount)) {
+        mMaskFrame = detectedFrame;
+        mHasMask = true;
+        if (mParams.useTracking) {
+            mTracker.update(mDetections, mMaskFrame, frame.size(), mDetector->getPersonClassId());
+        }
+        // The detections are a few frames old already. They are matched
+        // against the current frame from now on.
+        if (mParams.propagateMasks) {
+            mPropagator.setReference(frame, mDetections);
+        }
+    } else if (mHasMask && mParams.propagateMasks) {
+        mPropagator.propagate(frame, mDetections);
+    }
+
+    if (!mHasMask) {
+        mMaskAge = -1;
+        return false;
+    }
+    mMaskAge = static_cast<int>(mFrameCount - mMaskFrame);
+    if (mMaskAge > mParams.maxMaskAge) {
+        return false;
+    }
+
+    // The latest detections are reused until newer ones are available
+    mask = createMask(frame, mDetections);
+    storeSnapshots(mask);
+    return true;
+}
+
+void VideoAnonymizer::storeSnapshots(const cv::Mat& mask) {
+    // Store the results for debug visualization, only if requested.
+    if (!mParams.keepSnapshots) {
+        return;
+    }
+
+    // The working mask is cleared incrementally by the next frame, so it
+    // cannot be swapped out. Both masks are zero outside of their person
+    // regions, so only these are cleared and copied.
+    if (mLastDetectionMask.size() != mHumanMask.size()) {
+        mLastDetectionMask = cv::Mat::zeros(mHumanMask.size(), CV_8UC1);
+    } else {
+        clearRegions(mLastDetectionMask, mSnapshotRegions);
+    }
+    if (!mask.empty()) {
+        for (const cv::Rect& r : mPersonRegions) {
+            cv::Mat roi = mLastDetectionMask(r);
+            mask(r).copyTo(roi);
+        }
+    }
+    mSnapshotRegions = mPersonRegions;
+
+    // The detections are still the input of the next frame (propagation,
+    // tracker, motion gate), so they are not swapped either. The copy reuses
+    // the capacity of the snapshot and only copies the headers of the masks.
+    mLastDetections = mDetections;
+}
+
+cv::Mat VideoAnonymizer::createFullMask(const cv::Mat& frame) {
+    const cv::Rect frameRect(0, 0, frame.cols, frame.rows);
+
+    mPreviousRegions.swap(mPersonRegions);
+    mPersonRegions.assign(1, frameRect);
+    if (mHumanMask.size() != frame.size()) {
+        mHumanMask = cv::Mat::zeros(frame.size(), CV_8UC1);
+    } else {
+        clearRegions(mHumanMask, mPreviousRegions);
+    }
+    if (mCombinedMask.size() != frame.size()) {
+        mCombinedMask.create(frame.size(), CV_8UC1);
+    }
+
+    // The whole frame is dirty now, and will be cleared by the next frame
+    mCombinedMask.setTo(cv::Scalar(255));
+    return mCombinedMask;
+}
+
+cv::Mat VideoAnonymizer::createCombinedMask(const cv::Mat& frame, const cv::Mat& mask) {
+    // Same as the human mask, only the person regions of the last frame are dirty
+    if (mCombinedMask.size() != frame.size()) {
+        mCombinedMask = cv::Mat::zeros(frame.size(), CV_8UC1);
+    } else {
+        clearRegions(mCombinedMask, mPreviousRegions);
+    }
+
+    if (mask.empty()) {
+        return mask;
+    }
     
-    // Apply the mask to replace human pixels with background
-    mBackground.copyTo(result, mask);
+    // Dilate the mask inside each person region. The regions are large enough
+    // for the dilation, and the cost does not depend on the radius.
+    const int radius = getDilationRadius(frame);
+    mDilator.setShape(mParams.dilationShape);
+    for (const cv::Rect& r : mPersonRegions) {
+        cv::Mat roi = mCombinedMask(r);
+        mDilator.dilate(mask(r), roi, radius);
+    }
     
-    return result;
+    return mCombinedMask;
 }
 
 cv::Mat VideoAnonymizer::getBackground() const {
-    return mBackground;
+    return mBackgroundModel->getBackground();
 }
 
 cv::Mat VideoAnonymizer::getDetectionMask() const {
@@ -223,14 +590,49 @@ const std::vector<IDetector::Detection>& VideoAnonymizer::getDetections() const
     return mLastDetections;
 }
 
+int VideoAnonymizer::getMaskAge() const {
+    return mMaskAge;
+}
+
+void VideoAnonymizer::setDetectionInterval(int interval) {
+    mParams.detectionInterval = std::max(interval, 1);
+}
+
+void VideoAnonymizer::setDilationShape(MaskDilator::Shape shape) {
+    mParams.dilationShape = shape;
+}
+
+void VideoAnonymizer::setAnonymizationMode(RegionAnonymizer::Mode mode) {
+    mParams.anonymizationMode = mode;
+}
+
+void VideoAnonymizer::setFullFrameFallback(bool enabled) {
+    mFullFrameFallback = enabled;
+}
+
 void VideoAnonymizer::reset() {
     // Reset frame counter
     mFrameCount = 0;
     
     // Clear masks
     mLastDetectionMask = cv::Mat();
-    mBackground = cv::Mat();
+    mHumanMask.release();
+    mCombinedMask.release();
+    mScaledMask.release();
+    mResult.release();
+    mDebugFrame.release();
+    mPersonRegions.clear();
+    mPreviousRegions.clear();
+    mSnapshotRegions.clear();
+    mBackgroundModel->reset();
     
     // Clear detections
     mLastDetections.clear();
+    mDetections.clear();
+    mMaskUnion = IDetector::MaskUnion();
+    mHasMask = false;
+    mMaskAge = -1;
+    mPropagator.reset();
+    mTracker.reset();
+    mGate.reset();
 }
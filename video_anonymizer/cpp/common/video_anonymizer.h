@@ -5,6 +5,13 @@
 #include <memory>
 
 #include "idetector.h"
+#include "background_model_factory.h"
+#include "mask_dilator.h"
+#include "region_anonymizer.h"
+#include "async_detector.h"
+#include "mask_propagator.h"
+#include "person_tracker.h"
+#include "motion_gate.h"
 
 class VideoAnonymizer {
 public:
@@ -18,10 +25,29 @@ public:
         int maxDilation;
         int dilationIterations;
         float warmupDilationFactor;
+        MaskDilator::Shape dilationShape;
         float learningRate;
+        BackgroundModelFactory::Type backgroundModel;   // Background model implementation
+        bool foregroundMasking;   // Also hide the pixels the background model sees as foreground (CNT only)
+        RegionAnonymizer::Mode anonymizationMode;   // How the persons are hidden
+        int blurStrength;         // BLUR mode: blur kernel size in pixels
+        int pixelSize;            // PIXELATE mode: block size in pixels
         std::string labelsPath;
         bool useGPU;
         bool debugMode;
+        bool keepSnapshots;       // Keep the last detections and mask for getDetections() / getDetectionMask()
+        bool asyncDetection;      // Run the detector on a worker thread, and composite with the latest mask
+        int maxMaskAge;           // Asynchronous mode: oldest mask (in frames) used before anonymizing the whole frame
+        int detectionInterval;    // Synchronous mode: run the detector every N frames
+        bool propagateMasks;      // Move the last detections with the image content when they are reused
+        bool useTracking;         // Track persons to cover missed detections
+        int trackHistory;         // Number of frames a missed person is still anonymized at its predicted position
+        bool useMaskUnion;        // Synchronous mode: get a single union of the person masks from the detector, upscaled once
+        bool useMotionGate;       // Synchronous mode: skip the detector while the scene is static and nobody is in view
+        int gateRefreshInterval;  // Motion gate: frames after which the detector runs even on a static scene
+        std::string recordPath;   // Record the detections to this file (if not empty)
+        std::string replayPath;   // Replay the detections of this recording instead of running the model (if not empty)
+        bool replayLoop;          // Start the replay over after its last frame instead of anonymizing the whole frames (benchmarks)
         // Constructor with default values
         Parameters() :
             confThreshold(0.5f),
@@ -33,50 +59,150 @@ public:
             maxDilation(30),
             dilationIterations(1),
             warmupDilationFactor(0.15f),
+            dilationShape(MaskDilator::Shape::DISK),
             learningRate(0.2f),
+            backgroundModel(BackgroundModelFactory::Type::EMA),
+            foregroundMasking(false),
+            anonymizationMode(RegionAnonymizer::Mode::BACKGROUND),
+            blurStrength(21),
+            pixelSize(16),
             labelsPath("coco.names"),
             useGPU(false),
-            debugMode(false) {}
+            debugMode(false),
+            keepSnapshots(false),
+            asyncDetection(false),
+            maxMaskAge(5),
+            detectionInterval(1),
+            propagateMasks(true),
+            useTracking(true),
+            trackHistory(15),
+            useMaskUnion(false),
+            useMotionGate(false),
+            gateRefreshInterval(30),
+            recordPath(""),
+            replayPath(""),
+            replayLoop(false) {}
     };
 
     VideoAnonymizer(const Parameters& params = Parameters());
+
+    // Use the given detector instead of the one of DetectorFactory. It is
+    // initialized by the constructor.
+    VideoAnonymizer(const Parameters& params, std::unique_ptr<IDetector> detector);
     ~VideoAnonymizer();
 
-    // Process a frame with optional debug mode
+    // Process a frame with optional debug mode.
+    // The returned image is reused for the next frame if the caller released it.
     cv::Mat processFrame(const cv::Mat& frame);
+
+    // Process a frame into a caller provided output. output is only allocated
+    // if its size or type does not match the frame, so it may wrap an external
+    // buffer (e.g. bound to the encoder). It may also be the frame itself.
+    void processFrame(const cv::Mat& frame, cv::Mat& output);
+
+    // Process a frame and write the anonymized pixels back into it
+    void processFrameInPlace(cv::Mat& frame);
     
     // Get current background model
     cv::Mat getBackground() const;
     
-    // Get the latest human detection mask
+    // Get the latest human detection mask (only kept if keepSnapshots is set)
     cv::Mat getDetectionMask() const;
     
-    // Get the latest detection results for visualization
+    // Get the latest detection results for visualization (only kept if keepSnapshots is set)
     const std::vector<IDetector::Detection>& getDetections() const;
+
+    // Number of frames between the frame the current mask was detected on and
+    // the last processed frame, -1 if there is no mask yet.
+    int getMaskAge() const;
     
     // Reset the anonymizer state
     void reset();
 
+    // Quality knobs changed at runtime (see QosGovernor). They take effect at
+    // the next frame and must be set from the thread processing the frames.
+    void setDetectionInterval(int interval);
+    void setDilationShape(MaskDilator::Shape shape);
+    void setAnonymizationMode(RegionAnonymizer::Mode mode);
+
+    // Anonymize the whole frame without running the detector, when the
+    // pipeline is too late for its masks to be trusted
+    void setFullFrameFallback(bool enabled);
+
 private:
     Parameters mParams;
     std::unique_ptr<IDetector> mDetector;
-    cv::Mat mBackground;
+    // Declared after mDetector so that the worker is stopped first
+    std::unique_ptr<AsyncDetector> mAsyncDetector;
+    std::unique_ptr<IBackgroundModel> mBackgroundModel;
+    MaskDilator mDilator;
+    RegionAnonymizer mRegionAnonymizer;
+    MaskPropagator mPropagator;
+    PersonTracker mTracker;
+    MotionGate mGate;
+    cv::Mat mHumanMask;
+    cv::Mat mCombinedMask;
+    // Reduced resolution person mask stretched to its box
+    cv::Mat mScaledMask;
+    // Regions that may contain persons (dilated person boxes) in the current
+    // and in the previous frame. Both masks are zero outside of mPersonRegions.
+    std::vector<cv::Rect> mPersonRegions;
+    std::vector<cv::Rect> mPreviousRegions;
     cv::Mat mLastDetectionMask;
+    // Regions of mLastDetectionMask that may be non-zero
+    std::vector<cv::Rect> mSnapshotRegions;
     int mFrameCount;
     std::vector<IDetector::Detection> mLastDetections;
+    // Working buffers, allocated at the first frame and reused afterwards
+    std::vector<IDetector::Detection> mDetections;
+    // Union of the person masks of the current frame, when the detector ran on it
+    IDetector::MaskUnion mMaskUnion;
+    cv::Mat mResult;
+    // Copy of the original frame for the debug view, when processed in place
+    cv::Mat mDebugFrame;
+    // Frame the current detections were computed on
+    uint64_t mMaskFrame;
+    bool mHasMask;
+    int mMaskAge;
+    bool mFullFrameFallback;
+
+    // Detect humans in the frame using HumanDetector. Returns false if the
+    // detector failed, in which case there is no mask.
+    bool detectHumans(const cv::Mat& frame, cv::Mat& mask);
 
-    // Detect humans in the frame using HumanDetector
-    void detectHumans(const cv::Mat& frame, cv::Mat& mask);
+    // Whether the detector has to run on the frame, or the last detections
+    // are still valid because the scene did not change
+    bool gateRequiresDetection(const cv::Mat& frame);
+
+    // Submit the frame to the asynchronous detector and build the mask from
+    // the latest detections. Returns false if there is no recent enough mask.
+    bool detectHumansAsync(const cv::Mat& frame, cv::Mat& mask);
+
+    // Keep copies of the detections and mask if keepSnapshots is set. Only
+    // the person regions of the mask are copied.
+    void storeSnapshots(const cv::Mat& mask);
+
+    // Mask covering the whole frame, used when no valid mask is available
+    cv::Mat createFullMask(const cv::Mat& frame);
     
-    // Update the background model with the current frame
-    void updateBackground(const cv::Mat& frame, const cv::Mat& humanMask);
+    // Update the background model outside the mask and replace the masked
+    // pixels with the background, in a single pass over the frame
+    void updateAndApplyBackground(const cv::Mat& frame, const cv::Mat& mask, cv::Mat& output);
+
+    // Hide the masked pixels with the selected anonymization mode
+    void anonymize(const cv::Mat& frame, const cv::Mat& mask, cv::Mat& output);
     
     // Create and apply dilated mask from detections
     cv::Mat createCombinedMask(const cv::Mat& frame, const cv::Mat& mask);
-    
-    // Apply anonymization by replacing human pixels with background
-    cv::Mat applyMaskToFrame(const cv::Mat& frame, const cv::Mat& mask);
 
-    // Create a mask from the detection results
+    // View of a bbox mask at the resolution of the box. Reuses mScaledMask
+    // for reduced resolution masks, so it is only valid until the next call.
+    cv::Mat scaleMaskToBox(const cv::Mat& mask, const cv::Size& boxSize);
+
+    // Create a mask from the detection results, and the regions that contain
+    // the persons. Returns an empty mask if there are no persons.
     cv::Mat createMask(const cv::Mat& frame, const std::vector<IDetector::Detection>& detections);
+
+    // Dilation radius for the current frame
+    int getDilationRadius(const cv::Mat& frame) const;
 };
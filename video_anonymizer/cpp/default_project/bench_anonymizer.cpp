@@ -0,0 +1,346 @@
+// End-to-end benchmark of VideoAnonymizer.
+//
+// Loads a fixed set of frames from a video or a directory of images, scales
+// them to each resolution under test and runs the whole anonymizer (detection,
+// mask, composite) over them for a fixed number of iterations, after a warm-up
+// that also covers the warm-up phase of the anonymizer. Frames are decoded and
+// resized before the timing, so only the anonymizer is measured.
+//
+// Reports the throughput, the latency percentiles of every stage (from the
+// metrics registry) and the peak resident memory of each resolution, and can
+// write them as a JSON report to compare releases. Synchronous detection on a
+// given set of frames is deterministic, so the runs are repeatable.
+
+#include "../common/video_anonymizer.h"
+#include "../common/metrics.h"
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/videoio.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+
+static void printUsage(const char* programName) {
+    std::cout << "Usage: " << programName << " -i <video|directory> [options]" << std::endl;
+    std::cout << "Options:" << std::endl;
+    std::cout << "  -h, --help                Show this help message" << std::endl;
+    std::cout << "  -i, --input <path>        Input video file, or directory of images" << std::endl;
+    std::cout << "  -m, --model <path>        YOLO model path (default: yolo11n-seg.onnx)" << std::endl;
+    std::cout << "  -n, --iterations <n>      Frames timed per resolution (default: 200)" << std::endl;
+    std::cout << "      --warmup <n>          Frames run before the timing (default: the anonymizer warm-up, 30)" << std::endl;
+    std::cout << "      --frames <n>          Frames loaded from the input, played in a loop (default: 50)" << std::endl;
+    std::cout << "      --resolutions <list>  Comma separated WxH list (default: 640x480,1280x720,1920x1080)" << std::endl;
+    std::cout << "      --threads <n>         OpenCV worker threads, 0 for one (default: OpenCV default)" << std::endl;
+    std::cout << "      --mode <mode>         Anonymization: background, blur, pixelate or solid (default: background)" << std::endl;
+    std::cout << "      --bg-model <model>    Background model: ema or cnt (default: ema)" << std::endl;
+    std::cout << "      --mask-union          Union the person masks at the detector resolution, upscale once" << std::endl;
+    std::cout << "      --async               Run detection on a worker thread (not repeatable)" << std::endl;
+    std::cout << "      --detect-every <n>    Run the detector every n frames (default: 1)" << std::endl;
+    std::cout << "      --track-history <n>   Frames a missed person stays anonymized, 0 disables tracking (default: 15)" << std::endl;
+    std::cout << "      --motion-gate         Skip the detector while the scene is static and nobody is in view" << std::endl;
+    std::cout << "      --replay <file>       Replay recorded detections instead of running the model" << std::endl;
+    std::cout << "      --json <path>         Write the results as a JSON report" << std::endl;
+}
+
+// Parse "640x480,1280x720"
+static bool parseResolutions(const std::string& list, std::vector<cv::Size>& sizes) {
+    sizes.clear();
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        int width = 0;
+        int height = 0;
+        char separator = 0;
+        std::stringstream parser(item);
+        if (!(parser >> width >> separator >> height) || separator != 'x' || width <= 0 || height <= 0) {
+            return false;
+        }
+        sizes.emplace_back(width, height);
+    }
+    return !sizes.empty();
+}
+
+// Load up to maxFrames frames from a video or from the images of a directory
+static std::vector<cv::Mat> loadFrames(const std::string& input, int maxFrames) {
+    std::vector<cv::Mat> frames;
+
+    std::vector<cv::String> files;
+    try {
+        cv::glob(input + "/*", files, false);
+    } catch (const cv::Exception&) {
+        files.clear();
+    }
+
+    if (!files.empty()) {
+        // cv::glob sorts the names, the frame order is stable
+        for (const cv::String& file : files) {
+            if (static_cast<int>(frames.size()) >= maxFrames) {
+                break;
+            }
+            cv::Mat frame = cv::imread(file, cv::IMREAD_COLOR);
+            if (!frame.empty()) {
+                frames.push_back(frame);
+            }
+        }
+        return frames;
+    }
+
+    cv::VideoCapture capture(input);
+    cv::Mat frame;
+    while (static_cast<int>(frames.size()) < maxFrames && capture.read(frame)) {
+        frames.push_back(frame.clone());
+    }
+    return frames;
+}
+
+// Peak resident set size of the process in kB
+static long peakRssKb() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return -1;
+    }
+    return usage.ru_maxrss;   // kB on Linux
+}
+
+// Restart the peak RSS from the current RSS (Linux 4.0+), false if not supported
+static bool resetPeakRss() {
+    FILE* file = std::fopen("/proc/self/clear_refs", "w");
+    if (!file) {
+        return false;
+    }
+    const bool ok = std::fputs("5", file) >= 0;
+    return std::fclose(file) == 0 && ok;
+}
+
+// Current peak RSS from /proc, which follows resetPeakRss() unlike getrusage()
+static long procPeakRssKb() {
+    FILE* file = std::fopen("/proc/self/status", "r");
+    if (!file) {
+        return -1;
+    }
+    long kb = -1;
+    char line[256];
+    while (std::fgets(line, sizeof(line), file)) {
+        if (std::sscanf(line, "VmHWM: %ld kB", &kb) == 1) {
+            break;
+        }
+    }
+    std::fclose(file);
+    return kb;
+}
+
+struct RunResult {
+    cv::Size size;
+    int frames;
+    double seconds;
+    long peakRssKb;
+    MetricsSnapshot metrics;
+};
+
+static std::string jsonEscape(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+        }
+        escaped += c;
+    }
+    return escaped;
+}
+
+static bool writeJson(const std::string& path, const std::string& input, const std::string& mode,
+                      int iterations, int warmup, int frameCount, bool peakReset,
+                      const std::vector<RunResult>& results) {
+    FILE* file = std::fopen(path.c_str(), "w");
+    if (!file) {
+        return false;
+    }
+
+    std::fprintf(file, "{\n  \"opencv\": \"%s\",\n  \"input\": \"%s\",\n  \"mode\": \"%s\",\n",
+                 CV_VERSION, jsonEscape(input).c_str(), mode.c_str());
+    std::fprintf(file, "  \"iterations\": %d,\n  \"warmup\": %d,\n  \"frames\": %d,\n  \"threads\": %d,\n",
+                 iterations, warmup, frameCount, cv::getNumThreads());
+    std::fprintf(file, "  \"peak_rss_per_run\": %s,\n  \"runs\": [", peakReset ? "true" : "false");
+
+    for (size_t r = 0; r < results.size(); ++r) {
+        const RunResult& result = results[r];
+        std::fprintf(file, "%s\n    {\n      \"width\": %d,\n      \"height\": %d,\n",
+                     r > 0 ? "," : "", result.size.width, result.size.height);
+        std::fprintf(file, "      \"frames\": %d,\n      \"seconds\": %.6f,\n      \"fps\": %.3f,\n      \"peak_rss_kb\": %ld,\n",
+                     result.frames, result.seconds, result.frames / result.seconds, result.peakRssKb);
+
+        std::fprintf(file, "      \"stages\": {");
+        for (size_t i = 0; i < result.metrics.stages.size(); ++i) {
+            const MetricsSnapshot::Stage& s = result.metrics.stages[i];
+            std::fprintf(file, "%s\n        \"%s\": {\"count\": %llu, \"mean_ms\": %.3f, \"p50_ms\": %.3f, "
+                         "\"p95_ms\": %.3f, \"p99_ms\": %.3f, \"max_ms\": %.3f}",
+                         i > 0 ? "," : "", s.name.c_str(), static_cast<unsigned long long>(s.count),
+                         s.meanUs / 1000.0, s.p50Us / 1000.0, s.p95Us / 1000.0, s.p99Us / 1000.0, s.maxUs / 1000.0);
+        }
+        std::fprintf(file, "\n      },\n      \"counters\": {");
+        for (size_t i = 0; i < result.metrics.counters.size(); ++i) {
+            const MetricsSnapshot::Counter& c = result.metrics.counters[i];
+            std::fprintf(file, "%s\n        \"%s\": %llu", i > 0 ? "," : "", c.name.c_str(),
+                         static_cast<unsigned long long>(c.value));
+        }
+        std::fprintf(file, "\n      }\n    }");
+    }
+    std::fprintf(file, "\n  ]\n}\n");
+
+    const bool ok = std::ferror(file) == 0;
+    return std::fclose(file) == 0 && ok;
+}
+
+int main(int argc, char* argv[]) {
+    std::string inputPath;
+    std::string jsonPath;
+    std::string resolutionList = "640x480,1280x720,1920x1080";
+    std::string modeName = "background";
+    VideoAnonymizer::Parameters params;
+    params.useGPU = false;
+    int iterations = 200;
+    int warmup = params.warmupFrames;
+    int maxFrames = 50;
+    int threads = -1;
+    int trackHistory = params.trackHistory;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+
+        if (arg == "-h" || arg == "--help") {
+            printUsage(argv[0]);
+            return 0;
+        } else if (arg == "-i" || arg == "--input") {
+            if (i + 1 < argc) inputPath = argv[++i];
+        } else if (arg == "-m" || arg == "--model") {
+            if (i + 1 < argc) params.modelPath = argv[++i];
+        } else if (arg == "-n" || arg == "--iterations") {
+            if (i + 1 < argc) iterations = std::stoi(argv[++i]);
+        } else if (arg == "--warmup") {
+            if (i + 1 < argc) warmup = std::stoi(argv[++i]);
+        } else if (arg == "--frames") {
+            if (i + 1 < argc) maxFrames = std::stoi(argv[++i]);
+        } else if (arg == "--resolutions") {
+            if (i + 1 < argc) resolutionList = argv[++i];
+        } else if (arg == "--threads") {
+            if (i + 1 < argc) threads = std::stoi(argv[++i]);
+        } else if (arg == "--mode") {
+            if (i + 1 < argc) {
+                modeName = argv[++i];
+                if (!RegionAnonymizer::parseMode(modeName, params.anonymizationMode)) {
+                    std::cerr << "Unknown anonymization mode: " << modeName << std::endl;
+                    return 1;
+                }
+            }
+        } else if (arg == "--bg-model") {
+            if (i + 1 < argc && !BackgroundModelFactory::parseType(argv[++i], params.backgroundModel)) {
+                std::cerr << "Unknown background model: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--mask-union") {
+            params.useMaskUnion = true;
+        } else if (arg == "--async") {
+            params.asyncDetection = true;
+        } else if (arg == "--detect-every") {
+            if (i + 1 < argc) params.detectionInterval = std::stoi(argv[++i]);
+        } else if (arg == "--track-history") {
+            if (i + 1 < argc) trackHistory = std::stoi(argv[++i]);
+        } else if (arg == "--motion-gate") {
+            params.useMotionGate = true;
+        } else if (arg == "--replay") {
+            if (i + 1 < argc) params.replayPath = argv[++i];
+            // The frames are played in a loop, so is the recording
+            params.replayLoop = true;
+        } else if (arg == "--json") {
+            if (i + 1 < argc) jsonPath = argv[++i];
+        } else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    params.useTracking = trackHistory > 0;
+    params.trackHistory = trackHistory;
+
+    std::vector<cv::Size> resolutions;
+    if (inputPath.empty() || iterations <= 0 || maxFrames <= 0 || !parseResolutions(resolutionList, resolutions)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    if (threads >= 0) {
+        cv::setNumThreads(threads);
+    }
+
+    const std::vector<cv::Mat> source = loadFrames(inputPath, maxFrames);
+    if (source.empty()) {
+        std::cerr << "Error: Could not read any frame from " << inputPath << std::endl;
+        return 1;
+    }
+
+    std::cout << "OpenCV " << CV_VERSION << ", " << source.size() << " frames, "
+              << iterations << " iterations, " << warmup << " warm-up frames, "
+              << cv::getNumThreads() << " threads" << std::endl;
+
+    bool peakReset = true;
+    std::vector<RunResult> results;
+    for (const cv::Size& size : resolutions) {
+        // Scaled before the timing
+        std::vector<cv::Mat> frames(source.size());
+        for (size_t i = 0; i < source.size(); ++i) {
+            cv::resize(source[i], frames[i], size, 0, 0, cv::INTER_AREA);
+        }
+
+        // A new anonymizer per resolution, so each run starts from the same state
+        peakReset = resetPeakRss() && peakReset;
+        VideoAnonymizer anonymizer(params);
+        cv::Mat output;
+        for (int i = 0; i < warmup; ++i) {
+            anonymizer.processFrame(frames[i % frames.size()], output);
+        }
+
+        MetricsRegistry::instance().snapshot(true);
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i) {
+            anonymizer.processFrame(frames[(warmup + i) % frames.size()], output);
+        }
+        const auto end = std::chrono::steady_clock::now();
+
+        RunResult result;
+        result.size = size;
+        result.frames = iterations;
+        result.seconds = std::chrono::duration<double>(end - start).count();
+        result.metrics = MetricsRegistry::instance().snapshot(true);
+        const long procPeak = procPeakRssKb();
+        result.peakRssKb = procPeak >= 0 ? procPeak : peakRssKb();
+        results.push_back(result);
+
+        std::cout << size.width << "x" << size.height << ": "
+                  << std::fixed << std::setprecision(2) << iterations / result.seconds << " FPS, "
+                  << "peak RSS " << result.peakRssKb / 1024.0 << " MB" << std::endl;
+        for (const std::string& line : result.metrics.format()) {
+            std::cout << "  " << line << std::endl;
+        }
+    }
+
+    if (!peakReset) {
+        std::cout << "The peak RSS could not be reset, it is the peak of the whole process" << std::endl;
+    }
+
+    if (!jsonPath.empty()) {
+        if (!writeJson(jsonPath, inputPath, modeName, iterations, warmup,
+                       static_cast<int>(source.size()), peakReset, results)) {
+            std::cerr << "Error: Could not write the report to " << jsonPath << std::endl;
+            return 1;
+        }
+        std::cout << "Report written to " << jsonPath << std::endl;
+    }
+    return 0;
+}
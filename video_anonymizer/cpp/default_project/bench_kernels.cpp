@@ -0,0 +1,342 @@
+// Microbenchmark of the per-pixel anonymization kernels.
+//
+// Compares the original multi-pass background update + composite with the
+// fused kernel (SIMD, scalar, and restricted to the person regions), and cv::dilate with the radius independent
+// mask dilation, at several resolutions on a synthetic scene where persons
+// cover a fraction of the frame. Also reports the cost of the CNT kernel, of
+// every background model through IBackgroundModel, of the anonymization modes
+// that need no background, of the bit-packed mask decoding, and of the mask
+// propagation between detector runs.
+
+#include "../common/anonymizer_kernels.h"
+#include "../common/ema_background_model.h"
+#include "../common/cnt_background_model.h"
+#include "../common/background_model_factory.h"
+#include "../common/mask_dilator.h"
+#include "../common/region_anonymizer.h"
+#include "../common/mask_propagator.h"
+#include "../common/packed_mask_decoder.h"
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <vector>
+
+struct Scene {
+    std::vector<cv::Mat> frames;
+    std::vector<cv::Mat> masks;
+    std::vector<std::vector<cv::Rect>> regions;
+};
+
+// A few random frames with ellipse shaped persons moving over them
+static Scene makeScene(const cv::Size& size, int count) {
+    Scene scene;
+    cv::RNG rng(12345);
+    cv::Mat base(size, CV_8UC3);
+    rng.fill(base, cv::RNG::UNIFORM, 0, 256);
+
+    for (int i = 0; i < count; ++i) {
+        cv::Mat frame = base.clone();
+        cv::Mat mask = cv::Mat::zeros(size, CV_8UC1);
+        std::vector<cv::Rect> regions;
+        for (int p = 0; p < 3; ++p) {
+            cv::Point center(size.width * (p + 1) / 4 + i * 4, size.height / 2);
+            cv::Size axes(size.width / 16, size.height / 4);
+            cv::ellipse(frame, center, axes, 0, 0, 360, cv::Scalar(40, 80, 160), -1);
+            cv::ellipse(mask, center, axes, 0, 0, 360, cv::Scalar(255), -1);
+            cv::Rect box(center.x - axes.width, center.y - axes.height, 2 * axes.width + 1, 2 * axes.height + 1);
+            regions.push_back(box & cv::Rect(0, 0, size.width, size.height));
+        }
+        scene.frames.push_back(frame);
+        scene.masks.push_back(mask);
+        scene.regions.push_back(regions);
+    }
+    return scene;
+}
+
+// Run fn over all the frames of the scene and return the mean time per frame in ms
+static double timeIt(const Scene& scene, int iterations, const std::function<void(int)>& fn) {
+    const int n = static_cast<int>(scene.frames.size());
+    // Warm up caches and lazy allocations
+    for (int i = 0; i < n; ++i) {
+        fn(i);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (int it = 0; it < iterations; ++it) {
+        fn(it % n);
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count() / iterations;
+}
+
+// Pack a binary mask the way SSCMA does: row i starts at byte i * width / 8,
+// pixel j is bit j % 8 of byte j / 8 of the row
+static std::vector<uint8_t> packMask(const cv::Mat& mask) {
+    std::vector<uint8_t> packed((mask.rows * mask.cols + 7) / 8, 0);
+    for (int i = 0; i < mask.rows; ++i) {
+        for (int j = 0; j < mask.cols; ++j) {
+            if (mask.at<uchar>(i, j)) {
+                packed[i * mask.cols / 8 + j / 8] |= 1 << (j % 8);
+            }
+        }
+    }
+    return packed;
+}
+
+// Per-pixel unpacking loop formerly used by RecameraDetector
+static void unpackMaskReference(const std::vector<uint8_t>& data, int width, int height, cv::Mat& mask) {
+    mask = cv::Mat::zeros(height, width, CV_8UC1);
+    for (int i = 0; i < height; ++i) {
+        for (int j = 0; j < width; ++j) {
+            int byte_idx = i * width / 8 + j / 8;
+            int bit_idx = j % 8;
+            if (byte_idx < static_cast<int>(data.size()) && (data[byte_idx] & (1 << bit_idx))) {
+                mask.at<uchar>(i, j) = 255;
+            }
+        }
+    }
+}
+
+static void printResult(const std::string& name, double ms, double referenceMs) {
+    std::cout << "  " << std::left << std::setw(32) << name
+              << std::right << std::fixed << std::setprecision(3) << std::setw(10) << ms << " ms"
+              << std::setprecision(2) << std::setw(8) << referenceMs / ms << "x" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    int iterations = argc > 1 ? std::stoi(argv[1]) : 50;
+    const float learningRate = 0.2f;
+
+    const std::vector<std::pair<std::string, cv::Size>> resolutions = {
+        {"640x480", cv::Size(640, 480)},
+        {"1920x1080", cv::Size(1920, 1080)},
+        {"2592x1944 (5MP)", cv::Size(2592, 1944)},
+    };
+
+    std::cout << "OpenCV " << CV_VERSION << ", " << iterations << " iterations"
+              << ", SIMD128: " << (CV_SIMD128 ? "yes" : "no") << std::endl;
+
+    for (const auto& res : resolutions) {
+        Scene scene = makeScene(res.second, 8);
+        std::cout << res.first << std::endl;
+
+        // Original implementation: one full frame pass per operation
+        cv::Mat bgFloat(res.second, CV_32FC3, cv::Scalar::all(127));
+        double legacyMs = timeIt(scene, iterations, [&](int i) {
+            const cv::Mat& frame = scene.frames[i];
+            cv::Mat original = frame.clone();
+            cv::Mat inverted, frameFloat, background;
+            cv::bitwise_not(scene.masks[i], inverted);
+            original.convertTo(frameFloat, CV_32F);
+            cv::accumulateWeighted(frameFloat, bgFloat, learningRate, inverted);
+            bgFloat.convertTo(background, CV_8U);
+            cv::Mat result = frame.clone();
+            background.copyTo(result, scene.masks[i]);
+        });
+        printResult("multi-pass (float)", legacyMs, legacyMs);
+
+        EmaBackgroundModel model(learningRate);
+        model.initialize(res.second, 3);
+        const uint16_t alpha = model.getAlpha();
+
+        cv::Mat simdAcc = model.getAccumulator().clone();
+        cv::Mat simdOut;
+        double simdMs = timeIt(scene, iterations, [&](int i) {
+            emaComposite(scene.frames[i], scene.masks[i], simdAcc, simdOut, alpha, true);
+        });
+        printResult("fused SIMD", simdMs, legacyMs);
+
+        cv::Mat scalarAcc = model.getAccumulator().clone();
+        cv::Mat scalarOut;
+        double scalarMs = timeIt(scene, iterations, [&](int i) {
+            emaComposite(scene.frames[i], scene.masks[i], scalarAcc, scalarOut, alpha, false);
+        });
+        printResult("fused scalar", scalarMs, legacyMs);
+
+        cv::Mat regionAcc = model.getAccumulator().clone();
+        cv::Mat regionOut;
+        double regionMs = timeIt(scene, iterations, [&](int i) {
+            emaCompositeRegions(scene.frames[i], scene.masks[i], scene.regions[i], regionAcc, regionOut, alpha);
+        });
+        printResult("fused SIMD, regions", regionMs, legacyMs);
+
+        // All versions ran on the same sequence of frames, so they must agree exactly
+        if (cv::norm(simdAcc, scalarAcc, cv::NORM_INF) != 0 || cv::norm(simdOut, scalarOut, cv::NORM_INF) != 0 ||
+            cv::norm(simdAcc, regionAcc, cv::NORM_INF) != 0 || cv::norm(simdOut, regionOut, cv::NORM_INF) != 0) {
+            std::cerr << "Fused kernels differ at " << res.first << std::endl;
+            return 1;
+        }
+
+        // CNT kernel, with the foreground used as a backup mask
+        CntKernelParams cntParams;
+        cntParams.threshold = 20;
+        cntParams.minStability = 15;
+        cntParams.hideForeground = true;
+        const cv::Mat grey(res.second, CV_8UC3, cv::Scalar::all(CntBackgroundModel::kInitialValue));
+        cv::Mat cntSimdBg = grey.clone(), cntSimdCand = grey.clone();
+        cv::Mat cntSimdStab = cv::Mat::zeros(res.second, CV_8UC1);
+        cv::Mat cntSimdFg, cntSimdOut;
+        double cntSimdMs = timeIt(scene, iterations, [&](int i) {
+            cntComposite(scene.frames[i], scene.masks[i], std::vector<cv::Rect>(), cntSimdBg, cntSimdCand,
+                         cntSimdStab, cntSimdFg, cntSimdOut, cntParams, true);
+        });
+        printResult("CNT SIMD", cntSimdMs, legacyMs);
+
+        cv::Mat cntScalarBg = grey.clone(), cntScalarCand = grey.clone();
+        cv::Mat cntScalarStab = cv::Mat::zeros(res.second, CV_8UC1);
+        cv::Mat cntScalarFg, cntScalarOut;
+        double cntScalarMs = timeIt(scene, iterations, [&](int i) {
+            cntComposite(scene.frames[i], scene.masks[i], std::vector<cv::Rect>(), cntScalarBg, cntScalarCand,
+                         cntScalarStab, cntScalarFg, cntScalarOut, cntParams, false);
+        });
+        printResult("CNT scalar", cntScalarMs, legacyMs);
+
+        cv::Mat cntRegionBg = grey.clone(), cntRegionCand = grey.clone();
+        cv::Mat cntRegionStab = cv::Mat::zeros(res.second, CV_8UC1);
+        cv::Mat cntRegionFg, cntRegionOut;
+        double cntRegionMs = timeIt(scene, iterations, [&](int i) {
+            cntComposite(scene.frames[i], scene.masks[i], scene.regions[i], cntRegionBg, cntRegionCand,
+                         cntRegionStab, cntRegionFg, cntRegionOut, cntParams, true);
+        });
+        printResult("CNT SIMD, regions", cntRegionMs, legacyMs);
+
+        if (cv::norm(cntSimdBg, cntScalarBg, cv::NORM_INF) != 0 || cv::norm(cntSimdCand, cntScalarCand, cv::NORM_INF) != 0 ||
+            cv::norm(cntSimdStab, cntScalarStab, cv::NORM_INF) != 0 || cv::norm(cntSimdFg, cntScalarFg, cv::NORM_INF) != 0 ||
+            cv::norm(cntSimdOut, cntScalarOut, cv::NORM_INF) != 0 || cv::norm(cntSimdOut, cntRegionOut, cv::NORM_INF) != 0 ||
+            cv::norm(cntSimdBg, cntRegionBg, cv::NORM_INF) != 0) {
+            std::cerr << "CNT kernels differ at " << res.first << std::endl;
+            return 1;
+        }
+
+        // Every background model as used by VideoAnonymizer, in place on a copy of the frame
+        const std::vector<std::pair<std::string, BackgroundModelFactory::Type>> models = {
+            {"model ema, regions", BackgroundModelFactory::Type::EMA},
+            {"model cnt, regions", BackgroundModelFactory::Type::CNT},
+        };
+        for (const auto& m : models) {
+            BackgroundModelFactory::Parameters modelParams;
+            modelParams.type = m.second;
+            modelParams.learningRate = learningRate;
+            std::unique_ptr<IBackgroundModel> bgModel = BackgroundModelFactory::createBackgroundModel(modelParams);
+            cv::Mat work;
+            double modelMs = timeIt(scene, iterations, [&](int i) {
+                scene.frames[i].copyTo(work);
+                bgModel->updateAndComposite(work, scene.masks[i], scene.regions[i], work);
+            });
+            printResult(m.first, modelMs, legacyMs);
+        }
+
+        // Anonymization modes without background model, with the default settings
+        const std::vector<std::pair<std::string, RegionAnonymizer::Mode>> modes = {
+            {"mode blur, regions", RegionAnonymizer::Mode::BLUR},
+            {"mode pixelate, regions", RegionAnonymizer::Mode::PIXELATE},
+            {"mode solid, regions", RegionAnonymizer::Mode::SOLID},
+        };
+        for (const auto& m : modes) {
+            RegionAnonymizer::Parameters effectParams;
+            effectParams.mode = m.second;
+            RegionAnonymizer effect(effectParams);
+            cv::Mat work;
+            double modeMs = timeIt(scene, iterations, [&](int i) {
+                scene.frames[i].copyTo(work);
+                effect.apply(work, scene.masks[i], scene.regions[i], work);
+            });
+            printResult(m.first, modeMs, legacyMs);
+        }
+
+        // Mask dilation with the largest default radius
+        const int radius = 30;
+        cv::Mat element = cv::getStructuringElement(cv::MORPH_ELLIPSE, cv::Size(2 * radius + 1, 2 * radius + 1));
+        cv::Mat dilated;
+        double ellipseMs = timeIt(scene, iterations, [&](int i) {
+            cv::dilate(scene.masks[i], dilated, element);
+        });
+        printResult("cv::dilate ellipse r30", ellipseMs, ellipseMs);
+
+        MaskDilator diskDilator(MaskDilator::Shape::DISK);
+        double diskMs = timeIt(scene, iterations, [&](int i) {
+            diskDilator.dilate(scene.masks[i], dilated, radius);
+        });
+        printResult("MaskDilator disk r30", diskMs, ellipseMs);
+
+        MaskDilator rectDilator(MaskDilator::Shape::RECT);
+        double rectMs = timeIt(scene, iterations, [&](int i) {
+            rectDilator.dilate(scene.masks[i], dilated, radius);
+        });
+        printResult("MaskDilator rect r30", rectMs, ellipseMs);
+
+        // Bit-packed segmentation masks at the 160x160 native resolution of a
+        // 640x640 model, one per person
+        const cv::Size nativeSize(160, 160);
+        const double nativeScaleX = static_cast<double>(nativeSize.width) / res.second.width;
+        const double nativeScaleY = static_cast<double>(nativeSize.height) / res.second.height;
+        cv::Mat nativeMask;
+        cv::resize(scene.masks[0], nativeMask, nativeSize, 0, 0, cv::INTER_NEAREST);
+        const std::vector<uint8_t> packed = packMask(nativeMask);
+        std::vector<cv::Rect> nativeBoxes;
+        for (const cv::Rect& r : scene.regions[0]) {
+            nativeBoxes.push_back(cv::Rect(cvFloor(r.x * nativeScaleX), cvFloor(r.y * nativeScaleY),
+                                           cvCeil(r.width * nativeScaleX), cvCeil(r.height * nativeScaleY)));
+        }
+
+        cv::Mat unpacked, upscaled;
+        double unpackMs = timeIt(scene, iterations, [&](int) {
+            for (size_t p = 0; p < nativeBoxes.size(); ++p) {
+                unpackMaskReference(packed, nativeSize.width, nativeSize.height, unpacked);
+                cv::resize(unpacked, upscaled, res.second, 0, 0, cv::INTER_NEAREST);
+            }
+        });
+        printResult("unpack loop + resize x3", unpackMs, unpackMs);
+
+        PackedMaskDecoder decoder;
+        std::vector<cv::Mat> decoded(nativeBoxes.size());
+        double decodeMs = timeIt(scene, iterations, [&](int) {
+            for (size_t p = 0; p < nativeBoxes.size(); ++p) {
+                decoder.decode(packed.data(), packed.size(), nativeSize.width, nativeSize.height,
+                               nativeBoxes[p], decoded[p]);
+            }
+        });
+        printResult("LUT decode, box x3", decodeMs, unpackMs);
+
+        double decodeScaledMs = timeIt(scene, iterations, [&](int) {
+            for (size_t p = 0; p < nativeBoxes.size(); ++p) {
+                decoder.decode(packed.data(), packed.size(), nativeSize.width, nativeSize.height,
+                               nativeBoxes[p], scene.regions[0][p].size(), decoded[p]);
+            }
+        });
+        printResult("LUT decode, box at frame res x3", decodeScaledMs, unpackMs);
+
+        unpackMaskReference(packed, nativeSize.width, nativeSize.height, unpacked);
+        for (const cv::Rect& box : nativeBoxes) {
+            cv::Mat native;
+            decoder.decode(packed.data(), packed.size(), nativeSize.width, nativeSize.height, box, native);
+            if (cv::norm(native, unpacked(box & cv::Rect(cv::Point(0, 0), nativeSize)), cv::NORM_INF) != 0) {
+                std::cerr << "Packed mask decoders differ at " << res.first << std::endl;
+                return 1;
+            }
+        }
+
+        // Mask propagation of the persons from one frame to the next
+        MaskPropagator propagator;
+        std::vector<IDetector::Detection> detections;
+        double propagateMs = timeIt(scene, iterations, [&](int i) {
+            if (i == 0) {
+                detections.clear();
+                for (const cv::Rect& r : scene.regions[0]) {
+                    detections.emplace_back(r, 1.0f, 0);
+                }
+                propagator.setReference(scene.frames[0], detections);
+            } else {
+                propagator.propagate(scene.frames[i], detections);
+            }
+        });
+        printResult("MaskPropagator 3 persons", propagateMs, propagateMs);
+    }
+
+    return 0;
+}
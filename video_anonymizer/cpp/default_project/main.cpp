@@ -1,5 +1,6 @@
 #include "../common/video_anonymizer.h"
 #include "../common/detector_factory.h"
+#include "../common/tracer.h"
 #include <iostream>
 #include <string>
 #include <chrono>
@@ -18,6 +19,22 @@ void printUsage(const char* programName) {
     std::cout << "  -c, --conf <threshold>    Confidence threshold (0.0-1.0, default: 0.2)" << std::endl;
     std::cout << "      --iou  <threshold>    IoU threshold (0.0-1.0, default: 0.45)" << std::endl;
     std::cout << "  -w, --width <pixels>      Maximum width to process (preserves aspect ratio)" << std::endl;
+    std::cout << "      --dilation <shape>    Mask dilation shape: none, disk or rect (default: disk)" << std::endl;
+    std::cout << "      --bg-model <model>    Background model: ema or cnt (default: ema)" << std::endl;
+    std::cout << "      --fg-mask             Also hide the moving pixels found by the background model (cnt only)" << std::endl;
+    std::cout << "      --mode <mode>         Anonymization: background, blur, pixelate or solid (default: background)" << std::endl;
+    std::cout << "      --blur <size>         Blur kernel size in pixels (default: 21)" << std::endl;
+    std::cout << "      --pixel-size <size>   Pixelation block size in pixels (default: 16)" << std::endl;
+    std::cout << "      --mask-union          Union the person masks at the detector resolution, upscale once" << std::endl;
+    std::cout << "      --async               Run detection on a worker thread, composite at capture rate" << std::endl;
+    std::cout << "      --max-mask-age <n>    Asynchronous mode: oldest mask in frames before hiding the whole frame (default: 5)" << std::endl;
+    std::cout << "      --detect-every <n>    Run the detector every n frames, move the masks in between (default: 1)" << std::endl;
+    std::cout << "      --track-history <n>   Frames a missed person stays anonymized, 0 disables tracking (default: 15)" << std::endl;
+    std::cout << "      --motion-gate         Skip the detector while the scene is static and nobody is in view" << std::endl;
+    std::cout << "      --gate-refresh <n>    Motion gate: run the detector at least every n frames (default: 30)" << std::endl;
+    std::cout << "      --record <file>       Record the detections, to replay them later" << std::endl;
+    std::cout << "      --replay <file>       Replay recorded detections (or an SSCMA log) instead of running the model" << std::endl;
+    std::cout << "      --trace <file>        Write a Chrome trace of the pipeline stages (ENABLE_TRACING builds)" << std::endl;
     std::cout << "  -g, --gui                 Enable GUI mode. Display the anonymized video" << std::endl;
     std::cout << "  -d, --debug               Enable debug mode. Shows detection and background masks" << std::endl;
     std::cout << "  --use-gpu                 Use GPU for inference" << std::endl;
@@ -42,6 +59,22 @@ int main(int argc, char* argv[]) {
     float iouThreshold = 0.45f;            // Default IoU threshold
     float learningRate = 0.2f;             // Default learning rate
     int maxWidth = 0;                      // 0 means no resizing
+    MaskDilator::Shape dilationShape = MaskDilator::Shape::DISK;
+    BackgroundModelFactory::Type backgroundModel = BackgroundModelFactory::Type::EMA;
+    bool foregroundMasking = false;
+    RegionAnonymizer::Mode anonymizationMode = RegionAnonymizer::Mode::BACKGROUND;
+    int blurStrength = 21;
+    int pixelSize = 16;
+    bool useMaskUnion = false;
+    bool asyncDetection = false;           // Synchronous detection by default
+    int maxMaskAge = 5;
+    int detectionInterval = 1;             // Detect on every frame
+    int trackHistory = 15;                 // 0 disables tracking
+    bool useMotionGate = false;
+    int gateRefreshInterval = 30;
+    std::string recordPath = "";           // Empty means no recording
+    std::string replayPath = "";           // Empty means run the model
+    std::string tracePath = "";            // Empty means no trace
     bool enableGui = false;                // GUI mode disabled by default
     bool enableDebug = false;              // Debug mode disabled by default
     bool useGPU = false;                   // Use GPU for inference
@@ -67,6 +100,50 @@ int main(int argc, char* argv[]) {
             if (i + 1 < argc) iouThreshold = std::stof(argv[++i]);
         } else if (arg == "-w" || arg == "--width") {
             if (i + 1 < argc) maxWidth = std::stoi(argv[++i]);
+        } else if (arg == "--dilation") {
+            if (i + 1 < argc && !MaskDilator::parseShape(argv[++i], dilationShape)) {
+                std::cerr << "Unknown dilation shape: " << argv[i] << std::endl;
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (arg == "--bg-model") {
+            if (i + 1 < argc && !BackgroundModelFactory::parseType(argv[++i], backgroundModel)) {
+                std::cerr << "Unknown background model: " << argv[i] << std::endl;
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (arg == "--fg-mask") {
+            foregroundMasking = true;
+        } else if (arg == "--mode") {
+            if (i + 1 < argc && !RegionAnonymizer::parseMode(argv[++i], anonymizationMode)) {
+                std::cerr << "Unknown anonymization mode: " << argv[i] << std::endl;
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (arg == "--blur") {
+            if (i + 1 < argc) blurStrength = std::stoi(argv[++i]);
+        } else if (arg == "--pixel-size") {
+            if (i + 1 < argc) pixelSize = std::stoi(argv[++i]);
+        } else if (arg == "--mask-union") {
+            useMaskUnion = true;
+        } else if (arg == "--async") {
+            asyncDetection = true;
+        } else if (arg == "--max-mask-age") {
+            if (i + 1 < argc) maxMaskAge = std::stoi(argv[++i]);
+        } else if (arg == "--detect-every") {
+            if (i + 1 < argc) detectionInterval = std::stoi(argv[++i]);
+        } else if (arg == "--track-history") {
+            if (i + 1 < argc) trackHistory = std::stoi(argv[++i]);
+        } else if (arg == "--motion-gate") {
+            useMotionGate = true;
+        } else if (arg == "--gate-refresh") {
+            if (i + 1 < argc) gateRefreshInterval = std::stoi(argv[++i]);
+        } else if (arg == "--record") {
+            if (i + 1 < argc) recordPath = argv[++i];
+        } else if (arg == "--replay") {
+            if (i + 1 < argc) replayPath = argv[++i];
+        } else if (arg == "--trace") {
+            if (i + 1 < argc) tracePath = argv[++i];
         } else if (arg == "-g" || arg == "--gui") {
             enableGui = true;
         } else if (arg == "-d" || arg == "--debug") {
@@ -136,10 +213,36 @@ int main(int argc, char* argv[]) {
     params.modelPath = modelPath;
     params.labelsPath = labelsPath;
     params.learningRate = learningRate;
+    params.dilationShape = dilationShape;
+    params.backgroundModel = backgroundModel;
+    params.foregroundMasking = foregroundMasking;
+    params.anonymizationMode = anonymizationMode;
+    params.blurStrength = blurStrength;
+    params.pixelSize = pixelSize;
+    params.useMaskUnion = useMaskUnion;
+    params.asyncDetection = asyncDetection;
+    params.maxMaskAge = maxMaskAge;
+    params.detectionInterval = detectionInterval;
+    params.useTracking = trackHistory > 0;
+    params.trackHistory = trackHistory;
+    params.useMotionGate = useMotionGate;
+    params.gateRefreshInterval = gateRefreshInterval;
+    params.recordPath = recordPath;
+    params.replayPath = replayPath;
     params.useGPU = useGPU;
     params.debugMode = enableDebug;
     
     VideoAnonymizer anonymizer(params);
+
+    if (!tracePath.empty()) {
+#ifdef ENABLE_TRACING
+        Tracer::instance().setEnabled(true);
+        TRACE_THREAD_NAME("main");
+#else
+        std::cerr << "Warning: tracing is not compiled in, build with -DENABLE_TRACING=ON" << std::endl;
+        tracePath.clear();
+#endif
+    }
     
     // Create windows if GUI or debug mode is enabled
     if (enableGui || enableDebug) {
@@ -163,8 +266,14 @@ int main(int argc, char* argv[]) {
     // Main processing loop
     while (!gStopFlag) {
         // Read frame
+        TRACE_BEGIN_FRAME();
         cv::Mat frame;
-        if (!cap.read(frame)) {
+        bool read;
+        {
+            TRACE_SCOPE("capture.read");
+            read = cap.read(frame);
+        }
+        if (!read) {
             break;
         }
         
@@ -173,9 +282,9 @@ int main(int argc, char* argv[]) {
             cv::resize(frame, frame, cv::Size(), resizeFactor, resizeFactor);
         }
         
-        // Process frame for anonymization
+        // Process frame for anonymization, directly in the captured frame
         auto startTime = std::chrono::high_resolution_clock::now();
-        cv::Mat anonymized = anonymizer.processFrame(frame);
+        anonymizer.processFrameInPlace(frame);
         auto endTime = std::chrono::high_resolution_clock::now();
         
         // Calculate processing time
@@ -184,7 +293,8 @@ int main(int argc, char* argv[]) {
         
         // Write to output file if specified
         if (writer.isOpened()) {
-            writer.write(anonymized);
+            TRACE_SCOPE("output.write");
+            writer.write(frame);
         }
         
         // Display if GUI or debug mode is enabled
@@ -192,11 +302,11 @@ int main(int argc, char* argv[]) {
             // Add FPS text to the frame
             std::stringstream fpsText;
             fpsText << std::fixed << std::setprecision(1) << "FPS: " << processingFps;
-            cv::putText(anonymized, fpsText.str(), cv::Point(10, 30), 
+            cv::putText(frame, fpsText.str(), cv::Point(10, 30), 
                         cv::FONT_HERSHEY_SIMPLEX, 1.0, cv::Scalar(0, 255, 0), 2);
             
             // Show the anonymized video
-            cv::imshow("Anonymized Video", anonymized);
+            cv::imshow("Anonymized Video", frame);
 
             // In debug mode, the video_anonymizer and human_detector will take care of show additional windows
             
@@ -218,6 +328,10 @@ int main(int argc, char* argv[]) {
     if (enableGui || enableDebug) {
         cv::destroyAllWindows();
     }
+
+    if (!tracePath.empty() && !Tracer::instance().exportJson(tracePath)) {
+        std::cerr << "Error: Could not write the trace file: " << tracePath << std::endl;
+    }
     
     return 0;
 }
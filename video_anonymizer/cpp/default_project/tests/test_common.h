@@ -0,0 +1,35 @@
+// Minimal checks shared by the unit tests. Each test is a plain executable
+// registered with CTest, which fails when it returns a non-zero status.
+
+#ifndef TEST_COMMON_H
+#define TEST_COMMON_H
+
+#include <iostream>
+
+// Number of failed checks of the test executable
+inline int& testFailures() {
+    static int failures = 0;
+    return failures;
+}
+
+// Report a failed condition and keep going, so that one run shows every failure
+#define CHECK(condition)                                                                   \
+    do {                                                                                   \
+        if (!(condition)) {                                                                \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition      \
+                      << std::endl;                                                        \
+            ++testFailures();                                                              \
+        }                                                                                  \
+    } while (0)
+
+// Exit status of the test executable
+inline int testResult(const char* name) {
+    if (testFailures() > 0) {
+        std::cerr << name << ": " << testFailures() << " check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << name << ": passed" << std::endl;
+    return 0;
+}
+
+#endif // TEST_COMMON_H
@@ -0,0 +1,196 @@
+// Unit tests of the detection recording and replay.
+//
+// A replay must serve the detections of the frame they were recorded on,
+// whatever the detection settings of both runs, and never the detections of
+// other frames past the end of the recording. The union of the person masks
+// is recorded and replayed too.
+
+#include "test_common.h"
+#include "test_detectors.h"
+#include "../../common/recording_detector.h"
+#include "../../common/replay_detector.h"
+#include <opencv2/core.hpp>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+static const char* kRecordingPath = "test_detection_replay.vadr";
+// Missing on purpose, the replay then only knows the person class
+static const char* kNamesPath = "test_detection_replay.names";
+
+// Box of the person detected on a frame, which encodes the frame index
+static cv::Rect boxOf(uint64_t frameIndex) {
+    return cv::Rect(static_cast<int>(frameIndex), 10, 20, 40);
+}
+
+/**
+ * @brief Detects one person whose box and mask depend on the frame index
+ */
+class FrameIndexDetector : public IDetector {
+public:
+    FrameIndexDetector() : mFrameIndex(0), mNames{"person"} {}
+
+    bool initialize() override { return true; }
+
+    void setFrameIndex(uint64_t frameIndex) override { mFrameIndex = frameIndex; }
+
+    bool detect(const cv::Mat&, std::vector<Detection>& detections) override {
+        detections.assign(1, Detection(boxOf(mFrameIndex), 0.9f, 0));
+        detections[0].mask = cv::Mat::zeros(8, 4, CV_8UC1);
+        detections[0].mask.row(static_cast<int>(mFrameIndex % 8)).setTo(cv::Scalar(255));
+        return true;
+    }
+
+    cv::Size getInputSize() const override { return cv::Size(640, 640); }
+    int getPersonClassId() const override { return 0; }
+    const std::vector<std::string>& getClassNames() const override { return mNames; }
+
+private:
+    uint64_t mFrameIndex;
+    std::vector<std::string> mNames;
+};
+
+static const cv::Mat& frame() {
+    static const cv::Mat image(48, 64, CV_8UC3, cv::Scalar::all(0));
+    return image;
+}
+
+// Frame whose detections the replay serves for frameIndex, -1 if it fails
+static int servedFrame(ReplayDetector& replay, uint64_t frameIndex, std::vector<IDetector::Detection>& detections) {
+    replay.setFrameIndex(frameIndex);
+    if (!replay.detect(frame(), detections)) {
+        CHECK(detections.empty());
+        return -1;
+    }
+    CHECK(detections.size() == 1);
+    return detections.empty() ? -2 : detections[0].bbox.x;
+}
+
+static int servedFrame(ReplayDetector& replay, uint64_t frameIndex) {
+    std::vector<IDetector::Detection> detections;
+    return servedFrame(replay, frameIndex, detections);
+}
+
+static void record(const std::vector<uint64_t>& frameIndices) {
+    RecordingDetector recorder(std::make_unique<FrameIndexDetector>(), kRecordingPath);
+    CHECK(recorder.initialize());
+    std::vector<IDetector::Detection> detections;
+    for (uint64_t frameIndex : frameIndices) {
+        recorder.setFrameIndex(frameIndex);
+        CHECK(recorder.detect(frame(), detections));
+    }
+}
+
+static void testServedByFrameIndex() {
+    // Recorded every 3 frames, e.g. with a detection interval of 3
+    record({0, 3, 6, 9});
+    ReplayDetector replay(kRecordingPath, kNamesPath);
+    CHECK(replay.initialize());
+
+    // Own record, in any order
+    CHECK(servedFrame(replay, 9) == 9);
+    CHECK(servedFrame(replay, 0) == 0);
+    CHECK(servedFrame(replay, 3) == 3);
+
+    // Latest record before the frame, as in the recording run
+    CHECK(servedFrame(replay, 4) == 3);
+    CHECK(servedFrame(replay, 8) == 6);
+
+    // The masks come back as recorded
+    std::vector<IDetector::Detection> detections;
+    CHECK(servedFrame(replay, 6, detections) == 6);
+    if (detections.size() == 1) {
+        const cv::Mat& mask = detections[0].mask;
+        CHECK(mask.size() == cv::Size(4, 8));
+        CHECK(cv::countNonZero(mask) == 4);
+        CHECK(cv::countNonZero(mask.row(6)) == 4);
+    }
+
+    // Past the end, no detections of other frames
+    CHECK(servedFrame(replay, 10) == -1);
+    CHECK(servedFrame(replay, 1000) == -1);
+}
+
+static void testSequentialCalls() {
+    // Without setFrameIndex(), the calls are consecutive frames
+    record({0, 2});
+    ReplayDetector replay(kRecordingPath, kNamesPath);
+    CHECK(replay.initialize());
+    std::vector<IDetector::Detection> detections;
+    const int expected[] = {0, 0, 2};
+    for (int frameIndex : expected) {
+        CHECK(replay.detect(frame(), detections));
+        CHECK(detections.size() == 1 && detections[0].bbox.x == frameIndex);
+    }
+    CHECK(!replay.detect(frame(), detections));
+}
+
+static void testLoop() {
+    record({0, 3, 6, 9});
+    ReplayDetector replay(kRecordingPath, kNamesPath, true);
+    CHECK(replay.initialize());
+    CHECK(servedFrame(replay, 10) == 0);
+    CHECK(servedFrame(replay, 14) == 3);
+    CHECK(servedFrame(replay, 19) == 9);
+}
+
+static bool sameMask(const cv::Mat& a, const cv::Mat& b) {
+    if (a.size() != b.size() || a.type() != b.type()) {
+        return false;
+    }
+    cv::Mat diff;
+    cv::absdiff(a, b, diff);
+    return cv::countNonZero(diff) == 0;
+}
+
+static void testMaskUnion() {
+    // The second person is in the union, the first one has its own mask
+    std::vector<IDetector::Detection> persons;
+    persons.push_back(IDetector::Detection(cv::Rect(0, 0, 10, 10), 0.8f, 0));
+    persons.back().mask = cv::Mat(5, 5, CV_8UC1, cv::Scalar(255));
+    persons.push_back(IDetector::Detection(cv::Rect(5, 6, 28, 18), 0.9f, 0));
+    IDetector::MaskUnion maskUnion;
+    maskUnion.bbox = cv::Rect(4, 6, 30, 20);
+    maskUnion.mask = cv::Mat::zeros(10, 15, CV_8UC1);
+    maskUnion.mask(cv::Rect(2, 3, 6, 4)).setTo(cv::Scalar(255));
+    maskUnion.instances.push_back(1);
+
+    std::vector<IDetector::Detection> detections;
+    {
+        auto scripted = std::make_unique<ScriptedDetector>(persons);
+        scripted->setMaskUnion(maskUnion);
+        RecordingDetector recorder(std::move(scripted), kRecordingPath);
+        CHECK(recorder.initialize());
+        IDetector::MaskUnion detectedUnion;
+        CHECK(recorder.detectWithMaskUnion(frame(), detections, detectedUnion));
+        CHECK(detectedUnion.instances == maskUnion.instances);
+    }
+
+    ReplayDetector replay(kRecordingPath, kNamesPath);
+    CHECK(replay.initialize());
+    IDetector::MaskUnion replayed;
+    CHECK(replay.detectWithMaskUnion(frame(), detections, replayed));
+    CHECK(detections.size() == 2);
+    CHECK(replayed.bbox == maskUnion.bbox);
+    CHECK(replayed.instances == maskUnion.instances);
+    CHECK(sameMask(replayed.mask, maskUnion.mask));
+    if (detections.size() == 2) {
+        CHECK(sameMask(detections[0].mask, persons[0].mask));
+        CHECK(detections[1].mask.empty());
+    }
+
+    // Without the union, the person of the union is left without a mask
+    replay.setFrameIndex(0);
+    CHECK(replay.detect(frame(), detections));
+    CHECK(detections.size() == 2 && detections[1].mask.empty());
+}
+
+int main() {
+    testServedByFrameIndex();
+    testSequentialCalls();
+    testLoop();
+    testMaskUnion();
+    std::remove(kRecordingPath);
+    return testResult("test_detection_replay");
+}
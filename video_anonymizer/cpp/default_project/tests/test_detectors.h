@@ -0,0 +1,108 @@
+// Detectors with a scripted behaviour, so that the anonymizer can be tested
+// without a model.
+
+#ifndef TEST_DETECTORS_H
+#define TEST_DETECTORS_H
+
+#include "../../common/idetector.h"
+#include <string>
+#include <vector>
+
+/**
+ * @brief Returns the same detections (and mask union) on every call, and fails on some calls
+ */
+class ScriptedDetector : public IDetector {
+public:
+    /**
+     * @param detections Detections returned by every successful call
+     * @param failPeriod detect() fails on the calls whose index is a multiple
+     *        of failPeriod (1: always), never if 0
+     */
+    explicit ScriptedDetector(const std::vector<Detection>& detections, int failPeriod = 0)
+        : mDetections(detections), mFailPeriod(failPeriod), mCalls(0), mLastFailed(false), mNames{"person"} {}
+
+    bool initialize() override { return true; }
+
+    bool detect(const cv::Mat&, std::vector<Detection>& detections) override {
+        mLastFailed = mFailPeriod > 0 && mCalls % mFailPeriod == 0;
+        ++mCalls;
+        if (mLastFailed) {
+            return false;
+        }
+        detections = mDetections;
+        return true;
+    }
+
+    // Returns the scripted union, if any, with the scripted detections
+    bool detectWithMaskUnion(const cv::Mat& img, std::vector<Detection>& detections,
+                             MaskUnion& maskUnion) override {
+        maskUnion = MaskUnion();
+        if (!detect(img, detections)) {
+            return false;
+        }
+        maskUnion = mMaskUnion;
+        return true;
+    }
+
+    cv::Size getInputSize() const override { return cv::Size(640, 640); }
+    int getPersonClassId() const override { return 0; }
+    const std::vector<std::string>& getClassNames() const override { return mNames; }
+
+    /// Union returned by detectWithMaskUnion() along with the detections
+    void setMaskUnion(const MaskUnion& maskUnion) { mMaskUnion = maskUnion; }
+
+    /// Whether detect() will fail on its next call
+    bool nextCallFails() const { return mFailPeriod > 0 && mCalls % mFailPeriod == 0; }
+
+    /// Whether the last call of detect() failed
+    bool lastCallFailed() const { return mLastFailed; }
+
+private:
+    std::vector<Detection> mDetections;
+    MaskUnion mMaskUnion;
+    int mFailPeriod;
+    int mCalls;
+    bool mLastFailed;
+    std::vector<std::string> mNames;
+};
+
+/**
+ * @brief Detects one person moving at a constant speed, in step with the
+ *        frame index given by the anonymizer
+ */
+class MovingDetector : public IDetector {
+public:
+    /**
+     * @param box Box of the person on frame 0
+     * @param step Displacement of the person per frame
+     */
+    MovingDetector(const cv::Rect& box, const cv::Point& step)
+        : mBox(box), mStep(step), mFrameIndex(0), mNames{"person"} {}
+
+    bool initialize() override { return true; }
+
+    void setFrameIndex(uint64_t frameIndex) override { mFrameIndex = frameIndex; }
+
+    bool detect(const cv::Mat&, std::vector<Detection>& detections) override {
+        detections.assign(1, Detection(boxAt(mFrameIndex), 0.9f, 0));
+        return true;
+    }
+
+    cv::Size getInputSize() const override { return cv::Size(640, 640); }
+    int getPersonClassId() const override { return 0; }
+    const std::vector<std::string>& getClassNames() const override { return mNames; }
+
+    /// Box of the person on a frame
+    cv::Rect boxAt(uint64_t frameIndex) const {
+        const int n = static_cast<int>(frameIndex);
+        return cv::Rect(mBox.x + mStep.x * n, mBox.y + mStep.y * n, mBox.width, mBox.height);
+    }
+
+private:
+    cv::Rect mBox;
+    cv::Point mStep;
+    uint64_t mFrameIndex;
+    std::vector<std::string> mNames;
+};
+
+#endif // TEST_DETECTORS_H
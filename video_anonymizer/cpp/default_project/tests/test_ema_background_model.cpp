@@ -0,0 +1,83 @@
+// Unit tests of the fixed point EMA background model and of its kernels.
+
+#include "test_common.h"
+#include "../../common/ema_background_model.h"
+#include "../../common/anonymizer_kernels.h"
+#include <opencv2/core.hpp>
+#include <vector>
+
+static cv::Mat randomFrame(cv::RNG& rng, const cv::Size& size) {
+    cv::Mat frame(size, CV_8UC3);
+    rng.fill(frame, cv::RNG::UNIFORM, 0, 256);
+    return frame;
+}
+
+// A learning rate of 0 leaves the background untouched
+static void testFrozen() {
+    cv::RNG rng(7);
+    EmaBackgroundModel model(0.0f);
+    CHECK(model.getAlpha() == 0);
+
+    cv::Mat first = randomFrame(rng, cv::Size(67, 31));
+    model.initialize(first.size(), first.channels(), 100);
+    const cv::Mat initial = model.getAccumulator().clone();
+    cv::Mat output;
+    for (int i = 0; i < 50; ++i) {
+        model.updateAndComposite(randomFrame(rng, first.size()), cv::Mat(), output);
+    }
+    CHECK(cv::norm(model.getAccumulator(), initial, cv::NORM_INF) == 0);
+
+    // Any positive learning rate still learns
+    model.setLearningRate(1e-7f);
+    CHECK(model.getAlpha() == 1);
+}
+
+// A static scene is learned up to the rounding, from above and from below
+static void testConvergence() {
+    for (int start : {0, 255}) {
+        EmaBackgroundModel model(0.01f);
+        cv::Mat frame(16, 16, CV_8UC3, cv::Scalar(37, 129, 200));
+        model.initialize(frame.size(), frame.channels(), static_cast<uchar>(start));
+        for (int i = 0; i < 3000; ++i) {
+            model.update(frame);
+        }
+        CHECK(cv::norm(model.getBackground(), frame, cv::NORM_INF) == 0);
+    }
+}
+
+// The SIMD and scalar kernels agree, and getBackground() rounds like the composite
+static void testKernels() {
+    cv::RNG rng(11);
+    const cv::Size size(131, 17);
+    cv::Mat accSimd(size, CV_16UC3);
+    rng.fill(accSimd, cv::RNG::UNIFORM, 0, 255 << EmaBackgroundModel::kFractionBits);
+    cv::Mat accScalar = accSimd.clone();
+    cv::Mat mask(size, CV_8UC1);
+    rng.fill(mask, cv::RNG::UNIFORM, 0, 2);
+
+    for (uint16_t alpha : {uint16_t(0), uint16_t(1), uint16_t(655), uint16_t(13107), uint16_t(65535)}) {
+        cv::Mat frame = randomFrame(rng, size);
+        cv::Mat outSimd, outScalar;
+        emaComposite(frame, mask, accSimd, outSimd, alpha, true);
+        emaComposite(frame, mask, accScalar, outScalar, alpha, false);
+        CHECK(cv::norm(accSimd, accScalar, cv::NORM_INF) == 0);
+        CHECK(cv::norm(outSimd, outScalar, cv::NORM_INF) == 0);
+    }
+
+    EmaBackgroundModel model(0.2f);
+    cv::Mat frame = randomFrame(rng, size);
+    model.initialize(size, 3);
+    rng.fill(model.getAccumulator(), cv::RNG::UNIFORM, 0, 255 << EmaBackgroundModel::kFractionBits);
+    model.markModified();
+    cv::Mat full(size, CV_8UC1, cv::Scalar(255));
+    cv::Mat output;
+    model.updateAndComposite(frame, full, output);
+    CHECK(cv::norm(model.getBackground(), output, cv::NORM_INF) == 0);
+}
+
+int main() {
+    testFrozen();
+    testConvergence();
+    testKernels();
+    return testResult("test_ema_background_model");
+}
@@ -0,0 +1,152 @@
+// Unit tests of PackedMaskDecoder against the per-pixel unpacking loop
+// formerly used by RecameraDetector, on random masks, regions and sizes.
+
+#include "test_common.h"
+#include "../../common/packed_mask_decoder.h"
+#include <opencv2/core.hpp>
+#include <cstdint>
+#include <vector>
+
+// Per-pixel unpacking loop formerly used by RecameraDetector
+static void unpackMaskReference(const std::vector<uint8_t>& data, int width, int height, cv::Mat& mask) {
+    mask = cv::Mat::zeros(height, width, CV_8UC1);
+    for (int i = 0; i < height; ++i) {
+        for (int j = 0; j < width; ++j) {
+            int byte_idx = i * width / 8 + j / 8;
+            int bit_idx = j % 8;
+            if (byte_idx < static_cast<int>(data.size()) && (data[byte_idx] & (1 << bit_idx))) {
+                mask.at<uchar>(i, j) = 255;
+            }
+        }
+    }
+}
+
+// Nearest neighbor resampling as documented: pixel (x, y) samples the source
+// at (floor(x * src / dst), floor(y * src / dst))
+static cv::Mat resampleReference(const cv::Mat& src, const cv::Size& dstSize) {
+    cv::Mat dst(dstSize, CV_8UC1);
+    for (int y = 0; y < dstSize.height; ++y) {
+        const int srcY = static_cast<int>(static_cast<int64_t>(y) * src.rows / dstSize.height);
+        for (int x = 0; x < dstSize.width; ++x) {
+            const int srcX = static_cast<int>(static_cast<int64_t>(x) * src.cols / dstSize.width);
+            dst.at<uchar>(y, x) = src.at<uchar>(srcY, srcX);
+        }
+    }
+    return dst;
+}
+
+static bool sameMask(const cv::Mat& a, const cv::Mat& b) {
+    if (a.size() != b.size() || a.type() != b.type()) {
+        return false;
+    }
+    return a.empty() || cv::norm(a, b, cv::NORM_INF) == 0;
+}
+
+// Random packed mask of width x height bits, possibly cut short
+static std::vector<uint8_t> randomData(cv::RNG& rng, int width, int height, bool truncate) {
+    std::vector<uint8_t> data((static_cast<size_t>(width) * height + 7) / 8);
+    for (uint8_t& byte : data) {
+        byte = static_cast<uint8_t>(rng.uniform(0, 256));
+    }
+    if (truncate) {
+        data.resize(rng.uniform(0, static_cast<int>(data.size()) + 1));
+    }
+    return data;
+}
+
+// Random region, possibly partly or fully outside of the mask
+static cv::Rect randomRoi(cv::RNG& rng, int width, int height) {
+    const int x = rng.uniform(-4, width + 2);
+    const int y = rng.uniform(-4, height + 2);
+    return cv::Rect(x, y, rng.uniform(0, width + 6), rng.uniform(0, height + 6));
+}
+
+static void testNative(cv::RNG& rng, int width, int height, bool truncate) {
+    const std::vector<uint8_t> data = randomData(rng, width, height, truncate);
+    cv::Mat reference;
+    unpackMaskReference(data, width, height, reference);
+
+    PackedMaskDecoder decoder;
+    cv::Mat decoded;
+
+    // Whole mask
+    decoder.decode(data.data(), data.size(), width, height, cv::Rect(0, 0, width, height), decoded);
+    CHECK(sameMask(decoded, reference));
+
+    // Regions at any offset, clipped to the mask
+    for (int i = 0; i < 20; ++i) {
+        const cv::Rect roi = randomRoi(rng, width, height);
+        const cv::Rect clipped = roi & cv::Rect(0, 0, width, height);
+        decoder.decode(data.data(), data.size(), width, height, roi, decoded);
+        if (clipped.empty()) {
+            CHECK(decoded.empty());
+        } else {
+            CHECK(sameMask(decoded, reference(clipped)));
+        }
+    }
+}
+
+static void testResampled(cv::RNG& rng, int width, int height, bool truncate) {
+    const std::vector<uint8_t> data = randomData(rng, width, height, truncate);
+    cv::Mat reference;
+    unpackMaskReference(data, width, height, reference);
+
+    PackedMaskDecoder decoder;
+    cv::Mat decoded;
+    for (int i = 0; i < 20; ++i) {
+        const cv::Rect roi = randomRoi(rng, width, height);
+        const cv::Rect clipped = roi & cv::Rect(0, 0, width, height);
+        // Down and up scaling, up to 4 times the region
+        const cv::Size dstSize(rng.uniform(1, 4 * (clipped.width + 1)), rng.uniform(1, 4 * (clipped.height + 1)));
+        decoder.decode(data.data(), data.size(), width, height, roi, dstSize, decoded);
+        if (clipped.empty()) {
+            CHECK(sameMask(decoded, cv::Mat::zeros(dstSize, CV_8UC1)));
+        } else {
+            CHECK(sameMask(decoded, resampleReference(reference(clipped), dstSize)));
+        }
+    }
+}
+
+static void testDecodeRow() {
+    // 0b10110001 0b00001111: bit 0 first
+    const uint8_t row[] = {0xB1, 0x0F};
+    const uchar expected[] = {255, 0, 0, 0, 255, 255, 0, 255, 255, 255, 255, 255, 0, 0, 0, 0};
+    uchar out[16];
+
+    PackedMaskDecoder::decodeRow(row, sizeof(row), 0, 16, out);
+    for (int x = 0; x < 16; ++x) {
+        CHECK(out[x] == expected[x]);
+    }
+
+    // Unaligned start and end
+    PackedMaskDecoder::decodeRow(row, sizeof(row), 3, 10, out);
+    for (int x = 0; x < 10; ++x) {
+        CHECK(out[x] == expected[x + 3]);
+    }
+
+    // The bits past the data are zeros
+    PackedMaskDecoder::decodeRow(row, 1, 5, 8, out);
+    for (int x = 0; x < 8; ++x) {
+        CHECK(out[x] == (x + 5 < 8 ? expected[x + 5] : 0));
+    }
+}
+
+int main() {
+    testDecodeRow();
+
+    cv::RNG rng(20240613);
+    for (int i = 0; i < 200; ++i) {
+        // Mostly widths that are not a multiple of 8, whose rows do not
+        // start on a byte boundary
+        int width = rng.uniform(1, 200);
+        if (i % 4 == 0) {
+            width = (width + 7) / 8 * 8;
+        }
+        const int height = rng.uniform(1, 100);
+        const bool truncate = i % 3 == 0;
+        testNative(rng, width, height, truncate);
+        testResampled(rng, width, height, truncate);
+    }
+
+    return testResult("test_packed_mask_decoder");
+}
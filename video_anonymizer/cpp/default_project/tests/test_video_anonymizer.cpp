@@ -0,0 +1,140 @@
+// Unit tests of VideoAnonymizer with scripted detectors.
+//
+// A failed detection must never let the frame through: the persons could be
+// anywhere, so the whole frame is anonymized. A mask union must be
+// anonymized in full, even where it reaches past the boxes of its persons.
+// Masks moved between detector runs must follow the persons when the
+// detection interval changes at runtime.
+
+#include "test_common.h"
+#include "test_detectors.h"
+#include "../../common/video_anonymizer.h"
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include <memory>
+#include <vector>
+
+// Whether every channel of every pixel of the output differs from the frame
+static bool nothingLeaked(const cv::Mat& frame, const cv::Mat& output) {
+    if (output.size() != frame.size() || output.type() != frame.type()) {
+        return false;
+    }
+    cv::Mat diff;
+    cv::absdiff(frame, output, diff);
+    diff = diff.reshape(1);
+    return cv::countNonZero(diff) == static_cast<int>(diff.total());
+}
+
+static void testFailingDetector(RegionAnonymizer::Mode mode, bool useMaskUnion, int failPeriod,
+                                const std::vector<IDetector::Detection>& detections) {
+    VideoAnonymizer::Parameters params;
+    params.anonymizationMode = mode;
+    params.useMaskUnion = useMaskUnion;
+    auto detector = std::make_unique<ScriptedDetector>(detections, failPeriod);
+    ScriptedDetector* script = detector.get();
+    VideoAnonymizer anonymizer(params, std::move(detector));
+
+    for (int i = 0; i < 12; ++i) {
+        // The frames the detector fails on are dark, the others bright. The
+        // background model only learns from the bright ones and starts grey,
+        // so it never matches a dark frame.
+        const bool fails = script->nextCallFails();
+        cv::Mat frame(48, 64, CV_8UC3, cv::Scalar::all(fails ? 20 + i : 230));
+        cv::Mat output = anonymizer.processFrame(frame);
+
+        CHECK(script->lastCallFailed() == fails);
+        if (fails) {
+            CHECK(nothingLeaked(frame, output));
+            CHECK(anonymizer.getMaskAge() == -1);
+        }
+    }
+}
+
+static void testMaskUnionPastBoxes(RegionAnonymizer::Mode mode) {
+    VideoAnonymizer::Parameters params;
+    params.anonymizationMode = mode;
+    params.useMaskUnion = true;
+    // Without dilation, nothing else covers the pixels past the box
+    params.dilationShape = MaskDilator::Shape::NONE;
+
+    // The union is at half the resolution of the frame and its grid is
+    // rounded outwards, so it covers more than the box of the person
+    const cv::Rect personBox(41, 21, 18, 38);
+    IDetector::MaskUnion maskUnion;
+    maskUnion.bbox = cv::Rect(36, 16, 28, 48);
+    maskUnion.mask = cv::Mat(maskUnion.bbox.height / 2, maskUnion.bbox.width / 2, CV_8UC1, cv::Scalar(255));
+    maskUnion.instances.push_back(0);
+
+    auto detector = std::make_unique<ScriptedDetector>(
+        std::vector<IDetector::Detection>(1, IDetector::Detection(personBox, 0.9f, 0)));
+    detector->setMaskUnion(maskUnion);
+    VideoAnonymizer anonymizer(params, std::move(detector));
+
+    // The background model starts grey and never learns the union area
+    const cv::Mat frame(96, 128, CV_8UC3, cv::Scalar::all(230));
+    for (int i = 0; i < 4; ++i) {
+        cv::Mat output = anonymizer.processFrame(frame);
+        CHECK(output.size() == frame.size());
+        if (output.size() == frame.size()) {
+            CHECK(nothingLeaked(frame(maskUnion.bbox), output(maskUnion.bbox)));
+        }
+    }
+}
+
+static void testIntervalChanges() {
+    VideoAnonymizer::Parameters params;
+    params.keepSnapshots = true;
+
+    // The scene and the person move right by one block of the propagation
+    // (4 pixels) per frame, over a random texture that matches unambiguously
+    const int frames = 14;
+    const cv::Point step(4, 0);
+    cv::Mat blocks(30, 40 + frames, CV_8UC3);
+    cv::RNG rng(42);
+    rng.fill(blocks, cv::RNG::UNIFORM, 0, 256);
+    cv::Mat texture;
+    cv::resize(blocks, texture, cv::Size(), 4, 4, cv::INTER_NEAREST);
+
+    auto detector = std::make_unique<MovingDetector>(cv::Rect(40, 40, 48, 48), step);
+    const MovingDetector* person = detector.get();
+    VideoAnonymizer anonymizer(params, std::move(detector));
+
+    // Every other frame, then every frame, then every other frame again:
+    // frame 10 is propagated from the detections of frame 9
+    for (int i = 0; i < frames; ++i) {
+        anonymizer.setDetectionInterval(i >= 4 && i < 10 ? 1 : 2);
+        const cv::Mat frame = texture(cv::Rect(step.x * (frames - i), 0, 160, 120)).clone();
+        anonymizer.processFrame(frame);
+
+        const std::vector<IDetector::Detection>& detections = anonymizer.getDetections();
+        CHECK(detections.size() == 1);
+        if (detections.size() == 1 && detections[0].bbox != person->boxAt(i)) {
+            std::cerr << "Frame " << i << ": person at " << detections[0].bbox << " instead of "
+                      << person->boxAt(i) << std::endl;
+            CHECK(detections[0].bbox == person->boxAt(i));
+        }
+    }
+}
+
+int main() {
+    // A person in the middle of the frame, without segmentation mask
+    std::vector<IDetector::Detection> person(1, IDetector::Detection(cv::Rect(24, 12, 16, 24), 0.9f, 0));
+
+    for (RegionAnonymizer::Mode mode : {RegionAnonymizer::Mode::BACKGROUND, RegionAnonymizer::Mode::SOLID}) {
+        for (bool useMaskUnion : {false, true}) {
+            // Always failing, e.g. a replay past the end of its recording
+            testFailingDetector(mode, useMaskUnion, 1, {});
+            // Failing now and then, with and without a person in view
+            testFailingDetector(mode, useMaskUnion, 2, {});
+            testFailingDetector(mode, useMaskUnion, 3, person);
+        }
+    }
+
+    for (RegionAnonymizer::Mode mode : {RegionAnonymizer::Mode::BACKGROUND, RegionAnonymizer::Mode::SOLID}) {
+        testMaskUnionPastBoxes(mode);
+    }
+
+    testIntervalChanges();
+
+    return testResult("test_video_anonymizer");
+}
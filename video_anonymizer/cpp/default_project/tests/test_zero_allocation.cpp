@@ -0,0 +1,121 @@
+// Checks that VideoAnonymizer::processFrame does not allocate images once
+// warmed up: all its working buffers are allocated at the first frames and
+// reused afterwards.
+//
+// Every cv::Mat allocation goes through a counting cv::MatAllocator installed
+// as the default allocator. The detector is scripted, so that the test only
+// covers the anonymizer.
+
+#include "test_common.h"
+#include "test_detectors.h"
+#include "../../common/video_anonymizer.h"
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Counts the buffers allocated by cv::Mat, and lets the standard allocator do the work
+class CountingAllocator : public cv::MatAllocator {
+public:
+    explicit CountingAllocator(cv::MatAllocator* inner) : mInner(inner), mCount(0) {}
+
+    cv::UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step,
+                           cv::AccessFlag flags, cv::UMatUsageFlags usageFlags) const override {
+        ++mCount;
+        return mInner->allocate(dims, sizes, type, data, step, flags, usageFlags);
+    }
+
+    bool allocate(cv::UMatData* data, cv::AccessFlag accessFlags, cv::UMatUsageFlags usageFlags) const override {
+        return mInner->allocate(data, accessFlags, usageFlags);
+    }
+
+    void deallocate(cv::UMatData* data) const override {
+        mInner->deallocate(data);
+    }
+
+    int count() const { return mCount; }
+    void resetCount() { mCount = 0; }
+
+private:
+    cv::MatAllocator* mInner;
+    mutable std::atomic<int> mCount;
+};
+
+static CountingAllocator& allocator() {
+    static CountingAllocator counting(cv::Mat::getStdAllocator());
+    return counting;
+}
+
+// Two persons with a segmentation mask at half the resolution of the frame
+static std::vector<IDetector::Detection> makePersons() {
+    std::vector<IDetector::Detection> persons;
+    for (const cv::Rect& box : {cv::Rect(40, 60, 60, 140), cv::Rect(200, 50, 70, 160)}) {
+        IDetector::Detection det(box, 0.9f, 0);
+        det.mask = cv::Mat::zeros(box.height / 2, box.width / 2, CV_8UC1);
+        cv::ellipse(det.mask, cv::Point(det.mask.cols / 2, det.mask.rows / 2),
+                    cv::Size(det.mask.cols / 3, det.mask.rows / 2 - 2), 0, 0, 360, cv::Scalar(255), -1);
+        persons.push_back(det);
+    }
+    return persons;
+}
+
+static void testSteadyState(const std::string& name, const VideoAnonymizer::Parameters& params) {
+    const std::vector<IDetector::Detection> persons = makePersons();
+    std::vector<cv::Mat> frames(4);
+    cv::RNG rng(1234);
+    for (cv::Mat& frame : frames) {
+        frame.create(240, 320, CV_8UC3);
+        rng.fill(frame, cv::RNG::UNIFORM, 0, 256);
+    }
+
+    VideoAnonymizer anonymizer(params, std::make_unique<ScriptedDetector>(persons));
+    cv::Mat output;
+    cv::Mat work;
+
+    // The dilation radius changes at the end of the warm-up frames of the
+    // background, the buffers are all sized after that
+    const int warmup = params.warmupFrames + 10;
+    const int measured = 50;
+    for (int i = 0; i < warmup + measured; ++i) {
+        if (i == warmup) {
+            allocator().resetCount();
+        }
+        const cv::Mat& frame = frames[i % frames.size()];
+        anonymizer.processFrame(frame, output);
+        frame.copyTo(work);
+        anonymizer.processFrameInPlace(work);
+    }
+
+    const int allocations = allocator().count();
+    if (allocations != 0) {
+        std::cerr << name << ": " << allocations << " allocations in " << measured << " frames after warm-up"
+                  << std::endl;
+    }
+    CHECK(allocations == 0);
+}
+
+int main() {
+    cv::Mat::setDefaultAllocator(&allocator());
+
+    VideoAnonymizer::Parameters params;
+    testSteadyState("default", params);
+
+    params.dilationShape = MaskDilator::Shape::RECT;
+    testSteadyState("rect dilation", params);
+
+    params.dilationShape = MaskDilator::Shape::NONE;
+    testSteadyState("no dilation", params);
+
+    params = VideoAnonymizer::Parameters();
+    params.anonymizationMode = RegionAnonymizer::Mode::SOLID;
+    testSteadyState("solid", params);
+
+    params = VideoAnonymizer::Parameters();
+    params.keepSnapshots = true;
+    testSteadyState("snapshots", params);
+
+    cv::Mat::setDefaultAllocator(nullptr);
+    return testResult("test_zero_allocation");
+}
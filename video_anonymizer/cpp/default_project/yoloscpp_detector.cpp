@@ -53,12 +53,19 @@ bool YolosCppDetector::detect(const cv::Mat& frame, std::vector<Detection>& resu
         auto segmentations = mSegmentor->segment(frame, confThreshold, iouThreshold);
         
         // Convert Segmentation results to our Detection format
+        const cv::Rect frameRect(0, 0, frame.cols, frame.rows);
         for (const auto& seg : segmentations) {
             Detection result;
-            result.bbox = cv::Rect(seg.box.x, seg.box.y, seg.box.width, seg.box.height);
+            result.bbox = cv::Rect(seg.box.x, seg.box.y, seg.box.width, seg.box.height) & frameRect;
             result.confidence = seg.conf;
             result.classId = seg.classId;
-            result.mask = seg.mask.clone(); // Clone the mask to ensure we own the data
+            // Only keep the part of the full frame mask inside the box. Cloned,
+            // so that we own the data and the full frame mask can be freed.
+            if (seg.mask.size() == frame.size() && !result.bbox.empty()) {
+                result.mask = seg.mask(result.bbox).clone();
+            } else {
+                result.mask = seg.mask.clone();
+            }
             
             results.push_back(result);
         }
@@ -1,6 +1,6 @@
 #include "cvi_h264_streamer.h"
-#include <iostream>
 #include <opencv2/imgproc.hpp>
+#include <algorithm>
 #include <chrono>
 #include <arpa/inet.h>
 #include <netdb.h>
@@ -11,12 +11,43 @@
 #include <netinet/in.h>
 #include <net/if.h>
 #include <thread>
+#include "../common/logger.h"
+#include "../common/metrics.h"
+#include "../common/tracer.h"
+#include "vb_mapping_cache.h"
 
 #define TAG "CviH264Streamer"
 #define ALIGN_UP(x, align) (((x) + ((align) - 1)) & ~((align) - 1))
 
 #define REPORT_BITRATE_INTERVAL_MS 10000
 
+// Latencies and counters of the encoder stages
+struct EncoderMetrics {
+    LatencyHistogram& yuvConversion;
+    LatencyHistogram& encode;
+    LatencyHistogram& rtspWrite;
+    MetricCounter& frames;
+    MetricCounter& iFrames;
+    MetricCounter& bytes;
+    MetricCounter& errors;
+    MetricCounter& droppedFrames;
+
+    EncoderMetrics()
+        : yuvConversion(MetricsRegistry::instance().histogram("encoder.yuv_conversion")),
+          encode(MetricsRegistry::instance().histogram("encoder.encode")),
+          rtspWrite(MetricsRegistry::instance().histogram("rtsp.write")),
+          frames(MetricsRegistry::instance().counter("encoder.frames")),
+          iFrames(MetricsRegistry::instance().counter("encoder.i_frames")),
+          bytes(MetricsRegistry::instance().counter("encoder.bytes")),
+          errors(MetricsRegistry::instance().counter("encoder.errors")),
+          droppedFrames(MetricsRegistry::instance().counter("encoder.dropped_frames")) {}
+};
+
+static EncoderMetrics& metrics() {
+    static EncoderMetrics m;
+    return m;
+}
+
 // Helper function to get current time in milliseconds
 static uint64_t getCurrentTimeMs() {
     struct timeval tv;
@@ -43,13 +74,13 @@ CviH264Streamer::CviH264Streamer(const Config& config)
     
     // Validate configuration parameters
     if (m_config.width <= 0 || m_config.height <= 0) {
-        std::cerr << TAG << ": Invalid dimensions, using defaults (1280x720)" << std::endl;
+        LOGW(TAG) << "Invalid dimensions, using defaults (1280x720)";
         m_config.width = 1280;
         m_config.height = 720;
     }
     
     if (m_config.fps <= 0 || m_config.fps > 60) {
-        std::cerr << TAG << ": Invalid FPS, using default (30)" << std::endl;
+        LOGW(TAG) << "Invalid FPS, using default (30)";
         m_config.fps = 30;
     }
     
@@ -57,7 +88,7 @@ CviH264Streamer::CviH264Streamer(const Config& config)
         // Calculate a reasonable default bitrate based on resolution
         int defaultBitrate = m_config.width * m_config.height * m_config.fps * 0.1;
         m_config.bitrate = std::min(std::max(defaultBitrate, 1000000), 10000000); // Between 1 and 10 Mbps
-        std::cerr << TAG << ": Invalid bitrate, using calculated value: " << m_config.bitrate << " bps" << std::endl;
+        LOGW(TAG) << "Invalid bitrate, using calculated value: " << m_config.bitrate << " bps";
     }
     
     // Update GOP if needed (typically equals framerate for 1-second GOP)
@@ -79,8 +110,8 @@ CviH264Streamer::CviH264Streamer(const Config& config)
                  std::to_string(m_config.port) + "/" + m_config.streamName;
     
     // Only show resolution and bitrate info in constructor log
-    std::cout << TAG << ": Resolution: " << m_config.width << "x" << m_config.height 
-              << " @ " << m_config.fps << " FPS, Bitrate: " << (m_config.bitrate / 1000) << " Kbps" << std::endl;
+    LOGI(TAG) << "Resolution: " << m_config.width << "x" << m_config.height 
+              << " @ " << m_config.fps << " FPS, Bitrate: " << (m_config.bitrate / 1000) << " Kbps";
     
     // Initialize RTSP context
     memset(&m_rtspCtx, 0, sizeof(m_rtspCtx));
@@ -151,23 +182,22 @@ CviH264Streamer::~CviH264Streamer() {
             double durationSec = (endTime - m_startTime) / 1000.0;
             avgBitsPerSecond = (m_totalBytes * 8.0) / durationSec;
             
-            std::cout << "\n";
-            std::cout << "========== FINAL ENCODING STATISTICS ==========\n";
-            std::cout << "Total encoded frames: " << m_totalFrames << "\n";
-            std::cout << "Total I-frames: " << m_totalIFrames << " (" 
+            LOGI(TAG) << "========== FINAL ENCODING STATISTICS ==========";
+            LOGI(TAG) << "Total encoded frames: " << m_totalFrames;
+            LOGI(TAG) << "Total I-frames: " << m_totalIFrames << " (" 
                       << std::fixed << std::setprecision(1) 
-                      << (static_cast<double>(m_totalIFrames) / m_totalFrames * 100.0) << "%)\n";
-            std::cout << "Total encoded bytes: " << m_totalBytes << "\n";
-            std::cout << "Average bytes per frame: " << static_cast<int>(avgBytesPerFrame) << "\n";
-            std::cout << "Average bitrate: " << std::fixed << std::setprecision(2) 
-                      << (avgBitsPerSecond / 1000000.0) << " Mbps\n";
-            std::cout << "Target bitrate: " << std::fixed << std::setprecision(2)
-                      << (m_config.bitrate / 1000000.0) << " Mbps\n";
-            std::cout << "Encoding duration: " << std::fixed << std::setprecision(1) 
-                      << durationSec << " seconds\n";
-            std::cout << "Average FPS: " << std::fixed << std::setprecision(1) 
-                      << (m_totalFrames / durationSec) << "\n";
-            std::cout << "===============================================\n";
+                      << (static_cast<double>(m_totalIFrames) / m_totalFrames * 100.0) << "%)";
+            LOGI(TAG) << "Total encoded bytes: " << m_totalBytes;
+            LOGI(TAG) << "Average bytes per frame: " << static_cast<int>(avgBytesPerFrame);
+            LOGI(TAG) << "Average bitrate: " << std::fixed << std::setprecision(2) 
+                      << (avgBitsPerSecond / 1000000.0) << " Mbps";
+            LOGI(TAG) << "Target bitrate: " << std::fixed << std::setprecision(2)
+                      << (m_config.bitrate / 1000000.0) << " Mbps";
+            LOGI(TAG) << "Encoding duration: " << std::fixed << std::setprecision(1) 
+                      << durationSec << " seconds";
+            LOGI(TAG) << "Average FPS: " << std::fixed << std::setprecision(1) 
+                      << (m_totalFrames / durationSec);
+            LOGI(TAG) << "===============================================";
         }
     }
     
@@ -177,7 +207,7 @@ CviH264Streamer::~CviH264Streamer() {
 // Initialize the encoder and RTSP server
 bool CviH264Streamer::initialize(bool perform_video_init, bool configure_vbpool, bool start_thread) {
     if (m_initialized) {
-        std::cout << TAG << ": Already initialized" << std::endl;
+        LOGI(TAG) << "Already initialized";
         return true;
     }
     
@@ -195,18 +225,18 @@ bool CviH264Streamer::initialize(bool perform_video_init, bool configure_vbpool,
         param.format = VIDEO_FORMAT_H264;
 
         /*if (setupVideo(m_config.videoCh, &param, false) != 0) {
-            std::cerr << "Failed to setup video channel" << std::endl;
+            LOGE(TAG) << "Failed to setup video channel";
             return false;
         }*/
 
         if (cvi_system_setVbPool(m_config.videoCh, &param, m_config.vbPoolCount) != CVI_SUCCESS) {
-            std::cerr << TAG << ": Failed to set VbPool: cvi_system_setVbPool for channel " << m_config.videoCh 
-                      << ". vbPoolCount: " << m_config.vbPoolCount << std::endl;
+            LOGE(TAG) << "Failed to set VbPool: cvi_system_setVbPool for channel " << m_config.videoCh 
+                      << ". vbPoolCount: " << m_config.vbPoolCount;
             return false;
         }
 
         if (cvi_system_Sys_Init() != CVI_SUCCESS) {
-            std::cerr << TAG << ": Failed to initialize system: cvi_system_Sys_Init" << std::endl;
+            LOGE(TAG) << "Failed to initialize system: cvi_system_Sys_Init";
             return false;
         }
 
@@ -214,11 +244,11 @@ bool CviH264Streamer::initialize(bool perform_video_init, bool configure_vbpool,
     }
 
     if (!start_thread) {
-        std::cout << TAG << ": Skipping the starting of RTSP server thread" << std::endl;
+        LOGI(TAG) << "Skipping the starting of RTSP server thread";
         return true;
     }
     
-    std::cout << TAG << ": Starting H264 encoder and RTSP server..." << std::endl;
+    LOGI(TAG) << "Starting H264 encoder and RTSP server...";
     
     m_running.store(true);
     m_startTime = getCurrentTimeMs();
@@ -226,14 +256,14 @@ bool CviH264Streamer::initialize(bool perform_video_init, bool configure_vbpool,
     try {
         // Initialize VENC (H264 encoder)
         if (!initVenc()) {
-            std::cerr << TAG << ": Failed to initialize VENC" << std::endl;
+            LOGE(TAG) << "Failed to initialize VENC";
             cleanup();
             return false;
         }
         
         // Initialize RTSP server last
         if (!initRtsp()) {
-            std::cerr << TAG << ": Failed to initialize RTSP server" << std::endl;
+            LOGE(TAG) << "Failed to initialize RTSP server";
             cleanup();
             return false;
         }
@@ -259,9 +289,9 @@ bool CviH264Streamer::initialize(bool perform_video_init, bool configure_vbpool,
             
             // Set thread scheduling parameters
             if (pthread_setschedparam(pthread_self(), SCHED_RR, &param) != 0) {
-                std::cerr << TAG << ": Warning: Could not set thread priority, continuing with default" << std::endl;
+                LOGW(TAG) << "Could not set thread priority, continuing with default";
             } else {
-                std::cout << TAG << ": Encoding thread priority increased" << std::endl;
+                LOGI(TAG) << "Encoding thread priority increased";
             }
             
             // Clean up
@@ -269,11 +299,11 @@ bool CviH264Streamer::initialize(bool perform_video_init, bool configure_vbpool,
         }
         
         m_initialized = true;
-        std::cout << TAG << ": Initialization successful" << std::endl;
+        LOGI(TAG) << "Initialization successful";
         return true;
     } 
     catch (const std::exception& e) {
-        std::cerr << TAG << ": Exception during initialization: " << e.what() << std::endl;
+        LOGE(TAG) << "Exception during initialization: " << e.what();
         cleanup();
         return false;
     }
@@ -304,6 +334,63 @@ void CviH264Streamer::forceIFrame() {
     m_lastIFrameTime = getCurrentTimeMs();
 }
 
+bool CviH264Streamer::setQpRange(int qpMin, int qpMax) {
+    if (!m_initialized || m_vencChn < 0) {
+        return false;
+    }
+    qpMin = std::max(0, std::min(qpMin, 51));
+    qpMax = std::max(qpMin, std::min(qpMax, 51));
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    CVI_S32 s32Ret;
+    if (m_config.rcMode == 3) {
+        // FIXQP has no range, only the QPs of the channel attributes
+        VENC_CHN_ATTR_S stVencChnAttr;
+        s32Ret = CVI_VENC_GetChnAttr(m_vencChn, &stVencChnAttr);
+        if (s32Ret == CVI_SUCCESS) {
+            const int qpI = std::max(0, std::min(m_config.qpInit + qpMin - m_config.qpMin, 51));
+            stVencChnAttr.stRcAttr.stH264FixQp.u32IQp = qpI;
+            stVencChnAttr.stRcAttr.stH264FixQp.u32PQp = std::min(qpI + 3, 51);
+            s32Ret = CVI_VENC_SetChnAttr(m_vencChn, &stVencChnAttr);
+        }
+    } else {
+        VENC_RC_PARAM_S stRcParam;
+        memset(&stRcParam, 0, sizeof(VENC_RC_PARAM_S));
+        s32Ret = CVI_VENC_GetRcParam(m_vencChn, &stRcParam);
+        if (s32Ret == CVI_SUCCESS) {
+            switch (m_config.rcMode) {
+                case 1:
+                    stRcParam.stParamH264Vbr.u32MinQp = qpMin;
+                    stRcParam.stParamH264Vbr.u32MaxQp = qpMax;
+                    stRcParam.stParamH264Vbr.u32MinIQp = qpMin;
+                    stRcParam.stParamH264Vbr.u32MaxIQp = qpMax;
+                    break;
+                case 2:
+                    stRcParam.stParamH264AVbr.u32MinQp = qpMin;
+                    stRcParam.stParamH264AVbr.u32MaxQp = qpMax;
+                    stRcParam.stParamH264AVbr.u32MinIQp = qpMin;
+                    stRcParam.stParamH264AVbr.u32MaxIQp = qpMax;
+                    break;
+                case 0:
+                default:
+                    stRcParam.stParamH264Cbr.u32MinQp = qpMin;
+                    stRcParam.stParamH264Cbr.u32MaxQp = qpMax;
+                    stRcParam.stParamH264Cbr.u32MinIQp = qpMin;
+                    stRcParam.stParamH264Cbr.u32MaxIQp = qpMax;
+                    break;
+            }
+            s32Ret = CVI_VENC_SetRcParam(m_vencChn, &stRcParam);
+        }
+    }
+
+    if (s32Ret != CVI_SUCCESS) {
+        LOGE(TAG) << "Failed to set the QP range " << qpMin << "-" << qpMax << ": " << s32Ret;
+        return false;
+    }
+    LOGD(TAG) << "QP range set to " << qpMin << "-" << qpMax;
+    return true;
+}
+
 // Initialize the VENC encoder
 bool CviH264Streamer::initVenc() {
     CVI_S32 s32Ret;
@@ -313,12 +400,12 @@ bool CviH264Streamer::initVenc() {
     
     // Validate channel number (CVI SDK typically supports 0-31)
     if (m_vencChn < 0 || m_vencChn > 31) {
-        std::cerr << TAG << ": Invalid VENC channel number: " << m_vencChn << ", using default (0)" << std::endl;
+        LOGW(TAG) << "Invalid VENC channel number: " << m_vencChn << ", using default (0)";
         m_vencChn = 0;
     }
     
     // Log the channel being used
-    std::cout << TAG << ": Using VENC channel " << m_vencChn << std::endl;
+    LOGI(TAG) << "Using VENC channel " << m_vencChn;
     
     // Set up encoder attributes
     VENC_CHN_ATTR_S stVencChnAttr;
@@ -354,7 +441,7 @@ bool CviH264Streamer::initVenc() {
             stVencChnAttr.stRcAttr.stH264Vbr.fr32DstFrameRate = m_config.fps;
             // Convert from bits/sec to kbps
             stVencChnAttr.stRcAttr.stH264Vbr.u32MaxBitRate = m_config.bitrate / 1000;
-            std::cout << TAG << ": Set VBR mode with Max Bitrate: " << (m_config.bitrate / 1000) << " Kbps" << std::endl;
+            LOGI(TAG) << "Set VBR mode with Max Bitrate: " << (m_config.bitrate / 1000) << " Kbps";
             break;
             
         case 2:  // AVBR mode
@@ -364,7 +451,7 @@ bool CviH264Streamer::initVenc() {
             stVencChnAttr.stRcAttr.stH264AVbr.fr32DstFrameRate = m_config.fps;
             // Convert from bits/sec to kbps
             stVencChnAttr.stRcAttr.stH264AVbr.u32MaxBitRate = m_config.bitrate / 1000;
-            std::cout << TAG << ": Set AVBR mode with Max Bitrate: " << (m_config.bitrate / 1000) << " Kbps" << std::endl;
+            LOGI(TAG) << "Set AVBR mode with Max Bitrate: " << (m_config.bitrate / 1000) << " Kbps";
             break;
             
         case 3:  // FIXQP mode - this forces specific QP values
@@ -374,8 +461,8 @@ bool CviH264Streamer::initVenc() {
             stVencChnAttr.stRcAttr.stH264FixQp.fr32DstFrameRate = m_config.fps;
             stVencChnAttr.stRcAttr.stH264FixQp.u32IQp = m_config.qpInit;  // I-frame QP
             stVencChnAttr.stRcAttr.stH264FixQp.u32PQp = m_config.qpInit + 3;  // P-frame QP
-            std::cout << TAG << ": Set FIXQP mode with QP values: I=" << m_config.qpInit 
-                      << ", P=" << (m_config.qpInit + 3) << std::endl;
+            LOGI(TAG) << "Set FIXQP mode with QP values: I=" << m_config.qpInit 
+                      << ", P=" << (m_config.qpInit + 3);
             break;
             
         case 0:  // CBR mode (default)
@@ -386,14 +473,14 @@ bool CviH264Streamer::initVenc() {
             stVencChnAttr.stRcAttr.stH264Cbr.fr32DstFrameRate = m_config.fps;
             // Convert from bits/sec to kbps
             stVencChnAttr.stRcAttr.stH264Cbr.u32BitRate = m_config.bitrate / 1000;
-            std::cout << TAG << ": Set CBR mode with Bitrate: " << (m_config.bitrate / 1000) << " Kbps" << std::endl;
+            LOGI(TAG) << "Set CBR mode with Bitrate: " << (m_config.bitrate / 1000) << " Kbps";
             break;
     }
     
     // Create VENC channel
     s32Ret = CVI_VENC_CreateChn(m_vencChn, &stVencChnAttr);
     if (s32Ret != CVI_SUCCESS) {
-        std::cerr << TAG << ": CVI_VENC_CreateChn failed with " << s32Ret << std::endl;
+        LOGE(TAG) << "CVI_VENC_CreateChn failed with " << s32Ret;
         return false;
     }
     
@@ -413,13 +500,13 @@ bool CviH264Streamer::initVenc() {
         stRcParam.u32ThrdP[1] = m_config.qpMax;  // Max P-frame QP threshold
         
         // Print the QP settings for debugging
-        std::cout << TAG << ": Setting QP parameters - Init: " << m_config.qpInit
-                  << ", Min: " << m_config.qpMin << ", Max: " << m_config.qpMax << std::endl;
+        LOGI(TAG) << "Setting QP parameters - Init: " << m_config.qpInit
+                  << ", Min: " << m_config.qpMin << ", Max: " << m_config.qpMax;
         
         // Apply RC parameters
         s32Ret = CVI_VENC_SetRcParam(m_vencChn, &stRcParam);
         if (s32Ret != CVI_SUCCESS) {
-            std::cerr << TAG << ": CVI_VENC_SetRcParam failed with " << s32Ret << std::endl;
+            LOGE(TAG) << "CVI_VENC_SetRcParam failed with " << s32Ret;
             // Non-fatal, continue
         }
     }
@@ -431,7 +518,7 @@ bool CviH264Streamer::initVenc() {
     
     s32Ret = CVI_VENC_StartRecvFrame(m_vencChn, &stRecvParam);
     if (s32Ret != CVI_SUCCESS) {
-        std::cerr << TAG << ": CVI_VENC_StartRecvFrame failed with " << s32Ret << std::endl;
+        LOGE(TAG) << "CVI_VENC_StartRecvFrame failed with " << s32Ret;
         CVI_VENC_DestroyChn(m_vencChn);
         m_vencChn = -1;
         return false;
@@ -442,29 +529,29 @@ bool CviH264Streamer::initVenc() {
     memset(&stActualAttr, 0, sizeof(VENC_CHN_ATTR_S));
     s32Ret = CVI_VENC_GetChnAttr(m_vencChn, &stActualAttr);
     if (s32Ret == CVI_SUCCESS) {
-        std::cout << TAG << ": Encoder settings verification:" << std::endl;
-        std::cout << TAG << ":   - Actual RC mode: " << stActualAttr.stRcAttr.enRcMode << std::endl;
+        LOGI(TAG) << "Encoder settings verification:";
+        LOGI(TAG) << "  - Actual RC mode: " << stActualAttr.stRcAttr.enRcMode;
         
         switch (stActualAttr.stRcAttr.enRcMode) {
             case VENC_RC_MODE_H264FIXQP:
-                std::cout << TAG << ":   - FIXQP: I=" << stActualAttr.stRcAttr.stH264FixQp.u32IQp
-                          << ", P=" << stActualAttr.stRcAttr.stH264FixQp.u32PQp << std::endl;
+                LOGI(TAG) << "  - FIXQP: I=" << stActualAttr.stRcAttr.stH264FixQp.u32IQp
+                          << ", P=" << stActualAttr.stRcAttr.stH264FixQp.u32PQp;
                 break;
             case VENC_RC_MODE_H264CBR:
-                std::cout << TAG << ":   - CBR bitrate: " << stActualAttr.stRcAttr.stH264Cbr.u32BitRate << " Kbps" << std::endl;
+                LOGI(TAG) << "  - CBR bitrate: " << stActualAttr.stRcAttr.stH264Cbr.u32BitRate << " Kbps";
                 break;
             case VENC_RC_MODE_H264VBR:
-                std::cout << TAG << ":   - VBR max bitrate: " << stActualAttr.stRcAttr.stH264Vbr.u32MaxBitRate << " Kbps" << std::endl;
+                LOGI(TAG) << "  - VBR max bitrate: " << stActualAttr.stRcAttr.stH264Vbr.u32MaxBitRate << " Kbps";
                 break;
             case VENC_RC_MODE_H264AVBR:
-                std::cout << TAG << ":   - AVBR max bitrate: " << stActualAttr.stRcAttr.stH264AVbr.u32MaxBitRate << " Kbps" << std::endl;
+                LOGI(TAG) << "  - AVBR max bitrate: " << stActualAttr.stRcAttr.stH264AVbr.u32MaxBitRate << " Kbps";
                 break;
             default:
-                std::cout << TAG << ":   - Unknown RC mode!" << std::endl;
+                LOGI(TAG) << "  - Unknown RC mode!";
         }
     }
     
-    std::cout << TAG << ": H264 encoder initialized on channel " << m_vencChn << std::endl;
+    LOGI(TAG) << "H264 encoder initialized on channel " << m_vencChn;
     return true;
 }
 
@@ -487,7 +574,7 @@ bool CviH264Streamer::initRtsp() {
     
     s32Ret = CVI_RTSP_Create(&m_rtspCtx.pstServerCtx, &config);
     if (s32Ret != CVI_SUCCESS) {
-        std::cerr << TAG << ": CVI_RTSP_Create failed with " << s32Ret << std::endl;
+        LOGE(TAG) << "CVI_RTSP_Create failed with " << s32Ret;
         return false;
     }
     
@@ -501,7 +588,7 @@ bool CviH264Streamer::initRtsp() {
     // Start RTSP server
     s32Ret = CVI_RTSP_Start(m_rtspCtx.pstServerCtx);
     if (s32Ret != CVI_SUCCESS) {
-        std::cerr << TAG << ": CVI_RTSP_Start failed with " << s32Ret << std::endl;
+        LOGE(TAG) << "CVI_RTSP_Start failed with " << s32Ret;
         CVI_RTSP_Destroy(&m_rtspCtx.pstServerCtx);
         pthread_mutex_destroy(&m_rtspCtx.mutex);
         return false;
@@ -523,7 +610,7 @@ bool CviH264Streamer::initRtsp() {
                                     &m_rtspCtx.pstSession[0]);
     if (s32Ret != CVI_SUCCESS || m_rtspCtx.pstSession[0] == NULL) {
         pthread_mutex_unlock(&m_rtspCtx.mutex);
-        std::cerr << TAG << ": CVI_RTSP_CreateSession failed with " << s32Ret << std::endl;
+        LOGE(TAG) << "CVI_RTSP_CreateSession failed with " << s32Ret;
         CVI_RTSP_Stop(m_rtspCtx.pstServerCtx);
         CVI_RTSP_Destroy(&m_rtspCtx.pstServerCtx);
         pthread_mutex_destroy(&m_rtspCtx.mutex);
@@ -538,8 +625,8 @@ bool CviH264Streamer::initRtsp() {
         CviH264Streamer *pThis = static_cast<CviH264Streamer*>(arg);
         if (pThis) {
             pThis->m_clientCount++;
-            std::cout << TAG << ": RTSP client connected from " << ip 
-                      << " (total: " << pThis->m_clientCount.load() << ")" << std::endl;
+            LOGI(TAG) << "RTSP client connected from " << ip 
+                      << " (total: " << pThis->m_clientCount.load() << ")";
             
             pThis->forceIFrame();
         }
@@ -550,8 +637,8 @@ bool CviH264Streamer::initRtsp() {
         CviH264Streamer *pThis = static_cast<CviH264Streamer*>(arg);
         if (pThis && pThis->m_clientCount.load() > 0) {
             pThis->m_clientCount--;
-            std::cout << TAG << ": RTSP client disconnected: " << ip 
-                      << " (remaining: " << pThis->m_clientCount.load() << ")" << std::endl;
+            LOGI(TAG) << "RTSP client disconnected: " << ip 
+                      << " (remaining: " << pThis->m_clientCount.load() << ")";
         }
     };
     m_rtspCtx.listener.argDisconn = this;
@@ -561,7 +648,7 @@ bool CviH264Streamer::initRtsp() {
     
     pthread_mutex_unlock(&m_rtspCtx.mutex);
     
-    std::cout << TAG << ": RTSP server initialized on port " << m_config.port << std::endl;
+    LOGI(TAG) << "RTSP server initialized on port " << m_config.port;
     
     return true;
 }
@@ -569,15 +656,12 @@ bool CviH264Streamer::initRtsp() {
 // Create YUV frame from OpenCV image
 bool CviH264Streamer::createYuvFrame(const cv::Mat& frame, VIDEO_FRAME_INFO_S* pstFrame) {
     if (!pstFrame) {
-        std::cerr << TAG << ": Invalid frame pointer" << std::endl;
+        LOGE(TAG) << "Invalid frame pointer";
         return false;
     }
     
     // Use static buffers to avoid repeated memory allocations
     static cv::Mat processedFrame;
-    static cv::Mat yuv;
-    static bool yuvNeedsInit = true;
-    static uint64_t lastFrameSize = 0;
     
     // Get a reference to the input frame with proper dimensions
     const cv::Mat& frameToProcess = (frame.cols == m_config.width && frame.rows == m_config.height) 
@@ -591,14 +675,6 @@ bool CviH264Streamer::createYuvFrame(const cv::Mat& frame, VIDEO_FRAME_INFO_S* p
             return processedFrame;
         }();
     
-    // Initialize or resize YUV buffer if needed
-    uint64_t currentFrameSize = m_config.width * m_config.height * 3 / 2;
-    if (yuvNeedsInit || yuv.empty() || lastFrameSize != currentFrameSize) {
-        yuv.create(m_config.height*3/2, m_config.width, CV_8UC1);
-        yuvNeedsInit = false;
-        lastFrameSize = currentFrameSize;
-    }
-    
     // Calculate required size for YUV frame with proper padding
     CVI_U32 y_size = m_config.width * m_config.height;
     CVI_U32 uv_size = y_size / 2;  // For YUV420
@@ -614,11 +690,11 @@ bool CviH264Streamer::createYuvFrame(const cv::Mat& frame, VIDEO_FRAME_INFO_S* p
         usleep(1000);  // Reduced from 5ms to 1ms
         VbBlk = CVI_VB_GetBlock(VB_INVALID_POOLID, u32Size);
         if (VbBlk == VB_INVALID_HANDLE) {
-            std::cerr << TAG << ": Failed to get VB block of size " << u32Size << ", retrying..." << std::endl;
+            LOGW(TAG) << "Failed to get VB block of size " << u32Size << ", retrying...";
             usleep(5000);  // Wait longer on second retry
             VbBlk = CVI_VB_GetBlock(VB_INVALID_POOLID, u32Size);
             if (VbBlk == VB_INVALID_HANDLE) {
-                std::cerr << TAG << ": Failed to get VB block after retries" << std::endl;
+                LOGE(TAG) << "Failed to get VB block after retries";
                 return false;
             }
         }
@@ -627,27 +703,26 @@ bool CviH264Streamer::createYuvFrame(const cv::Mat& frame, VIDEO_FRAME_INFO_S* p
     // Get physical address of the block
     CVI_U64 u64PhyAddr = CVI_VB_Handle2PhysAddr(VbBlk);
     if (u64PhyAddr == 0) {
-        std::cerr << TAG << ": Failed to get physical address" << std::endl;
+        LOGE(TAG) << "Failed to get physical address";
         CVI_VB_ReleaseBlock(VbBlk);
         return false;
     }
     
-    // Get virtual address for CPU access
-    CVI_VOID *pVirAddr = CVI_SYS_Mmap(u64PhyAddr, u32Size);
+    // Get virtual address for CPU access. The pool blocks stay mapped
+    // between frames.
+    CVI_VOID *pVirAddr = VbMappingCache::instance().map(u64PhyAddr, u32Size);
     if (pVirAddr == NULL) {
-        std::cerr << TAG << ": Failed to get virtual address" << std::endl;
+        LOGE(TAG) << "Failed to get virtual address";
         CVI_VB_ReleaseBlock(VbBlk);
         return false;
     }
     
     // Convert BGR to YUV I420 with optimized approach based on channels
     if (frameToProcess.channels() == 3) {
-        // Fast BGR to YUV I420 conversion directly to our buffer
+        // BGR to YUV I420 conversion written straight into the block
         // This is the most common case, so optimize it first
+        cv::Mat yuv(m_config.height * 3 / 2, m_config.width, CV_8UC1, pVirAddr);
         cv::cvtColor(frameToProcess, yuv, cv::COLOR_BGR2YUV_I420);
-        
-        // Copy YUV data directly to mapped memory
-        memcpy(pVirAddr, yuv.data, yuv.total());
     } else if (frameToProcess.channels() == 1) {
         // Grayscale optimization - directly copy Y plane and fill U/V
         unsigned char* virY = (unsigned char*)pVirAddr;
@@ -661,11 +736,13 @@ bool CviH264Streamer::createYuvFrame(const cv::Mat& frame, VIDEO_FRAME_INFO_S* p
         memset(virU, 128, y_size/4);
         memset(virV, 128, y_size/4);
     } else {
-        std::cerr << TAG << ": Unsupported image format: " << frameToProcess.channels() << " channels" << std::endl;
-        CVI_SYS_Munmap(pVirAddr, u32Size);
+        LOGE(TAG) << "Unsupported image format: " << frameToProcess.channels() << " channels";
         CVI_VB_ReleaseBlock(VbBlk);
         return false;
     }
+
+    // The mapping is cached: write the pixels back before VENC reads them
+    VbMappingCache::instance().flush(u64PhyAddr, pVirAddr, y_size + uv_size);
     
     // Initialize frame info structure
     memset(pstFrame, 0, sizeof(VIDEO_FRAME_INFO_S));
@@ -690,9 +767,6 @@ bool CviH264Streamer::createYuvFrame(const cv::Mat& frame, VIDEO_FRAME_INFO_S* p
     // Save the VB block handle for later release
     pstFrame->stVFrame.pPrivateData = (void*)(uintptr_t)VbBlk;
     
-    // Unmap the buffer as we're done with CPU access
-    CVI_SYS_Munmap(pVirAddr, u32Size);
-    
     return true;
 }
 
@@ -736,12 +810,13 @@ bool CviH264Streamer::sendEncodedDataToRtsp(VENC_STREAM_S* pstStream) {
         // Debug log for I-frames
         if (pPack->DataType.enH264EType == H264E_NALU_IDRSLICE) {
             isIFrame = true;
-            std::cout << TAG << ": Sending I-frame, size: " << rtspData.dataLen[i] << " bytes. Frame count: " << m_frameCount.load() << std::endl;
+            LOGD(TAG) << "Sending I-frame, size: " << rtspData.dataLen[i] << " bytes. Frame count: " << m_frameCount.load();
             // Update last I-frame time
             m_lastIFrameTime = getCurrentTimeMs();
             
             // Update global I-frame count
             m_totalIFrames++;
+            metrics().iFrames.add();
             iFramesSinceLastCheck++;
         }
     }
@@ -751,6 +826,8 @@ bool CviH264Streamer::sendEncodedDataToRtsp(VENC_STREAM_S* pstStream) {
     framesSinceLastCheck++;
     m_totalBytes += packetSize;
     m_totalFrames++;
+    metrics().bytes.add(packetSize);
+    metrics().frames.add();
     
     // Report bitrate every REPORT_BITRATE_INTERVAL_MS
     if (lastBitrateCheck == 0 || (currentTime - lastBitrateCheck) >= REPORT_BITRATE_INTERVAL_MS) {
@@ -762,9 +839,11 @@ bool CviH264Streamer::sendEncodedDataToRtsp(VENC_STREAM_S* pstStream) {
             VENC_CHN_STATUS_S stStat;
             CVI_S32 s32Ret = CVI_VENC_QueryStatus(m_vencChn, &stStat);
             
-            std::cout << TAG << ": STATS - Actual bitrate: " << std::fixed << std::setprecision(2) 
-                      << (bitrate / 1000000.0) << " Mbps, Frame size avg: " 
-                      << (totalBytes / framesSinceLastCheck) << " bytes";
+            // One line, built piece by piece
+            LogLine stats(LogLevel::INFO, TAG);
+            stats.stream() << "STATS - Actual bitrate: " << std::fixed << std::setprecision(2) 
+                           << (bitrate / 1000000.0) << " Mbps, Frame size avg: " 
+                           << (totalBytes / framesSinceLastCheck) << " bytes";
                       
             if (s32Ret == CVI_SUCCESS) {
                 /*
@@ -787,12 +866,11 @@ bool CviH264Streamer::sendEncodedDataToRtsp(VENC_STREAM_S* pstStream) {
                 } VENC_STREAM_INFO_S;
                 */
 
-                std::cout << ", Avg QP: " << stStat.stVencStrmInfo.u32MeanQp
-                          << ", Start QP: " << stStat.stVencStrmInfo.u32StartQp;
+                stats.stream() << ", Avg QP: " << stStat.stVencStrmInfo.u32MeanQp
+                               << ", Start QP: " << stStat.stVencStrmInfo.u32StartQp;
             }
             
-            std::cout << ", I-frames: " << iFramesSinceLastCheck
-                      << std::endl;
+            stats.stream() << ", I-frames: " << iFramesSinceLastCheck;
         }
         
         // Reset counters
@@ -803,25 +881,32 @@ bool CviH264Streamer::sendEncodedDataToRtsp(VENC_STREAM_S* pstStream) {
     }
     
     // Lock RTSP context for thread safety
-    pthread_mutex_lock(&m_rtspCtx.mutex);
+    {
+        TRACE_SCOPE("rtsp.lock");
+        pthread_mutex_lock(&m_rtspCtx.mutex);
+    }
     
     bool success = false;
     
     // Check if session is active
     if (m_rtspCtx.bStart[0] && m_rtspCtx.pstServerCtx && m_rtspCtx.pstSession[0]) {
         // Write the frame to the RTSP session
+        const uint64_t writeStart = MetricsRegistry::nowUs();
+        TRACE_SCOPE("rtsp.write");
         CVI_S32 s32Ret = CVI_RTSP_WriteFrame(m_rtspCtx.pstServerCtx, 
                                              m_rtspCtx.pstSession[0]->video, 
                                              &rtspData);
+        metrics().rtspWrite.record(MetricsRegistry::nowUs() - writeStart);
         
         if (s32Ret != CVI_SUCCESS) {
-            std::cerr << TAG << ": CVI_RTSP_WriteFrame failed with " << s32Ret << std::endl;
+            LOGE(TAG) << "CVI_RTSP_WriteFrame failed with " << s32Ret;
             m_errorCount++;
+            metrics().errors.add();
         } else {
             success = true;
         }
     } else {
-        std::cerr << TAG << ": RTSP session not ready" << std::endl;
+        LOGE(TAG) << "RTSP session not ready";
     }
     
     pthread_mutex_unlock(&m_rtspCtx.mutex);
@@ -831,7 +916,8 @@ bool CviH264Streamer::sendEncodedDataToRtsp(VENC_STREAM_S* pstStream) {
 
 // Thread function for encoding frames
 void CviH264Streamer::encodingThreadFunc() {
-    std::cout << TAG << ": Encoding thread started" << std::endl;
+    LOGI(TAG) << "Encoding thread started";
+    TRACE_THREAD_NAME("encoder");
     
     // For adaptive processing - removed frame skipping logic
     int queueSizeHighWatermark = 0;
@@ -843,6 +929,7 @@ void CviH264Streamer::encodingThreadFunc() {
         
         // Get frame from queue if available
         {
+            TRACE_SCOPE("encoder.dequeue");
             std::unique_lock<std::mutex> lock(m_frameMutex);
             
             // Wait for a frame or until shutdown with shorter timeout when busy
@@ -858,14 +945,15 @@ void CviH264Streamer::encodingThreadFunc() {
                 queueSizeHighWatermark = queueSize;
                 // Only log when we reach new high watermarks
                 if (queueSize > m_maxQueueSize / 2) {
-                    std::cout << TAG << ": Queue size high watermark: " << queueSize 
-                              << " / " << m_maxQueueSize << std::endl;
+                    LOGI(TAG) << "Queue size high watermark: " << queueSize 
+                              << " / " << m_maxQueueSize;
                 }
             }
             
             if (!m_frameQueue.empty()) {
                 // Use move semantics to avoid copying the frame data
-                frame = std::move(m_frameQueue.front());
+                frame = std::move(m_frameQueue.front().image);
+                TRACE_SET_FRAME(m_frameQueue.front().traceFrame);
                 m_frameQueue.pop();
                 hasFrame = true;
                 
@@ -880,13 +968,14 @@ void CviH264Streamer::encodingThreadFunc() {
         // Process the frame if we got one
         if (hasFrame) {
             // Process the frame - no clone needed since we moved it from the queue
+            TRACE_SCOPE("encoder.frame");
             if (!processFrame(frame)) {
-                std::cerr << TAG << ": Failed to process frame" << std::endl;
+                LOGE(TAG) << "Failed to process frame";
             }
         }
     }
     
-    std::cout << TAG << ": Encoding thread stopped" << std::endl;
+    LOGI(TAG) << "Encoding thread stopped";
 }
 
 // Send a frame to be encoded and streamed (now non-blocking)
@@ -897,12 +986,13 @@ bool CviH264Streamer::sendFrame(const cv::Mat& frame, bool blocking) {
     
     // Check for valid frame
     if (frame.empty()) {
-        std::cerr << TAG << ": Empty frame received" << std::endl;
+        LOGE(TAG) << "Empty frame received";
         return false;
     }
     
     // Add frame to the encoding queue
     {
+        TRACE_SCOPE("encoder.enqueue");
         std::unique_lock<std::mutex> lock(m_frameMutex);
         
         // If queue is full and blocking mode is enabled, wait for space
@@ -911,7 +1001,7 @@ bool CviH264Streamer::sendFrame(const cv::Mat& frame, bool blocking) {
             static uint64_t lastLogTime = 0;
             uint64_t currentTime = getCurrentTimeMs();
             if (currentTime - lastLogTime > 5000) { // Log at most every 5 seconds
-                std::cout << TAG << ": Queue full, waiting for space..." << std::endl;
+                LOGW(TAG) << "Queue full, waiting for space...";
                 lastLogTime = currentTime;
             }
             
@@ -927,7 +1017,7 @@ bool CviH264Streamer::sendFrame(const cv::Mat& frame, bool blocking) {
             
             // Check if timeout occurred
             if (!waitResult) {
-                std::cerr << TAG << ": Timeout waiting for queue space" << std::endl;
+                LOGW(TAG) << "Timeout waiting for queue space";
                 return false;
             }
         }
@@ -936,6 +1026,7 @@ bool CviH264Streamer::sendFrame(const cv::Mat& frame, bool blocking) {
             m_frameQueue.pop();
             // Count this as an error
             m_errorCount++;
+            metrics().droppedFrames.add();
             
             // Log frame drops only occasionally
             static uint64_t lastDropLogTime = 0;
@@ -944,15 +1035,15 @@ bool CviH264Streamer::sendFrame(const cv::Mat& frame, bool blocking) {
             
             uint64_t currentTime = getCurrentTimeMs();
             if (currentTime - lastDropLogTime > 5000) { // Log at most every 5 seconds
-                std::cerr << TAG << ": Dropped " << dropCount << " frames in the last 5 seconds. Queue size: " 
-                          << m_frameQueue.size() << std::endl;
+                LOGW(TAG) << "Dropped " << dropCount << " frames in the last 5 seconds. Queue size: " 
+                          << m_frameQueue.size();
                 lastDropLogTime = currentTime;
                 dropCount = 0;
             }
         }
         
         // Add the new frame without cloning
-        m_frameQueue.push(frame);  // No need to clone since OpenCV's Mat uses reference counting
+        m_frameQueue.push({frame, Tracer::currentFrame()});  // No need to clone since OpenCV's Mat uses reference counting
     }
     
     // Signal the encoding thread
@@ -985,27 +1076,41 @@ bool CviH264Streamer::processFrame(const cv::Mat& frame) {
             }
             
             forceIFrameNow = true;
-            std::cout << TAG << ": Forcing I-frame... Frame count: " << frameNum << std::endl;
+            LOGD(TAG) << "Forcing I-frame... Frame count: " << frameNum;
             forceIFrame();
             m_lastIFrameTime = currentTime;
         }
         
         // Create a YUV frame from the input OpenCV image
         VIDEO_FRAME_INFO_S stFrame;
-        if (!createYuvFrame(frame, &stFrame)) {
-            std::cerr << TAG << ": Failed to create YUV frame" << std::endl;
+        const uint64_t conversionStart = MetricsRegistry::nowUs();
+        bool converted;
+        {
+            TRACE_SCOPE("encoder.yuv_conversion");
+            converted = createYuvFrame(frame, &stFrame);
+        }
+        if (!converted) {
+            LOGE(TAG) << "Failed to create YUV frame";
+            metrics().errors.add();
             return false;
         }
+        const uint64_t encodeStart = MetricsRegistry::nowUs();
+        metrics().yuvConversion.record(encodeStart - conversionStart);
         
         // Send the frame to the encoder with a shorter timeout
-        CVI_S32 s32Ret = CVI_VENC_SendFrame(m_vencChn, &stFrame, 500);  // 500ms timeout (reduced from 1000ms)
+        CVI_S32 s32Ret;
+        {
+            TRACE_SCOPE("encoder.send_frame");
+            s32Ret = CVI_VENC_SendFrame(m_vencChn, &stFrame, 500);  // 500ms timeout (reduced from 1000ms)
+        }
         if (s32Ret != CVI_SUCCESS) {
             // Only log errors occasionally
             if (frameNum % 20 == 0) {
-                std::cerr << TAG << ": CVI_VENC_SendFrame failed with " << s32Ret << std::endl;
+                LOGE(TAG) << "CVI_VENC_SendFrame failed with " << s32Ret;
             }
             // Always release VB block
             CVI_VB_ReleaseBlock((VB_BLK)(uintptr_t)stFrame.stVFrame.pPrivateData);
+            metrics().errors.add();
             return false;
         }
         
@@ -1018,7 +1123,7 @@ bool CviH264Streamer::processFrame(const cv::Mat& frame) {
         if (s32Ret != CVI_SUCCESS) {
             // Only log errors occasionally
             if (frameNum % 20 == 0) {
-                std::cerr << TAG << ": CVI_VENC_QueryStatus failed with " << s32Ret << std::endl;
+                LOGE(TAG) << "CVI_VENC_QueryStatus failed with " << s32Ret;
             }
             return false;
         }
@@ -1043,23 +1148,28 @@ bool CviH264Streamer::processFrame(const cv::Mat& frame) {
             // Use heap for larger packet counts
             stStream.pstPack = (VENC_PACK_S *)malloc(sizeof(VENC_PACK_S) * stStat.u32CurPacks);
             if (stStream.pstPack == NULL) {
-                std::cerr << TAG << ": Failed to allocate memory for stream packs" << std::endl;
+                LOGE(TAG) << "Failed to allocate memory for stream packs";
                 return false;
             }
         }
         
         // Get the encoded stream with shorter timeout
-        s32Ret = CVI_VENC_GetStream(m_vencChn, &stStream, 300);  // 300ms timeout (reduced from 1000ms)
+        {
+            TRACE_SCOPE("encoder.get_stream");
+            s32Ret = CVI_VENC_GetStream(m_vencChn, &stStream, 300);  // 300ms timeout (reduced from 1000ms)
+        }
         if (s32Ret != CVI_SUCCESS) {
             // Only log errors occasionally
             if (frameNum % 20 == 0) {
-                std::cerr << TAG << ": CVI_VENC_GetStream failed with " << s32Ret << std::endl;
+                LOGE(TAG) << "CVI_VENC_GetStream failed with " << s32Ret;
             }
             if (stStat.u32CurPacks > MAX_STACK_PACKS) {
                 free(stStream.pstPack);
             }
+            metrics().errors.add();
             return false;
         }
+        metrics().encode.record(MetricsRegistry::nowUs() - encodeStart);
         
         // Send the encoded stream to RTSP clients
         bool result = sendEncodedDataToRtsp(&stStream);
@@ -1067,7 +1177,7 @@ bool CviH264Streamer::processFrame(const cv::Mat& frame) {
         // Release the stream
         s32Ret = CVI_VENC_ReleaseStream(m_vencChn, &stStream);
         if (s32Ret != CVI_SUCCESS && frameNum % 20 == 0) {
-            std::cerr << TAG << ": CVI_VENC_ReleaseStream failed with " << s32Ret << std::endl;
+            LOGE(TAG) << "CVI_VENC_ReleaseStream failed with " << s32Ret;
             // Non-fatal, continue
         }
         
@@ -1078,7 +1188,7 @@ bool CviH264Streamer::processFrame(const cv::Mat& frame) {
         
         return result;
     } catch (const std::exception& e) {
-        std::cerr << TAG << ": Exception in processFrame: " << e.what() << std::endl;
+        LOGE(TAG) << "Exception in processFrame: " << e.what();
         return false;
     }
 }
@@ -1089,7 +1199,7 @@ void CviH264Streamer::cleanup() {
         return;  // Already cleaned up
     }
     
-    std::cout << TAG << ": Cleaning up resources..." << std::endl;
+    LOGI(TAG) << "Cleaning up resources...";
     
     // Set running flag to false first to stop ongoing operations
     m_running.store(false);
@@ -1115,7 +1225,7 @@ void CviH264Streamer::cleanup() {
         // Stop server first
         CVI_S32 s32Ret = CVI_RTSP_Stop(m_rtspCtx.pstServerCtx);
         if (s32Ret != CVI_SUCCESS) {
-            std::cerr << TAG << ": CVI_RTSP_Stop failed with " << s32Ret << std::endl;
+            LOGE(TAG) << "CVI_RTSP_Stop failed with " << s32Ret;
         }
         
         // Destroy sessions
@@ -1124,7 +1234,7 @@ void CviH264Streamer::cleanup() {
             if (m_rtspCtx.bStart[i] && m_rtspCtx.pstSession[i]) {
                 s32Ret = CVI_RTSP_DestroySession(m_rtspCtx.pstServerCtx, m_rtspCtx.pstSession[i]);
                 if (s32Ret != CVI_SUCCESS) {
-                    std::cerr << TAG << ": CVI_RTSP_DestroySession failed with " << s32Ret << std::endl;
+                    LOGE(TAG) << "CVI_RTSP_DestroySession failed with " << s32Ret;
                 }
                 m_rtspCtx.bStart[i] = CVI_FALSE;
                 m_rtspCtx.pstSession[i] = NULL;
@@ -1135,7 +1245,7 @@ void CviH264Streamer::cleanup() {
         // Destroy server
         s32Ret = CVI_RTSP_Destroy(&m_rtspCtx.pstServerCtx);
         if (s32Ret != CVI_SUCCESS) {
-            std::cerr << TAG << ": CVI_RTSP_Destroy failed with " << s32Ret << std::endl;
+            LOGE(TAG) << "CVI_RTSP_Destroy failed with " << s32Ret;
         }
         
         // Destroy mutex
@@ -1147,7 +1257,7 @@ void CviH264Streamer::cleanup() {
         // Stop receiving frames
         CVI_S32 s32Ret = CVI_VENC_StopRecvFrame(m_vencChn);
         if (s32Ret != CVI_SUCCESS) {
-            std::cerr << TAG << ": CVI_VENC_StopRecvFrame failed with " << s32Ret << std::endl;
+            LOGE(TAG) << "CVI_VENC_StopRecvFrame failed with " << s32Ret;
         }
         
         // Short delay to ensure any pending operations complete
@@ -1156,7 +1266,7 @@ void CviH264Streamer::cleanup() {
         // Destroy channel
         s32Ret = CVI_VENC_DestroyChn(m_vencChn);
         if (s32Ret != CVI_SUCCESS) {
-            std::cerr << TAG << ": CVI_VENC_DestroyChn failed with " << s32Ret << std::endl;
+            LOGE(TAG) << "CVI_VENC_DestroyChn failed with " << s32Ret;
         }
         
         m_vencChn = -1;
@@ -1172,12 +1282,12 @@ void CviH264Streamer::cleanup() {
     
     // Log statistics
     uint64_t totalTime = getCurrentTimeMs() - m_startTime;
-    std::cout << TAG << ": Cleanup completed. Statistics:" << std::endl;
-    std::cout << TAG << ":   - Total frames: " << m_frameCount.load() << std::endl;
-    std::cout << TAG << ":   - Errors: " << m_errorCount.load() << std::endl;
+    LOGI(TAG) << "Cleanup completed. Statistics:";
+    LOGI(TAG) << "  - Total frames: " << m_frameCount.load();
+    LOGI(TAG) << "  - Errors: " << m_errorCount.load();
     if (totalTime > 0 && m_frameCount.load() > 0) {
         double avgFps = (m_frameCount.load() * 1000.0) / totalTime;
-        std::cout << TAG << ":   - Average FPS: " << avgFps << std::endl;
+        LOGI(TAG) << "  - Average FPS: " << avgFps;
     }
 }
 
@@ -149,6 +149,18 @@ public:
      */
     void forceIFrame();
 
+    /**
+     * @brief Change the QP range of the running encoder
+     *
+     * Takes effect at the next encoded frame. In FIXQP mode, the fixed QPs
+     * are moved by the same amount as the minimum QP.
+     *
+     * @param qpMin Minimum QP value
+     * @param qpMax Maximum QP value
+     * @return true if the encoder accepted the range
+     */
+    bool setQpRange(int qpMin, int qpMax);
+
 private:
     // Disable copy constructor and assignment operator
     CviH264Streamer(const CviH264Streamer&) = delete;
@@ -233,7 +245,12 @@ private:
     std::thread m_encodingThread;
     std::mutex m_frameMutex;
     std::condition_variable m_frameCondition;
-    std::queue<cv::Mat> m_frameQueue;
+    // Queued frame and the trace id of the frame, picked up by the encoding thread
+    struct QueuedFrame {
+        cv::Mat image;
+        uint64_t traceFrame;
+    };
+    std::queue<QueuedFrame> m_frameQueue;
     size_t m_maxQueueSize;
     bool m_threadRunning;
     
@@ -39,6 +39,31 @@
 #include "app_ipcam_ll.h"
 #include "app_ipcam_comm.h"
 
+#include "../common/logger.h"
+#include "../common/metrics.h"
+#include "../common/tracer.h"
+#include "vb_mapping_cache.h"
+
+// Level of the project logger matching a level of the SDK logs
+static LogLevel appLogLevel(int level) {
+    if (level == LEVEL_ERROR) {
+        return LogLevel::ERROR;
+    }
+    if (level == LEVEL_WARN) {
+        return LogLevel::WARN;
+    }
+    if (level == LEVEL_INFO) {
+        return LogLevel::INFO;
+    }
+    return LogLevel::DEBUG;
+}
+
+#define TAG "cvi_system"
+
+// The SDK logs go through the project logger instead of printf
+#undef APP_PROF_LOG_PRINT
+#define APP_PROF_LOG_PRINT(level, ...) LOG_FMT(appLogLevel(level), TAG, __VA_ARGS__)
+
 
 // app_ipcam_comm.c
 
@@ -226,10 +251,12 @@ static void *Thread_LList_Data_Consume(void *pArgs)
 
     sprintf(TaskName, "DataConsume");
     prctl(PR_SET_NAME, TaskName, 0, 0, 0);
+    TRACE_THREAD_NAME(TaskName);
     while(pstDataCtx->bRunStatus) {
         if(app_ipcam_LList_Data_Pop(&pData, pArgs) == 0) {
             if(pData != NULL) {
                 if(pstDataParam->fpDataHandle) {
+                    TRACE_SCOPE("venc.consume");
                     pstDataParam->fpDataHandle(pData, pArgs);
                 }
                 if(pstDataParam->fpDataFree) {
@@ -4041,6 +4068,7 @@ static void* Thread_Streaming_Proc(void* pArgs)
     CVI_CHAR TaskName[64] = { '\0' };
     sprintf(TaskName, "Thread_Venc%d_Proc", VencChn);
     prctl(PR_SET_NAME, TaskName, 0, 0, 0);
+    TRACE_THREAD_NAME(TaskName);
     APP_PROF_LOG_PRINT(LEVEL_INFO, "Venc channel_%d start running\n", VencChn);
 
     pastVencChnCfg->bStart = CVI_TRUE;
@@ -4048,7 +4076,11 @@ static void* Thread_Streaming_Proc(void* pArgs)
         VIDEO_FRAME_INFO_S stVpssFrame = { 0 };
 
         if (pastVencChnCfg->enBindMode == VENC_BIND_DISABLE) {
-            if (CVI_VPSS_GetChnFrame(vpssGrp, vpssChn, &stVpssFrame, 3000) != CVI_SUCCESS) {
+            {
+                TRACE_SCOPE("venc.vpss_wait");
+                s32Ret = CVI_VPSS_GetChnFrame(vpssGrp, vpssChn, &stVpssFrame, 3000);
+            }
+            if (s32Ret != CVI_SUCCESS) {
                 continue;
             }
             APP_PROF_LOG_PRINT(LEVEL_DEBUG, "VencChn-%d Get Frame takes %u ms \n", VencChn, (GetCurTimeInMsec() - iTime));
@@ -4088,7 +4120,10 @@ static void* Thread_Streaming_Proc(void* pArgs)
         timeoutVal.tv_sec = 0;
         timeoutVal.tv_usec = 80 * 1000;
         iTime = GetCurTimeInMsec();
-        s32Ret = select(vencFd + 1, &readFds, NULL, NULL, &timeoutVal);
+        {
+            TRACE_SCOPE("venc.select");
+            s32Ret = select(vencFd + 1, &readFds, NULL, NULL, &timeoutVal);
+        }
         if (s32Ret < 0) {
             if (errno == EINTR)
                 continue;
@@ -4112,7 +4147,10 @@ static void* Thread_Streaming_Proc(void* pArgs)
         memset(&stExpInfo, 0, sizeof(stExpInfo));
         CVI_ISP_QueryExposureInfo(0, &stExpInfo);
         CVI_S32 timeout = (1000 * 2) / (stExpInfo.u32Fps / 100); // u32Fps = fps * 100
-        s32Ret = CVI_VENC_GetStream(VencChn, &stStream, timeout);
+        {
+            TRACE_SCOPE("venc.get_stream");
+            s32Ret = CVI_VENC_GetStream(VencChn, &stStream, timeout);
+        }
         if (pastVencChnCfg->enBindMode == VENC_BIND_DISABLE) {
             CVI_VPSS_ReleaseChnFrame(vpssGrp, vpssChn, &stVpssFrame);
         }
@@ -4127,6 +4165,7 @@ static void* Thread_Streaming_Proc(void* pArgs)
                 VencChn, stStream.pstPack[0].u32Len);
         } else {
             /* save streaming to LinkList and proc it in another thread */
+            TRACE_SCOPE("venc.push");
             s32Ret = app_ipcam_LList_Data_Push(&stStream, g_pDataCtx[VencChn]);
             if (s32Ret != CVI_SUCCESS) {
                 APP_PROF_LOG_PRINT(LEVEL_ERROR, "Venc %d streaming push linklist failed!\n", VencChn);
@@ -4536,6 +4575,8 @@ int initVideo(bool use_venc) {
 
 int deinitVideo(bool stop_venc) {
     if (is_started) {
+        // The VB blocks are about to be freed
+        VbMappingCache::instance().clear();
         // Skip venc deinitialization since we're not using it
         APP_CHK_RET(app_ipcam_Vpss_DeInit(), "Vpss DeInit");
         APP_CHK_RET(app_ipcam_Vi_DeInit(), "Vi DeInit");
@@ -4603,143 +4644,209 @@ int registerVideoFrameHandler(video_ch_index_t ch, int index, pfpDataConsumes ha
 
 
 
-static bool convert_to_opencv_mat(VIDEO_FRAME_INFO_S* VpssFrame, cv::Mat &outputImage) {
-    //std::cout << "convert_to_opencv_mat" << std::endl;
-
-    VIDEO_FRAME_S* f = &VpssFrame->stVFrame;
-
-    // Print debug info
-    //std::cout << "Frame info: " << f->u32Width << "x" << f->u32Height 
-    //          << ", Pixel format: " << f->enPixelFormat << std::endl;
-    //std::cout << "Frame plane lengths: " << f->u32Length[0] << ", " 
-    //          << f->u32Length[1] << ", " << f->u32Length[2] << std::endl;
+struct VpssFrame::Holder {
+    VPSS_GRP grp;
+    VPSS_CHN chn;
+    VIDEO_FRAME_INFO_S info;
+    bool held;
 
+    Holder(VPSS_GRP grp, VPSS_CHN chn) : grp(grp), chn(chn), held(false) {
+        memset(&info, 0, sizeof(info));
+        s_inFlight.fetch_add(1);
+    }
 
-    // Process frame based on its pixel format
-    bool success = false;
-    
-    // Map all planes of physical memory to virtual memory
-    for (uint32_t i = 0; i < 3; i++) {
-        if (f->u32Length[i]) {
-            f->pu8VirAddr[i] = (CVI_U8*)CVI_SYS_Mmap(f->u64PhyAddr[i], f->u32Length[i]);
-            if (!f->pu8VirAddr[i]) {
-                std::cerr << "Memory mapping failed for plane " << i << std::endl;
-                // Unmap any previously mapped planes
-                for (uint32_t j = 0; j < i; j++) {
-                    if (f->pu8VirAddr[j]) {
-                        CVI_SYS_Munmap(f->pu8VirAddr[j], f->u32Length[j]);
-                    }
+    ~Holder() {
+        // The planes stay mapped in the cache for the next use of the block
+        VIDEO_FRAME_S* f = &info.stVFrame;
+        for (uint32_t i = 0; i < 3; i++) {
+            f->pu8VirAddr[i] = NULL;
+        }
+        if (held) {
+            CVI_VPSS_ReleaseChnFrame(grp, chn, &info);
+        }
+        s_inFlight.fetch_sub(1);
+    }
+
+    // Map all planes of physical memory to virtual memory, and drop the
+    // CPU cache lines left by the previous frame in the same block
+    bool map() {
+        VIDEO_FRAME_S* f = &info.stVFrame;
+        VbMappingCache& cache = VbMappingCache::instance();
+        for (uint32_t i = 0; i < 3; i++) {
+            if (f->u32Length[i]) {
+                f->pu8VirAddr[i] = (CVI_U8*)cache.map(f->u64PhyAddr[i], f->u32Length[i]);
+                if (!f->pu8VirAddr[i]) {
+                    LOGE(TAG) << "Memory mapping failed for plane " << i;
+                    return false;
                 }
-                return false;
+                cache.invalidate(f->u64PhyAddr[i], f->pu8VirAddr[i], f->u32Length[i]);
             }
         }
+        return true;
+    }
+};
+
+std::atomic<int> VpssFrame::s_inFlight(0);
+
+bool VpssFrame::acquire(VPSS_GRP grp, VPSS_CHN chn, int timeout_ms, VpssFrame& frame) {
+    static MetricCounter& busy = MetricsRegistry::instance().counter("capture.vpss_busy");
+
+    frame.release();
+    if (s_inFlight.load() >= kMaxInFlight) {
+        // Taking one more block could leave VPSS without a buffer to write to
+        busy.add();
+        return false;
+    }
+
+    auto holder = std::make_shared<Holder>(grp, chn);
+    CVI_S32 s32Ret;
+    {
+        TRACE_SCOPE("capture.vpss_wait");
+        s32Ret = CVI_VPSS_GetChnFrame(grp, chn, &holder->info, timeout_ms);
+    }
+    if (s32Ret != CVI_SUCCESS) {
+        // Mostly the timeout, expected when the caller polls faster than the sensor
+        LOGD(TAG) << "No frame from VPSS group " << grp << " channel " << chn << " (0x" << std::hex << s32Ret << std::dec << ")";
+        return false;
+    }
+    holder->held = true;
+    if (!holder->map()) {
+        return false;
+    }
+    frame.m_holder = std::move(holder);
+    return true;
+}
+
+bool VpssFrame::empty() const {
+    return !m_holder;
+}
+
+int VpssFrame::width() const {
+    return m_holder ? static_cast<int>(m_holder->info.stVFrame.u32Width) : 0;
+}
+
+int VpssFrame::height() const {
+    return m_holder ? static_cast<int>(m_holder->info.stVFrame.u32Height) : 0;
+}
+
+PIXEL_FORMAT_E VpssFrame::pixelFormat() const {
+    return m_holder ? m_holder->info.stVFrame.enPixelFormat : PIXEL_FORMAT_MAX;
+}
+
+cv::Mat VpssFrame::plane(int index) const {
+    if (!m_holder || index < 0 || index > 2) {
+        return cv::Mat();
+    }
+    const VIDEO_FRAME_S* f = &m_holder->info.stVFrame;
+    if (!f->pu8VirAddr[index]) {
+        return cv::Mat();
     }
 
-    // Handle different pixel formats
+    const int width = static_cast<int>(f->u32Width);
+    const int height = static_cast<int>(f->u32Height);
+    const size_t stride = f->u32Stride[index];
     switch (f->enPixelFormat) {
-        case PIXEL_FORMAT_RGB_888: {
-            // Create OpenCV Mat for RGB data
-            cv::Mat rgbImage(f->u32Height, f->u32Width, CV_8UC3, f->pu8VirAddr[0]);
-            // Convert RGB to BGR (OpenCV uses BGR by default)
-            cv::cvtColor(rgbImage, outputImage, cv::COLOR_RGB2BGR);
-            success = true;
-            break;
-        }
-        case PIXEL_FORMAT_NV21: {
-            // For NV21 format (Y plane followed by interleaved VU plane)
-            cv::Mat yuvImg(f->u32Height * 3 / 2, f->u32Width, CV_8UC1);
-            
-            // Copy Y plane
-            if (f->u32Length[0] > 0 && f->pu8VirAddr[0]) {
-                memcpy(yuvImg.data, f->pu8VirAddr[0], f->u32Width * f->u32Height);
+        case PIXEL_FORMAT_RGB_888:
+            return index == 0 ? cv::Mat(height, width, CV_8UC3, f->pu8VirAddr[0], stride) : cv::Mat();
+        case PIXEL_FORMAT_NV21:
+            if (index == 0) {
+                return cv::Mat(height, width, CV_8UC1, f->pu8VirAddr[0], stride);
             }
-            
-            // Copy UV plane
-            if (f->u32Length[1] > 0 && f->pu8VirAddr[1]) {
-                memcpy(yuvImg.data + (f->u32Width * f->u32Height), 
-                       f->pu8VirAddr[1], f->u32Width * f->u32Height / 2);
+            return index == 1 ? cv::Mat(height / 2, width / 2, CV_8UC2, f->pu8VirAddr[1], stride) : cv::Mat();
+        case PIXEL_FORMAT_YUV_PLANAR_420:
+            if (index == 0) {
+                return cv::Mat(height, width, CV_8UC1, f->pu8VirAddr[0], stride);
             }
-            
-            // Convert NV21 to BGR
-            cv::cvtColor(yuvImg, outputImage, cv::COLOR_YUV2BGR_NV21);
-            success = true;
-            break;
-        }
-        case PIXEL_FORMAT_YUV_PLANAR_420: {
-            // For YUV420 planar format (three separate planes for Y, U, V)
-            cv::Mat yPlane(f->u32Height, f->u32Width, CV_8UC1, f->pu8VirAddr[0]);
-            cv::Mat uPlane(f->u32Height/2, f->u32Width/2, CV_8UC1, f->pu8VirAddr[1]);
-            cv::Mat vPlane(f->u32Height/2, f->u32Width/2, CV_8UC1, f->pu8VirAddr[2]);
-            
-            // Create and populate YUV planes vector
-            std::vector<cv::Mat> yuv;
-            yuv.push_back(yPlane);
-            
-            // Resize U and V planes to match Y plane size
-            cv::Mat uResized, vResized;
-            cv::resize(uPlane, uResized, yPlane.size());
-            cv::resize(vPlane, vResized, yPlane.size());
-            yuv.push_back(uResized);
-            yuv.push_back(vResized);
-            
-            // Convert YUV to BGR
-            cv::merge(yuv, outputImage);
-            cv::cvtColor(outputImage, outputImage, cv::COLOR_YUV2BGR);
-            success = true;
-            break;
-        }
-        case PIXEL_FORMAT_YUV_400: {
-            // Grayscale format (Y plane only)
-            cv::Mat yuvImage(f->u32Height, f->u32Width, CV_8UC1, f->pu8VirAddr[0]);
-            outputImage = yuvImage.clone();
-            success = true;
-            break;
-        }
+            return cv::Mat(height / 2, width / 2, CV_8UC1, f->pu8VirAddr[index], stride);
+        case PIXEL_FORMAT_YUV_400:
+            return index == 0 ? cv::Mat(height, width, CV_8UC1, f->pu8VirAddr[0], stride) : cv::Mat();
         default:
-            std::cerr << "Unsupported pixel format: " << f->enPixelFormat << std::endl;
-            success = false;
-            break;
+            return cv::Mat();
     }
+}
 
-    // Unmap all memory
-    for (uint32_t i = 0; i < 3; i++) {
-        if (f->pu8VirAddr[i]) {
-            CVI_SYS_Munmap(f->pu8VirAddr[i], f->u32Length[i]);
-            f->pu8VirAddr[i] = NULL;
+bool VpssFrame::toBgr(cv::Mat& bgr) const {
+    if (!m_holder) {
+        return false;
+    }
+
+    switch (pixelFormat()) {
+        case PIXEL_FORMAT_RGB_888:
+            // Convert RGB to BGR (OpenCV uses BGR by default)
+            cv::cvtColor(plane(0), bgr, cv::COLOR_RGB2BGR);
+            return true;
+        case PIXEL_FORMAT_NV21:
+            // Read the Y and VU planes where VPSS wrote them
+            cv::cvtColorTwoPlane(plane(0), plane(1), bgr, cv::COLOR_YUV2BGR_NV21);
+            return true;
+        case PIXEL_FORMAT_YUV_PLANAR_420: {
+            // Three separate planes: upsample U and V, then convert
+            cv::Mat yPlane = plane(0);
+            std::vector<cv::Mat> yuv(3);
+            yuv[0] = yPlane;
+            cv::resize(plane(1), yuv[1], yPlane.size());
+            cv::resize(plane(2), yuv[2], yPlane.size());
+            cv::merge(yuv, bgr);
+            cv::cvtColor(bgr, bgr, cv::COLOR_YUV2BGR);
+            return true;
         }
+        case PIXEL_FORMAT_YUV_400:
+            // Grayscale format (Y plane only)
+            plane(0).copyTo(bgr);
+            return true;
+        default:
+            LOGE(TAG) << "Unsupported pixel format: " << pixelFormat();
+            return false;
     }
+}
 
-    return success;
+void VpssFrame::release() {
+    m_holder.reset();
 }
 
+int VpssFrame::inFlight() {
+    return s_inFlight.load();
+}
 
-bool getVideoFrame(video_ch_index_t ch, cv::Mat &frame, int timeout_ms) {
+bool getVideoFrame(video_ch_index_t ch, VpssFrame& frame, int timeout_ms, uint64_t* acquiredUs) {
     // Define VPSS group and channel for frame capture
     VPSS_GRP VpssGrp = 0;  // Use first VPSS group
     VPSS_CHN VpssChn = 0;  // Use first VPSS channel
 
-    // Try to get a frame from VPSS with 1000ms timeout
-    VIDEO_FRAME_INFO_S stVideoFrame;
-    CVI_S32 s32Ret = CVI_VPSS_GetChnFrame(VpssGrp, VpssChn, &stVideoFrame, timeout_ms);
-    
-    if (s32Ret == CVI_SUCCESS) {
-        // Process and save the captured frame
-        bool success = convert_to_opencv_mat(&stVideoFrame, frame);
-        
-        // Release the frame back to the system
-        CVI_VPSS_ReleaseChnFrame(VpssGrp, VpssChn, &stVideoFrame);
-        
-        if (success) {
-            //std::cout << "Frame captured successfully" << std::endl;
-            return true;
-        } else {
-            std::cerr << "Failed to save frame" << std::endl;
-            return false;
-        }
-    } else {
-        std::cerr << "Failed to get frame" << std::endl;
+    if (!VpssFrame::acquire(VpssGrp, VpssChn, timeout_ms, frame)) {
+        return false;
+    }
+    if (acquiredUs) {
+        *acquiredUs = MetricsRegistry::nowUs();
+    }
+    return true;
+}
+
+bool getVideoFrame(video_ch_index_t ch, cv::Mat &frame, int timeout_ms, uint64_t* acquiredUs) {
+    static LatencyHistogram& conversionLatency = MetricsRegistry::instance().histogram("capture.conversion");
+
+    VpssFrame vpssFrame;
+    uint64_t acquired = 0;
+    if (!getVideoFrame(ch, vpssFrame, timeout_ms, &acquired)) {
         return false;
-    }  
+    }
+    if (acquiredUs) {
+        *acquiredUs = acquired;
+    }
+
+    // Convert, then give the frame back to VPSS right away
+    bool success;
+    {
+        TRACE_SCOPE("capture.conversion");
+        success = vpssFrame.toBgr(frame);
+    }
+    vpssFrame.release();
+    conversionLatency.record(MetricsRegistry::nowUs() - acquired);
+
+    if (!success) {
+        LOGE(TAG) << "Failed to save frame";
+    }
+    return success;
 }
 
 int cvi_system_setVbPool(video_ch_index_t ch, const video_ch_param_t* param, uint32_t u32BlkCnt) {
@@ -4751,5 +4858,6 @@ int cvi_system_Sys_Init(void) {
 }
 
 int cvi_system_Sys_DeInit(void) {
+    VbMappingCache::instance().clear();
     return app_ipcam_Sys_DeInit();
 }
@@ -7,7 +7,9 @@
 
 #define DEF_DEBUG_LEVEL            	LEVEL_INFO
 
+#include <atomic>
 #include <cstdint>
+#include <memory>
 
 #include <linux/cvi_comm_sys.h>
 #include <cvi_type.h>
@@ -51,7 +53,90 @@ int setupVideo(video_ch_index_t ch, const video_ch_param_t* param, bool setup_ve
 typedef int (*pfpDataConsumes)(void *pData, void *pCtx, void *pUserData);
 int registerVideoFrameHandler(video_ch_index_t ch, int index, pfpDataConsumes handler, void* pUserData);
 
-bool getVideoFrame(video_ch_index_t ch, cv::Mat &frame, int timeout_ms);
+/**
+ * @brief Frame held from a VPSS channel, read in place
+ *
+ * Wraps a frame taken with CVI_VPSS_GetChnFrame, with its planes mapped in
+ * user space through the VbMappingCache. Copies of a VpssFrame share the
+ * frame, which is given back to VPSS with CVI_VPSS_ReleaseChnFrame when the
+ * last copy is released or destroyed. The planes stay mapped for the next
+ * frame in the same block.
+ *
+ * The frames are blocks of the VB pool of the channel. At most
+ * kMaxInFlight of them are held at once: getVideoFrame() fails beyond that
+ * instead of taking the block VPSS needs for the next frame.
+ */
+class VpssFrame {
+public:
+    /// Frames held at once. The channel pools have 2 blocks (see setupVideo())
+    static constexpr int kMaxInFlight = 1;
+
+    VpssFrame() = default;
+
+    /**
+     * @brief Take the next frame of a VPSS channel
+     *
+     * @param grp VPSS group
+     * @param chn VPSS channel
+     * @param timeout_ms Longest wait for a frame
+     * @param frame Replaced with the new frame
+     * @return true if a frame was taken and mapped. false on timeout, or if
+     *         kMaxInFlight frames are already held
+     */
+    static bool acquire(VPSS_GRP grp, VPSS_CHN chn, int timeout_ms, VpssFrame& frame);
+
+    /**
+     * @brief Check if the handle holds a frame
+     */
+    bool empty() const;
+
+    int width() const;
+    int height() const;
+    PIXEL_FORMAT_E pixelFormat() const;
+
+    /**
+     * @brief View of a mapped plane, without copy
+     *
+     * For NV21, plane 0 is the Y plane (CV_8UC1) and plane 1 the interleaved
+     * VU plane at half resolution (CV_8UC2). The view is only valid while
+     * the frame is held.
+     *
+     * @param index Plane index
+     * @return cv::Mat View of the plane with its stride, empty if there is no such plane
+     */
+    cv::Mat plane(int index) const;
+
+    /**
+     * @brief Convert the frame to BGR in a single pass over the mapped planes
+     *
+     * @param bgr Output image, reallocated only if its size or type differs
+     * @return true if the pixel format is supported
+     */
+    bool toBgr(cv::Mat& bgr) const;
+
+    /**
+     * @brief Drop this reference to the frame
+     */
+    void release();
+
+    /**
+     * @brief Get the number of frames currently held
+     */
+    static int inFlight();
+
+private:
+    // Owns the VPSS frame
+    struct Holder;
+    std::shared_ptr<Holder> m_holder;
+    static std::atomic<int> s_inFlight;
+};
+
+// Take the next frame of the channel, without copying it.
+// acquiredUs (optional) receives the time the frame was taken from VPSS, in MetricsRegistry::nowUs() time
+bool getVideoFrame(video_ch_index_t ch, VpssFrame& frame, int timeout_ms, uint64_t* acquiredUs = nullptr);
+
+// Take the next frame of the channel, converted to BGR
+bool getVideoFrame(video_ch_index_t ch, cv::Mat &frame, int timeout_ms, uint64_t* acquiredUs = nullptr);
 
 
 int cvi_system_setVbPool(video_ch_index_t ch, const video_ch_param_t* param, uint32_t u32BlkCnt = 2);
@@ -1,11 +1,17 @@
 #include "frame_capturer.h"
-#include <iostream>
 #include <thread>
 #include <chrono>
 #include <cstring>
+#include <cerrno>
+#include <ctime>
 #include <signal.h>
 #include <unistd.h>
 #include <sys/time.h>
+#include "../common/logger.h"
+#include "../common/metrics.h"
+#include "../common/tracer.h"
+
+#define TAG "FrameCapturer"
 
 // Static pointer to the instance for signal handler
 static FrameCapturer* g_instance = nullptr;
@@ -25,10 +31,10 @@ FrameCapturer::FrameCapturer(int width, int height, int fps, video_ch_index_t vi
     , running_(false)
     , stop_requested_(false)
     , frame_callback_(nullptr)
-    , new_frame_available_(false)
-    , latest_timestamp_(0)
     , video_channel_(video_channel)
 {
+    sem_init(&frame_sem_, 0, 0);
+
     // Register as the global instance for signal handling
     g_instance = this;
 
@@ -53,24 +59,26 @@ FrameCapturer::~FrameCapturer() {
     if (g_instance == this) {
         g_instance = nullptr;
     }
+
+    sem_destroy(&frame_sem_);
 }
 
 // Initialize the camera and video pipeline
 bool FrameCapturer::initialize() {
     if (initialized_) {
-        std::cerr << "FrameCapturer is already initialized" << std::endl;
+        LOGE(TAG) << "Already initialized";
         return true;
     }
 
     // Initialize video system (without venc)
     if (initVideo(false) != 0) {
-        std::cerr << "Failed to initialize video system" << std::endl;
+        LOGE(TAG) << "Failed to initialize video system";
         return false;
     }
 
     // Setup video channel
     if (setupVideo(video_channel_, &video_params_, false) != 0) {
-        std::cerr << "Failed to setup video channel" << std::endl;
+        LOGE(TAG) << "Failed to setup video channel";
         return false;
     }
 
@@ -81,18 +89,18 @@ bool FrameCapturer::initialize() {
 // Start capturing frames
 bool FrameCapturer::start() {
     if (!initialized_) {
-        std::cerr << "FrameCapturer is not initialized" << std::endl;
+        LOGE(TAG) << "Not initialized";
         return false;
     }
 
     if (running_) {
-        std::cerr << "FrameCapturer is already running" << std::endl;
+        LOGE(TAG) << "Already running";
         return true;
     }
 
     // Start video pipeline
     if (startVideo(false) != 0) {
-        std::cerr << "Failed to start video pipeline" << std::endl;
+        LOGE(TAG) << "Failed to start video pipeline";
         return false;
     }
 
@@ -110,42 +118,102 @@ bool FrameCapturer::start() {
 
 // Frame capture thread function
 void FrameCapturer::captureThread() {
-    cv::Mat frame;
+    VpssFrame vpssFrame;
     struct timeval tv;
     uint64_t timestamp;
+    uint64_t acquiredUs = 0;
+    LatencyHistogram& conversionLatency = MetricsRegistry::instance().histogram("capture.conversion");
+    LatencyHistogram& toCallbackLatency = MetricsRegistry::instance().histogram("capture.to_callback");
+    LatencyHistogram& callbackLatency = MetricsRegistry::instance().histogram("capture.callback");
+    MetricCounter& capturedFrames = MetricsRegistry::instance().counter("capture.frames");
+    MetricCounter& droppedFrames = MetricsRegistry::instance().counter("capture.dropped");
+    uint64_t captured = 0;
+    uint64_t dropped = 0;
+
+    // One slot per frame, at absolute deadlines so that the time spent in
+    // the callback does not add up to the period
+    const std::chrono::steady_clock::duration period =
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::microseconds(1000000 / fps_));
+    const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point deadline = startTime;
     
     // Set thread priority
     struct sched_param param;
     param.sched_priority = 80;
     pthread_setschedparam(pthread_self(), SCHED_RR, &param);
+    TRACE_THREAD_NAME("capture");
     
     while (!stop_requested_) {
+        // Wait for the slot of the next frame. Late: the slots already passed
+        // are dropped and the frame is taken right away.
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (now < deadline) {
+            TRACE_SCOPE("capture.sleep");
+            std::this_thread::sleep_until(deadline);
+        } else {
+            const int64_t missed = (now - deadline) / period;
+            if (missed > 0) {
+                deadline += missed * period;
+                droppedFrames.add(missed);
+                dropped += missed;
+            }
+        }
+        deadline += period;
+
         // Get video frame with timeout (shorter than 1/fps to ensure we don't miss frames)
         int timeout_ms = std::min(100, 1000 / fps_ / 2);
+
+        // Id of the frame, carried by all its trace events on every thread
+        TRACE_BEGIN_FRAME();
         
-        if (getVideoFrame(video_channel_, frame, timeout_ms)) {
+        if (getVideoFrame(video_channel_, vpssFrame, timeout_ms, &acquiredUs)) {
+            // Converted straight from the VPSS buffer, which is given back
+            // before the callback runs, into the back slot of the triple
+            // buffer. A buffer still referenced by getFrame() or by the
+            // callback is left to them, and a new one is allocated.
+            CapturedFrame& slot = frames_.back();
+            if (slot.image.u && slot.image.u->refcount > 1) {
+                slot.image.release();
+            }
+            bool converted;
+            {
+                TRACE_SCOPE("capture.conversion");
+                converted = vpssFrame.toBgr(slot.image);
+            }
+            vpssFrame.release();
+            conversionLatency.record(MetricsRegistry::nowUs() - acquiredUs);
+            if (!converted) {
+                continue;
+            }
+
+            capturedFrames.add();
+            ++captured;
+
             // Get current timestamp
             gettimeofday(&tv, NULL);
             timestamp = tv.tv_sec * 1000 + tv.tv_usec / 1000; // milliseconds
             
-            // Store the frame
-            {
-                std::lock_guard<std::mutex> lock(frame_mutex_);
-                frame.copyTo(latest_frame_);
-                latest_timestamp_ = timestamp;
-                new_frame_available_ = true;
-            }
-            frame_cv_.notify_all();
+            // Publish the frame. The slot is only read from here on, by the
+            // callback and by getFrame().
+            slot.timestamp = timestamp;
+            const cv::Mat& frame = slot.image;
+            frames_.publish();
+            sem_post(&frame_sem_);
             
             // Call user callback if registered
             if (frame_callback_) {
+                const uint64_t callbackStart = MetricsRegistry::nowUs();
+                toCallbackLatency.record(callbackStart - acquiredUs);
+                TRACE_SCOPE("capture.callback");
                 frame_callback_(frame, timestamp);
+                callbackLatency.record(MetricsRegistry::nowUs() - callbackStart);
             }
         }
-        
-        // Sleep to match the desired frame rate
-        std::this_thread::sleep_for(std::chrono::milliseconds(1000 / fps_));
     }
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    LOGI(TAG) << "Captured " << captured << " frames (" << (seconds > 0 ? captured / seconds : 0.0)
+              << " fps, target " << fps_ << "), dropped " << dropped;
 }
 
 // Stop capturing frames
@@ -166,12 +234,8 @@ bool FrameCapturer::stop() {
     
     running_ = false;
     
-    // Notify any waiting threads
-    {
-        std::lock_guard<std::mutex> lock(frame_mutex_);
-        new_frame_available_ = true;
-    }
-    frame_cv_.notify_all();
+    // Wake up getFrame()
+    sem_post(&frame_sem_);
     
     return true;
 }
@@ -179,28 +243,36 @@ bool FrameCapturer::stop() {
 // Get the latest frame
 bool FrameCapturer::getFrame(cv::Mat& frame, int timeout_ms) {
     if (!running_) {
-        std::cerr << "FrameCapturer is not running" << std::endl;
+        LOGE(TAG) << "Not running";
         return false;
     }
 
-    std::unique_lock<std::mutex> lock(frame_mutex_);
-    
-    if (!new_frame_available_) {
+    if (!frames_.update()) {
         // Wait for a new frame with timeout
-        if (frame_cv_.wait_for(lock, std::chrono::milliseconds(timeout_ms), 
-                             [this] { return new_frame_available_ || stop_requested_; })) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += timeout_ms / 1000;
+        deadline.tv_nsec += (timeout_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        while (!frames_.update()) {
             if (stop_requested_) {
                 return false;
             }
-        } else {
-            // Timeout reached
-            return false;
+            if (sem_timedwait(&frame_sem_, &deadline) != 0 && errno != EINTR) {
+                // Timeout reached
+                return false;
+            }
         }
     }
-    
-    // Copy the latest frame
-    latest_frame_.copyTo(frame);
-    new_frame_available_ = false;
+    // The posts of the frames replaced before this one
+    while (sem_trywait(&frame_sem_) == 0) {
+    }
+
+    // Share the latest frame
+    frame = frames_.front().image;
     
     return true;
 }
@@ -213,7 +285,7 @@ void FrameCapturer::registerFrameCallback(FrameCallback callback) {
 // Set the frames per second
 bool FrameCapturer::setFPS(int fps) {
     if (running_) {
-        std::cerr << "Cannot change FPS while FrameCapturer is running" << std::endl;
+        LOGE(TAG) << "Cannot change FPS while running";
         return false;
     }
     
@@ -4,11 +4,11 @@
 #include <string>
 #include <functional>
 #include <atomic>
-#include <mutex>
-#include <condition_variable>
 #include <thread>
 #include <queue>
+#include <semaphore.h>
 #include "cvi_system.h"
+#include "../common/triple_buffer.h"
 
 /**
  * @brief A singleton class to capture frames from the camera at a specified rate
@@ -66,6 +66,10 @@ public:
 
     /**
      * @brief Get the latest frame
+     *
+     * The frame is not copied: it shares the capture buffer, which the
+     * capture thread does not write again while the frame is referenced.
+     * Only one thread may call getFrame().
      * 
      * @param frame The output frame as an OpenCV Mat
      * @param timeout_ms The timeout in milliseconds to wait for a frame
@@ -131,12 +135,15 @@ private:
     // Frame callback
     FrameCallback frame_callback_;
     
-    // Latest frame
-    cv::Mat latest_frame_;
-    std::mutex frame_mutex_;
-    std::condition_variable frame_cv_;
-    bool new_frame_available_;
-    uint64_t latest_timestamp_;
+    // Latest frame, handed over to getFrame() without copy or lock
+    struct CapturedFrame {
+        cv::Mat image;
+        uint64_t timestamp = 0;
+    };
+    TripleBuffer<CapturedFrame> frames_;
+    // Posted for every published frame: wakes getFrame() without the
+    // capture thread ever waiting on it
+    sem_t frame_sem_;
 
     // Video parameters
     video_ch_param_t video_params_;
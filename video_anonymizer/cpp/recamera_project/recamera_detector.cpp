@@ -1,14 +1,51 @@
 #include "recamera_detector.h"
-#include <iostream>
 #include <fstream>
 #include <algorithm>
+#include <cmath>
 #include <opencv2/imgproc.hpp>
+#include "../common/logger.h"
+#include "../common/metrics.h"
+#include "../common/tracer.h"
 
 // Include SSCMA headers
 #include <sscma.h>
 
 #define TAG "RecameraDetector"
 
+// Latencies of the detector stages
+struct DetectorMetrics {
+    LatencyHistogram& resize;
+    LatencyHistogram& preprocess;
+    LatencyHistogram& inference;
+    LatencyHistogram& postprocess;
+    LatencyHistogram& maskDecode;
+    MetricCounter& persons;
+
+    DetectorMetrics()
+        : resize(MetricsRegistry::instance().histogram("detector.resize")),
+          preprocess(MetricsRegistry::instance().histogram("detector.preprocess")),
+          inference(MetricsRegistry::instance().histogram("detector.inference")),
+          postprocess(MetricsRegistry::instance().histogram("detector.postprocess")),
+          maskDecode(MetricsRegistry::instance().histogram("detector.mask_decode")),
+          persons(MetricsRegistry::instance().counter("detector.persons")) {}
+};
+
+static DetectorMetrics& metrics() {
+    static DetectorMetrics m;
+    return m;
+}
+
+// Area of the frame covered by a box of the native mask, rounded outwards.
+// A mask decoded over the native box is stretched to this area, not to the
+// box it was computed for.
+static cv::Rect nativeToFrame(const cv::Rect& nativeBox, float scaleX, float scaleY) {
+    const int x0 = static_cast<int>(nativeBox.x / scaleX);
+    const int y0 = static_cast<int>(nativeBox.y / scaleY);
+    const int x1 = static_cast<int>(std::ceil((nativeBox.x + nativeBox.width) / scaleX));
+    const int y1 = static_cast<int>(std::ceil((nativeBox.y + nativeBox.height) / scaleY));
+    return cv::Rect(x0, y0, x1 - x0, y1 - y0);
+}
+
 // Helper function for image preprocessing
 cv::Mat preprocessImageWithPadding(cv::Mat& image, ma::Model* model) {
     int ih = image.rows;
@@ -67,9 +104,9 @@ RecameraDetector::RecameraDetector(const std::string& modelPath, const std::stri
       modelHandle(nullptr),
       personClassId(0) {
     
-    std::cout << TAG << ": Creating detector with model: " << modelPath << std::endl;
-    std::cout << TAG << ": Class names file: " << namesPath << std::endl;
-    std::cout << TAG << ": Confidence threshold: " << confThreshold << std::endl;
+    LOGI(TAG) << "Creating detector with model: " << modelPath;
+    LOGI(TAG) << "Class names file: " << namesPath;
+    LOGI(TAG) << "Confidence threshold: " << confThreshold;
     
     // Load class names from file if available
     try {
@@ -83,23 +120,23 @@ RecameraDetector::RecameraDetector(const std::string& modelPath, const std::stri
             }
             file.close();
             
-            std::cout << TAG << ": Loaded " << classNames.size() << " class names" << std::endl;
+            LOGI(TAG) << "Loaded " << classNames.size() << " class names";
             
             // Find the person class ID
             auto it = std::find(classNames.begin(), classNames.end(), "person");
             if (it != classNames.end()) {
                 personClassId = static_cast<int>(std::distance(classNames.begin(), it));
-                std::cout << TAG << ": Person class found at index: " << personClassId << std::endl;
+                LOGI(TAG) << "Person class found at index: " << personClassId;
             } else {
-                std::cout << TAG << ": Person class not found, using default ID 0" << std::endl;
+                LOGW(TAG) << "Person class not found, using default ID 0";
             }
         } else {
-            std::cerr << TAG << ": Warning: Could not open class names file: " << namesPath << std::endl;
+            LOGW(TAG) << "Could not open class names file: " << namesPath;
             // Add a default "person" class
             classNames.push_back("person");
         }
     } catch (const std::exception& e) {
-        std::cerr << TAG << ": Error loading class names: " << e.what() << std::endl;
+        LOGE(TAG) << "Error loading class names: " << e.what();
         // Add a default "person" class
         classNames.push_back("person");
     }
@@ -112,13 +149,13 @@ RecameraDetector::~RecameraDetector() {
     // Clean up SSCMA resources
     if (modelHandle) {
         try {
-            std::cout << TAG << ": Cleaning up model resources" << std::endl;
+            LOGI(TAG) << "Cleaning up model resources";
             // Clean up SSCMA resources
             ma::Model* model = static_cast<ma::Model*>(modelHandle);
             ma::ModelFactory::remove(model);
             modelHandle = nullptr;
         } catch (const std::exception& e) {
-            std::cerr << TAG << ": Exception during model cleanup: " << e.what() << std::endl;
+            LOGE(TAG) << "Exception during model cleanup: " << e.what();
         }
     }
 }
@@ -128,40 +165,40 @@ RecameraDetector::~RecameraDetector() {
  */
 bool RecameraDetector::initialize() {
     if (isInitialized) {
-        std::cout << TAG << ": Already initialized" << std::endl;
+        LOGI(TAG) << "Already initialized";
         return true; // Already initialized
     }
     
-    std::cout << TAG << ": Initializing detector..." << std::endl;
+    LOGI(TAG) << "Initializing detector...";
     
     try {
         ma_err_t ret = MA_OK;
         
         // Initialize SSCMA engine
-        std::cout << TAG << ": Creating CVI engine" << std::endl;
+        LOGI(TAG) << "Creating CVI engine";
         auto* engine = new ma::engine::EngineCVI();
         
-        std::cout << TAG << ": Initializing engine" << std::endl;
+        LOGI(TAG) << "Initializing engine";
         ret = engine->init();
         if (ret != MA_OK) {
-            std::cerr << TAG << ": Engine init failed with error: " << (int)ret << std::endl;
+            LOGE(TAG) << "Engine init failed with error: " << (int)ret;
             delete engine;
             return false;
         }
         
         // Load the model
-        std::cout << TAG << ": Loading model from: " << modelPath << std::endl;
+        LOGI(TAG) << "Loading model from: " << modelPath;
         ret = engine->load(modelPath.c_str());
         if (ret != MA_OK) {
-            std::cerr << TAG << ": Engine load model failed with error: " << (int)ret << std::endl;
+            LOGE(TAG) << "Engine load model failed with error: " << (int)ret;
             
             // Check if the model file exists
             std::ifstream modelFile(modelPath);
             if (!modelFile.good()) {
-                std::cerr << TAG << ": Model file does not exist or cannot be accessed" << std::endl;
+                LOGE(TAG) << "Model file does not exist or cannot be accessed";
             } else {
-                std::cerr << TAG << ": Model file exists but couldn't be loaded, size: " 
-                          << modelFile.tellg() << " bytes" << std::endl;
+                LOGE(TAG) << "Model file exists but couldn't be loaded, size: " 
+                          << modelFile.tellg() << " bytes";
             }
             
             delete engine;
@@ -169,18 +206,18 @@ bool RecameraDetector::initialize() {
         }
         
         // Create model
-        std::cout << TAG << ": Creating model from engine" << std::endl;
+        LOGI(TAG) << "Creating model from engine";
         ma::Model* model = ma::ModelFactory::create(engine);
         if (model == nullptr) {
-            std::cerr << TAG << ": Model not supported by the engine" << std::endl;
+            LOGE(TAG) << "Model not supported by the engine";
             delete engine;
             return false;
         }
         
         // Verify model type
-        std::cout << TAG << ": Verifying model input type" << std::endl;
+        LOGI(TAG) << "Verifying model input type";
         if (model->getInputType() != MA_INPUT_TYPE_IMAGE) {
-            std::cerr << TAG << ": Model input type not supported, type: " << model->getInputType() << std::endl;
+            LOGE(TAG) << "Model input type not supported, type: " << model->getInputType();
             ma::ModelFactory::remove(model);
             return false;
         }
@@ -190,21 +227,21 @@ bool RecameraDetector::initialize() {
         isInitialized = true;
         
         // Display model information
-        std::cout << TAG << ": Model info:" << std::endl;
-        std::cout << TAG << ":   - Input type: " << model->getInputType() << std::endl;
-        std::cout << TAG << ":   - Output type: " << model->getOutputType() << std::endl;
+        LOGI(TAG) << "Model info:";
+        LOGI(TAG) << "  - Input type: " << model->getInputType();
+        LOGI(TAG) << "  - Output type: " << model->getOutputType();
         
         if (model->getInputType() == MA_INPUT_TYPE_IMAGE) {
             const ma_img_t* img = reinterpret_cast<const ma_img_t*>(model->getInput());
-            std::cout << TAG << ":   - Input dimensions: " << img->width << "x" << img->height << std::endl;
+            LOGI(TAG) << "  - Input dimensions: " << img->width << "x" << img->height;
         }
         
         // Log success
-        std::cout << TAG << ": Model loaded and initialized successfully" << std::endl;
+        LOGI(TAG) << "Model loaded and initialized successfully";
         return true;
     }
     catch (const std::exception& e) {
-        std::cerr << TAG << ": Exception during initialization: " << e.what() << std::endl;
+        LOGE(TAG) << "Exception during initialization: " << e.what();
         return false;
     }
 }
@@ -213,12 +250,25 @@ bool RecameraDetector::initialize() {
  * Detect humans in an image
  */
 bool RecameraDetector::detect(const cv::Mat& img, std::vector<Detection>& detections) {
+    return runDetection(img, detections, nullptr);
+}
+
+/**
+ * Detect humans in an image, with the union of their masks
+ */
+bool RecameraDetector::detectWithMaskUnion(const cv::Mat& img, std::vector<Detection>& detections,
+                                           MaskUnion& maskUnion) {
+    maskUnion = MaskUnion();
+    return runDetection(img, detections, &maskUnion);
+}
+
+bool RecameraDetector::runDetection(const cv::Mat& img, std::vector<Detection>& detections, MaskUnion* maskUnion) {
     if (!isInitialized && !initialize()) {
-        std::cerr << TAG << ": Cannot detect - detector not initialized" << std::endl;
+        LOGE(TAG) << "Cannot detect - detector not initialized";
         return false;
     }
     
-    std::cout << TAG << ": Processing frame of size " << img.cols << "x" << img.rows << std::endl;
+    LOGD(TAG) << "Processing frame of size " << img.cols << "x" << img.rows;
     
     try {
         // Clear previous detections
@@ -228,10 +278,16 @@ bool RecameraDetector::detect(const cv::Mat& img, std::vector<Detection>& detect
         ma::Model* model = static_cast<ma::Model*>(modelHandle);
         
         // Preprocess the image for the model
+        const uint64_t resizeStart = MetricsRegistry::nowUs();
         //cv::Mat processedImg = preprocessImageWithPadding(const_cast<cv::Mat&>(img), model);   // TODO: This step could be avoided.
-        cv::Mat processedImg = preprocessImageResizeOnly(const_cast<cv::Mat&>(img), model);   // TODO: This step could be avoided.
+        cv::Mat processedImg;
+        {
+            TRACE_SCOPE("detector.resize");
+            processedImg = preprocessImageResizeOnly(const_cast<cv::Mat&>(img), model);   // TODO: This step could be avoided.
+        }
+        metrics().resize.record(MetricsRegistry::nowUs() - resizeStart);
 
-        std::cout << TAG << ": Preprocessed image size: " << processedImg.size() << std::endl;
+        LOGD(TAG) << "Preprocessed image size: " << processedImg.size();
         
         // Setup image for SSCMA
         ma_img_t sscmaImg;
@@ -242,7 +298,7 @@ bool RecameraDetector::detect(const cv::Mat& img, std::vector<Detection>& detect
         sscmaImg.format = MA_PIXEL_FORMAT_RGB888;
         sscmaImg.rotate = MA_PIXEL_ROTATE_0;
         
-        std::cout << TAG << ": Running inference" << std::endl;
+        LOGD(TAG) << "Running inference";
 
         // Run detection based on model type
         if (model->getOutputType() == MA_OUTPUT_TYPE_SEGMENT) {
@@ -250,32 +306,46 @@ bool RecameraDetector::detect(const cv::Mat& img, std::vector<Detection>& detect
             ma::model::Segmentor* segmentor = static_cast<ma::model::Segmentor*>(model);
             
             // Set confidence threshold
-            std::cout << TAG << ": Setting confidence threshold: " << confThreshold << std::endl;
+            LOGD(TAG) << "Setting confidence threshold: " << confThreshold;
             segmentor->setConfig(MA_MODEL_CFG_OPT_THRESHOLD, confThreshold);
             
             // Run detection
-            std::cout << TAG << ": Running segmentation model" << std::endl;
-            segmentor->run(&sscmaImg);
+            LOGD(TAG) << "Running segmentation model";
+            {
+                TRACE_SCOPE("detector.run");
+                segmentor->run(&sscmaImg);
+            }
             
             // Get results
-            std::cout << TAG << ": Getting results" << std::endl;
+            LOGD(TAG) << "Getting results";
             auto results = segmentor->getResults();
             if (results.empty()) {
-                std::cout << TAG << ": No results found" << std::endl;
+                LOGD(TAG) << "No results found";
             }
             
             // Original image dimensions for scaling back
             float orig_width = static_cast<float>(img.cols);
             float orig_height = static_cast<float>(img.rows);
+
+            // Union of the person masks at the native mask resolution, and
+            // the area it covers
+            cv::Mat unionNative;
+            cv::Mat personNative;
+            cv::Rect unionBox;
+            float unionScaleX = 1.0f;
+            float unionScaleY = 1.0f;
+            // Time spent decoding the masks of this frame
+            uint64_t maskDecodeUs = 0;
+            bool decodedMasks = false;
             
             // Convert SSCMA results to our IDetector format
             for (auto& result : results) {
-                std::cout << TAG << ": Processing result for class " << result.box.target 
-                          << " with score " << result.box.score << std::endl;
+                LOGD(TAG) << "Processing result for class " << result.box.target 
+                          << " with score " << result.box.score;
                           
                 // Only process person class or all classes if needed
                 if (result.box.target == personClassId) {
-                    std::cout << TAG << ": Found person with confidence " << result.box.score << std::endl;
+                    LOGD(TAG) << "Found person with confidence " << result.box.score;
                     Detection det;
             
                     // Convert normalized coordinates to pixel coordinates
@@ -295,71 +365,76 @@ bool RecameraDetector::detect(const cv::Mat& img, std::vector<Detection>& detect
                     det.confidence = result.box.score;
                     det.classId = result.box.target;
                     
-                    std::cout << TAG << ": Bounding box: " << det.bbox << std::endl;
+                    LOGD(TAG) << "Bounding box: " << det.bbox;
                     
                     // Create mask from segmentation data
                     if (!result.mask.data.empty()) {
-                        std::cout << TAG << ": Processing mask with dims " << result.mask.width << "x" << result.mask.height << '\n';
+                        LOGD(TAG) << "Processing mask with dims " << result.mask.width << "x" << result.mask.height;
 
                         // Measure the time it takes for each step
-                        auto start = std::chrono::high_resolution_clock::now();
-                        
-                        // First create mask at the native mask resolution
-                        cv::Mat nativeMask = cv::Mat::zeros(result.mask.height, result.mask.width, CV_8UC1);
+                        const uint64_t start = MetricsRegistry::nowUs();
+
+                        // The mask is kept at the native mask resolution and
+                        // only covers the box. It is stretched to the box when
+                        // the anonymization mask is built.
+                        det.bbox &= cv::Rect(0, 0, img.cols, img.rows);
+                        const float scaleX = static_cast<float>(result.mask.width) / img.cols;
+                        const float scaleY = static_cast<float>(result.mask.height) / img.rows;
+                        const int x0 = std::max(static_cast<int>(det.bbox.x * scaleX), 0);
+                        const int y0 = std::max(static_cast<int>(det.bbox.y * scaleY), 0);
+                        const int x1 = std::min(static_cast<int>(std::ceil((det.bbox.x + det.bbox.width) * scaleX)), result.mask.width);
+                        const int y1 = std::min(static_cast<int>(std::ceil((det.bbox.y + det.bbox.height) * scaleY)), result.mask.height);
 
-                        // Convert bit-packed mask to full mask at native resolution
-                        // TODO: would it be faster to use a LUT?
-                        for (int i = 0; i < result.mask.height; ++i) {
-                            for (int j = 0; j < result.mask.width; ++j) {
-                                // Check if the bit is set in the packed mask
-                                int byte_idx = i * result.mask.width / 8 + j / 8;
-                                int bit_idx = j % 8;
-                                
-                                if (byte_idx < result.mask.data.size() && 
-                                    (result.mask.data[byte_idx] & (1 << bit_idx))) {
-                                    nativeMask.at<uchar>(i, j) = 255;
+                        if (!det.bbox.empty() && x1 > x0 && y1 > y0) {
+                            const cv::Rect nativeBox(x0, y0, x1 - x0, y1 - y0);
+                            if (maskUnion) {
+                                // Only OR the person into the union, it is upscaled once by the caller
+                                if (unionNative.empty()) {
+                                    unionNative = cv::Mat::zeros(result.mask.height, result.mask.width, CV_8UC1);
                                 }
+                                maskDecoder.decode(result.mask.data.data(), result.mask.data.size(),
+                                                   result.mask.width, result.mask.height, nativeBox, personNative);
+                                cv::Mat roi = unionNative(nativeBox);
+                                cv::bitwise_or(roi, personNative, roi);
+                                unionBox |= nativeBox;
+                                maskUnion->instances.push_back(static_cast<int>(detections.size()));
+                                unionScaleX = scaleX;
+                                unionScaleY = scaleY;
+                            } else {
+                                // Expands 8 bits at a time, only inside the box
+                                maskDecoder.decode(result.mask.data.data(), result.mask.data.size(),
+                                                   result.mask.width, result.mask.height, nativeBox, det.mask);
                             }
+                            // The native box is rounded outwards, the mask
+                            // covers a slightly larger area than the box
+                            det.bbox = nativeToFrame(nativeBox, scaleX, scaleY);
                         }
 
-                        auto mask_creation_end = std::chrono::high_resolution_clock::now();
-                        auto mask_creation_duration = std::chrono::duration_cast<std::chrono::milliseconds>(mask_creation_end - start);
-                        std::cout << TAG << ": Mask creation time: " << mask_creation_duration.count() << "ms\n";
-
-                        // Resize the mask to match the original image size
-                        cv::Mat mask;
-                        if (nativeMask.rows != img.rows || nativeMask.cols != img.cols) {
-                            cv::resize(nativeMask, mask, cv::Size(img.cols, img.rows), 0, 0, cv::INTER_NEAREST);
-                        } else {
-                            mask = nativeMask;
-                        }
-                        
-                        auto mask_resize_end = std::chrono::high_resolution_clock::now();
-                        auto mask_resize_duration = std::chrono::duration_cast<std::chrono::milliseconds>(mask_resize_end - mask_creation_end);
-                        std::cout << TAG << ": Mask resize time: " << mask_resize_duration.count() << "ms\n";
-
-                        // Apply some dilation to improve the mask
-                        /*
-                        cv::Mat element = cv::getStructuringElement(cv::MORPH_ELLIPSE, cv::Size(3, 3));
-                        cv::dilate(mask, mask, element);
-
-                        auto mask_dilate_end = std::chrono::high_resolution_clock::now();
-                        auto mask_dilate_duration = std::chrono::duration_cast<std::chrono::milliseconds>(mask_dilate_end - mask_resize_end);
-                        std::cout << TAG << ": Mask dilation time: " << mask_dilate_duration.count() << "ms\n";
-                        */
-                       
-                        det.mask = mask;
-                        //std::cout << TAG << ": Mask created with non-zero pixels: " 
-                        //          << cv::countNonZero(mask) << std::endl;
+                        const uint64_t maskCreationUs = MetricsRegistry::nowUs() - start;
+                        maskDecodeUs += maskCreationUs;
+                        decodedMasks = true;
+                        LOGD(TAG) << "Mask creation time: " << maskCreationUs / 1000.0 << "ms, "
+                                  << det.mask.cols << "x" << det.mask.rows << " for box " << det.bbox;
                     } else {
-                        std::cout << TAG << ": No mask data available" << std::endl;
+                        LOGD(TAG) << "No mask data available";
                     }
                     
                     detections.push_back(det);
                 } else {
-                    std::cout << TAG << ": Skipping non-person class " << result.box.target << std::endl;
+                    LOGD(TAG) << "Skipping non-person class " << result.box.target;
                 }
             }
+
+            if (decodedMasks) {
+                metrics().maskDecode.record(maskDecodeUs);
+            }
+
+            if (maskUnion && !unionBox.empty()) {
+                maskUnion->mask = unionNative(unionBox);
+                maskUnion->bbox = nativeToFrame(unionBox, unionScaleX, unionScaleY);
+                LOGD(TAG) << "Mask union " << unionBox.width << "x" << unionBox.height
+                          << " for box " << maskUnion->bbox;
+            }
         } 
         else if (model->getOutputType() == MA_OUTPUT_TYPE_BBOX) {
             // For regular detection models (without masks)
@@ -369,7 +444,10 @@ bool RecameraDetector::detect(const cv::Mat& img, std::vector<Detection>& detect
             detector->setConfig(MA_MODEL_CFG_OPT_THRESHOLD, confThreshold);
             
             // Run detection
-            detector->run(&sscmaImg);
+            {
+                TRACE_SCOPE("detector.run");
+                detector->run(&sscmaImg);
+            }
             
             // Get results
             auto results = detector->getResults();
@@ -408,15 +486,19 @@ bool RecameraDetector::detect(const cv::Mat& img, std::vector<Detection>& detect
         
         // Log performance metrics
         auto perf = model->getPerf();
-        std::cout << TAG << ": Performance: preprocess=" << perf.preprocess << "ms, inference=" 
-                  << perf.inference << "ms, postprocess=" << perf.postprocess << "ms" << std::endl;
-        std::cout << TAG << ": Total detections found: " << detections.size() << std::endl;
+        metrics().preprocess.record(static_cast<uint64_t>(perf.preprocess * 1000));
+        metrics().inference.record(static_cast<uint64_t>(perf.inference * 1000));
+        metrics().postprocess.record(static_cast<uint64_t>(perf.postprocess * 1000));
+        metrics().persons.add(detections.size());
+        LOGD(TAG) << "Performance: preprocess=" << perf.preprocess << "ms, inference=" 
+                  << perf.inference << "ms, postprocess=" << perf.postprocess << "ms";
+        LOGD(TAG) << "Total detections found: " << detections.size();
         
-        std::cout << TAG << ": Detection successful with " << detections.size() << " people found" << std::endl;
+        LOGD(TAG) << "Detection successful with " << detections.size() << " people found";
         return true;
     }
     catch (const std::exception& e) {
-        std::cerr << TAG << ": Exception during detection: " << e.what() << std::endl;
+        LOGE(TAG) << "Exception during detection: " << e.what();
         return false;
     }
 }
@@ -438,7 +520,7 @@ cv::Size RecameraDetector::getInputSize() const {
         }
     }
     catch (const std::exception& e) {
-        std::cerr << "Exception getting input size: " << e.what() << std::endl;
+        LOGE(TAG) << "Exception getting input size: " << e.what();
     }
     
     return cv::Size(640, 640); // Default size
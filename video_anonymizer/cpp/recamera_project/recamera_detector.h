@@ -5,6 +5,7 @@
 #include <vector>
 #include <opencv2/opencv.hpp>
 #include "../common/idetector.h"
+#include "../common/packed_mask_decoder.h"
 
 /**
  * @brief RecameraDetector implements the IDetector interface for the ReCamera platform.
@@ -45,6 +46,18 @@ public:
      * @return false if detection failed
      */
     bool detect(const cv::Mat& img, std::vector<Detection>& detections) override;
+
+    /**
+     * @brief Detect humans and OR their masks at the native mask resolution
+     *
+     * @param img Input image (BGR format)
+     * @param detections Output vector of detected bounding boxes, without masks
+     * @param maskUnion Union of the person masks
+     * @return true if detection succeeded
+     * @return false if detection failed
+     */
+    bool detectWithMaskUnion(const cv::Mat& img, std::vector<Detection>& detections,
+                             MaskUnion& maskUnion) override;
     
     /**
      * @brief Get the model input size
@@ -68,6 +81,9 @@ public:
     const std::vector<std::string> &getClassNames() const override;
     
 private:
+    /// Run the model. Person masks go to maskUnion if it is not null, to the detections otherwise
+    bool runDetection(const cv::Mat& img, std::vector<Detection>& detections, MaskUnion* maskUnion);
+
     /// Path to the YOLO model file
     std::string modelPath;
     
@@ -88,6 +104,9 @@ private:
     
     /// Person class ID (typically 0 in COCO)
     int personClassId;
+
+    /// Decoder of the bit-packed segmentation masks
+    PackedMaskDecoder maskDecoder;
 };
 
 #endif // RECAMERA_DETECTOR_H
@@ -1,4 +1,3 @@
-#include <iostream>
 #include <string>
 #include <chrono>
 #include <iomanip> // For std::setprecision and formatting
@@ -10,16 +9,61 @@
 #include "../common/video_anonymizer.h" // Use the common VideoAnonymizer
 #include "frame_capturer.h"
 #include "cvi_h264_streamer.h"
+#include "../common/logger.h"
+#include "../common/metrics.h"
+#include "../common/tracer.h"
+#include "../common/qos_governor.h"
 
 #define TAG "recamera_main"
 
 // Global flag to indicate when the application should exit
 std::atomic<bool> g_running(true);
+// Signal that stopped the application, logged by the main loop
+std::atomic<int> g_signal(0);
+// Set by SIGUSR1, the main loop then writes the trace
+std::atomic<bool> g_traceRequested(false);
 std::unique_ptr<VideoAnonymizer> g_anonymizer;
+// Created with a frame budget only, used by the capture thread
+std::unique_ptr<QosGovernor> g_governor;
+
+// Log the latency percentiles of every stage and the counters
+static void logMetrics(bool reset) {
+    for (const std::string& line : MetricsRegistry::instance().snapshot(reset).format()) {
+        LOGI(TAG) << line;
+    }
+}
+
+// Write the timeline of the pipeline threads
+static void writeTrace(const std::string& path) {
+    if (Tracer::instance().exportJson(path)) {
+        LOGI(TAG) << "Trace written to " << path;
+    } else {
+        LOGE(TAG) << "Failed to write the trace to " << path;
+    }
+}
+
+// Trace request (kill -USR1 <pid>)
+void traceSignalHandler(int) {
+    g_traceRequested.store(true);
+}
+
+// Apply the quality settings chosen by the governor. Called from the capture
+// thread, between two frames.
+static void applyQosSettings(CviH264Streamer* streamer, int qpMin, int qpMax) {
+    const QosGovernor::Settings& settings = g_governor->getSettings();
+    g_anonymizer->setDetectionInterval(settings.detectionInterval);
+    g_anonymizer->setDilationShape(settings.dilationShape);
+    g_anonymizer->setAnonymizationMode(settings.anonymizationMode);
+    g_anonymizer->setFullFrameFallback(settings.fullFrame);
+    if (streamer) {
+        streamer->setQpRange(qpMin + settings.qpOffset, qpMax + settings.qpOffset);
+    }
+    LOGI(TAG) << "QoS " << g_governor->describe();
+}
 
 // Signal handler for Ctrl+C
 void signalHandler(int signum) {
-    std::cout << std::endl << "Interrupt signal (" << signum << ") received. Shutting down..." << std::endl;
+    g_signal.store(signum);
     g_running.store(false);
     
     // Don't exit immediately - let the main loop handle cleanup
@@ -27,7 +71,8 @@ void signalHandler(int signum) {
     signal(signum, SIG_DFL);
 }
 
-// Frame callback function that processes frames and sends them to the RTSP streamer
+// Frame callback function that processes frames and sends them to the RTSP streamer.
+// processedFrame is written in place if it already has the frame geometry.
 bool frameCallback(const cv::Mat& frame, uint64_t timestamp, cv::Mat& processedFrame) {
     static int frameCount = 0;
     static auto lastStatsTime = std::chrono::high_resolution_clock::now();
@@ -38,7 +83,7 @@ bool frameCallback(const cv::Mat& frame, uint64_t timestamp, cv::Mat& processedF
     }
     
     if (frame.empty()) {
-        std::cerr << "Empty frame received" << std::endl;
+        LOGE(TAG) << "Empty frame received";
         return false;
     }
     
@@ -47,13 +92,13 @@ bool frameCallback(const cv::Mat& frame, uint64_t timestamp, cv::Mat& processedF
     
     if (g_anonymizer) {
         try {
-            processedFrame = g_anonymizer->processFrame(frame);
+            g_anonymizer->processFrame(frame, processedFrame);
         } catch (const std::exception& e) {
-            std::cerr << "Error processing frame: " << e.what() << std::endl;
-            processedFrame = frame.clone();
+            LOGE(TAG) << "Error processing frame: " << e.what();
+            frame.copyTo(processedFrame);
         }
     } else {
-        processedFrame = frame.clone();
+        frame.copyTo(processedFrame);
     }
     
     auto endTime = std::chrono::high_resolution_clock::now();
@@ -75,8 +120,12 @@ bool frameCallback(const cv::Mat& frame, uint64_t timestamp, cv::Mat& processedF
     
     if (elapsed >= 5) {
         float fps = statFrameCount / static_cast<float>(elapsed);
-        std::cout << "Processing rate: " << std::fixed << std::setprecision(1) << fps 
-                  << " FPS, latency: " << duration << " ms" << std::endl;
+        LogLine stats(LogLevel::INFO, TAG);
+        stats.stream() << "Processing rate: " << std::fixed << std::setprecision(1) << fps 
+                       << " FPS, latency: " << duration << " ms";
+        if (g_anonymizer) {
+            stats.stream() << ", mask age: " << g_anonymizer->getMaskAge() << " frames";
+        }
         statFrameCount = 0;
         lastStatsTime = now;
     }
@@ -103,6 +152,25 @@ int main(int argc, char** argv) {
         "{password       | admin| RTSP password}"
         "{disable_rtsp   |      | Disable RTSP streaming}"
         "{disable_anonymization |      | Disable anonymization}"
+        "{dilation       | disk | Mask dilation shape (none, disk, rect)}"
+        "{bg_model       | ema  | Background model (ema, cnt)}"
+        "{fg_mask        |      | Also hide the moving pixels found by the background model (cnt only)}"
+        "{mode           | background | Anonymization mode (background, blur, pixelate, solid)}"
+        "{blur           | 21   | Blur kernel size in pixels}"
+        "{pixel_size     | 16   | Pixelation block size in pixels}"
+        "{mask_union     |      | Union the person masks at the detector resolution, upscale once}"
+        "{budget_ms      | 0    | Frame processing budget in ms, lower the quality step by step above it (0: off)}"
+        "{metrics_period | 0    | Log the stage latencies every N seconds (0: only on exit)}"
+        "{motion_gate    |      | Skip the detector while the scene is static and nobody is in view}"
+        "{gate_refresh   | 30   | Motion gate: run the detector at least every N frames}"
+        "{record         |      | Record the detections to this file, to replay them later}"
+        "{replay         |      | Replay the detections of this recording (or SSCMA log) instead of running the model}"
+        "{trace          |      | Record a timeline of the pipeline threads, written to this Chrome trace file on exit and on SIGUSR1}"
+        "{log_level      | info | Lowest log level written (debug, info, warn, error, none)}"
+        "{async          |      | Run detection on a worker thread, composite at capture rate}"
+        "{max_mask_age   | 5    | Asynchronous mode: oldest mask in frames before hiding the whole frame}"
+        "{detect_every   | 1    | Run the detector every N frames, move the masks in between}"
+        "{track_history  | 15   | Frames a missed person stays anonymized, 0 disables tracking}"
         "{bitrate        | 4000000| Bitrate in bps}"
         "{gop            | 10     | GOP in frames}"
         "{vbPoolCount    | 8     | VB pool count}"
@@ -117,7 +185,7 @@ int main(int argc, char** argv) {
     parser.about("ReCamera Anonymizer - Blur people in video streams");
 
     // Show help if requested or if required parameters are missing
-    if (parser.has("help") || (!parser.has("@model") && !parser.has("disable_anonymization"))) {
+    if (parser.has("help") || (!parser.has("@model") && !parser.has("replay") && !parser.has("disable_anonymization"))) {
         parser.printMessage();
         return 0;
     }
@@ -134,6 +202,25 @@ int main(int argc, char** argv) {
     std::string password = parser.get<std::string>("password");
     bool disableRtsp = parser.has("disable_rtsp");
     bool disableAnonymization = parser.has("disable_anonymization");
+    std::string dilationShapeName = parser.get<std::string>("dilation");
+    std::string backgroundModelName = parser.get<std::string>("bg_model");
+    bool foregroundMasking = parser.has("fg_mask");
+    std::string anonymizationModeName = parser.get<std::string>("mode");
+    int blurStrength = parser.get<int>("blur");
+    int pixelSize = parser.get<int>("pixel_size");
+    bool useMaskUnion = parser.has("mask_union");
+    float budgetMs = parser.get<float>("budget_ms");
+    int metricsPeriod = parser.get<int>("metrics_period");
+    bool useMotionGate = parser.has("motion_gate");
+    int gateRefreshInterval = parser.get<int>("gate_refresh");
+    std::string recordPath = parser.get<std::string>("record");
+    std::string replayPath = parser.get<std::string>("replay");
+    std::string tracePath = parser.get<std::string>("trace");
+    std::string logLevelName = parser.get<std::string>("log_level");
+    bool asyncDetection = parser.has("async");
+    int maxMaskAge = parser.get<int>("max_mask_age");
+    int detectionInterval = parser.get<int>("detect_every");
+    int trackHistory = parser.get<int>("track_history");
     int bitrate = parser.get<int>("bitrate");
     int gop = parser.get<int>("gop");
     int vbPoolCount = parser.get<int>("vbPoolCount");
@@ -149,27 +236,63 @@ int main(int argc, char** argv) {
         return 1;
     }
 
+    LogLevel logLevel;
+    if (!Logger::parseLevel(logLevelName, logLevel)) {
+        LOGE(TAG) << "Unknown log level: " << logLevelName;
+        return 1;
+    }
+    Logger::instance().setLevel(logLevel);
+
+    if (!tracePath.empty()) {
+#ifdef ENABLE_TRACING
+        Tracer::instance().setEnabled(true);
+        signal(SIGUSR1, traceSignalHandler);
+        LOGI(TAG) << "Tracing to " << tracePath << ", send SIGUSR1 to write the trace";
+#else
+        LOGW(TAG) << "Tracing is not compiled in, build with -DENABLE_TRACING=ON";
+        tracePath.clear();
+#endif
+    }
+
+    MaskDilator::Shape dilationShape;
+    if (!MaskDilator::parseShape(dilationShapeName, dilationShape)) {
+        LOGE(TAG) << "Unknown dilation shape: " << dilationShapeName;
+        return 1;
+    }
+
+    BackgroundModelFactory::Type backgroundModel;
+    if (!BackgroundModelFactory::parseType(backgroundModelName, backgroundModel)) {
+        LOGE(TAG) << "Unknown background model: " << backgroundModelName;
+        return 1;
+    }
+
+    RegionAnonymizer::Mode anonymizationMode;
+    if (!RegionAnonymizer::parseMode(anonymizationModeName, anonymizationMode)) {
+        LOGE(TAG) << "Unknown anonymization mode: " << anonymizationModeName;
+        return 1;
+    }
+
     // Display current settings
-    std::cout << "Model path: " << (disableAnonymization ? "Disabled" : modelPath) << std::endl;
-    std::cout << "Confidence threshold: " << confThreshold << std::endl;
-    std::cout << "Capture settings: " << captureWidth << "x" << captureHeight 
-              << " @ " << captureFps << " FPS" << std::endl;
-    std::cout << "RTSP streaming on port " << streamPort 
-              << ", stream name: " << streamName << std::endl;
+    LOGI(TAG) << "Model path: " << (disableAnonymization ? "Disabled" : modelPath);
+    LOGI(TAG) << "Confidence threshold: " << confThreshold;
+    LOGI(TAG) << "Capture settings: " << captureWidth << "x" << captureHeight 
+              << " @ " << captureFps << " FPS";
+    LOGI(TAG) << "RTSP streaming on port " << streamPort 
+              << ", stream name: " << streamName;
 
 
 
 
     // --- Initialize Camera ---
-    std::cout << "Initializing frame capturer..." << std::endl;
+    LOGI(TAG) << "Initializing frame capturer...";
     FrameCapturer& capturer = FrameCapturer::getInstance(captureWidth, captureHeight, captureFps, VIDEO_CH0);
     
     if (!capturer.initialize()) {
-        std::cerr << "Error: Could not initialize FrameCapturer" << std::endl;
+        LOGE(TAG) << "Could not initialize FrameCapturer";
         return 1;
     }
     
-    std::cout << "Frame capturer initialized successfully" << std::endl;
+    LOGI(TAG) << "Frame capturer initialized successfully";
 
 
     // --- Configure H264 Streamer ---
@@ -194,18 +317,18 @@ int main(int argc, char** argv) {
     streamerConfig.qpInit = qpInit;            // Starting quality level 
 
     
-    std::cout << "Initializing H264 streamer..." << std::endl;
+    LOGI(TAG) << "Initializing H264 streamer...";
     CviH264Streamer streamer(streamerConfig);
 
     if (!disableRtsp) {
         // Configure the streamer
-        std::cout << "Configuring H264 streamer" << std::endl;
+        LOGI(TAG) << "Configuring H264 streamer";
         if (!streamer.initialize(false, true, false)) {
-            std::cerr << "Failed to initialize H264 streamer" << std::endl;
+            LOGE(TAG) << "Failed to initialize H264 streamer";
             return 1;
         }
         
-        std::cout << "H264 Streamer configured successfully" << std::endl;
+        LOGI(TAG) << "H264 Streamer configured successfully";
     }
 
     // --- Initialize VideoAnonymizer if not disabled ---
@@ -218,26 +341,59 @@ int main(int argc, char** argv) {
             params.confThreshold = confThreshold;
             params.iouThreshold = 0.45f;
             params.learningRate = 0.01f;
+            params.dilationShape = dilationShape;
+            params.backgroundModel = backgroundModel;
+            params.foregroundMasking = foregroundMasking;
+            params.anonymizationMode = anonymizationMode;
+            params.blurStrength = blurStrength;
+            params.pixelSize = pixelSize;
+            params.useMaskUnion = useMaskUnion;
+            params.asyncDetection = asyncDetection;
+            params.maxMaskAge = maxMaskAge;
+            params.detectionInterval = detectionInterval;
+            params.useTracking = trackHistory > 0;
+            params.trackHistory = trackHistory;
+            params.useMotionGate = useMotionGate;
+            params.gateRefreshInterval = gateRefreshInterval;
+            params.recordPath = recordPath;
+            params.replayPath = replayPath;
             params.useGPU = false;
             params.debugMode = false;
             
             // Create the anonymizer
             g_anonymizer = std::make_unique<VideoAnonymizer>(params);
-            std::cout << "Video anonymizer initialized successfully" << std::endl;
+            LOGI(TAG) << "Video anonymizer initialized successfully";
+
+            if (budgetMs > 0) {
+                QosGovernor::Parameters qosParams;
+                qosParams.budgetMs = budgetMs;
+                QosGovernor::Settings base;
+                base.detectionInterval = detectionInterval;
+                base.dilationShape = dilationShape;
+                base.anonymizationMode = anonymizationMode;
+                g_governor = std::make_unique<QosGovernor>(qosParams, base);
+                LOGI(TAG) << "Frame budget: " << budgetMs << " ms";
+            }
         } catch (const std::exception& e) {
-            std::cerr << "Failed to initialize video anonymizer: " << e.what() << std::endl;
-            std::cerr << "Continuing without anonymization" << std::endl;
+            LOGE(TAG) << "Failed to initialize video anonymizer: " << e.what();
+            LOGE(TAG) << "Continuing without anonymization";
             disableAnonymization = true;
         }
     } else {
-        std::cout << "Anonymization disabled by command line option" << std::endl;
+        LOGI(TAG) << "Anonymization disabled by command line option";
     }
 
 
     int frameCount = 0;
+    // Output buffer of the callback. The capture buffer is never modified.
+    cv::Mat processedFrame;
     // Set up frame callback function
-    auto callback = [&streamer, disableRtsp, &frameCount](const cv::Mat& frame, uint64_t timestamp) -> bool {
-        cv::Mat processedFrame;
+    auto callback = [&streamer, disableRtsp, qpMin, qpMax, &frameCount, &processedFrame](const cv::Mat& frame, uint64_t timestamp) -> bool {
+        const uint64_t startUs = MetricsRegistry::nowUs();
+        // Reuse the output buffer, unless the streamer still holds the previous frame
+        if (processedFrame.u && processedFrame.u->refcount > 1) {
+            processedFrame.release();
+        }
         // Process the frame with our global callback
         bool processed = frameCallback(frame, timestamp, processedFrame);
         
@@ -245,9 +401,14 @@ int main(int argc, char** argv) {
         if (processed) {
             frameCount++;
             if (!disableRtsp) {
-                return streamer.sendFrame(processedFrame);
+                processed = streamer.sendFrame(processedFrame);
             }
         }
+
+        // The new settings apply from the next frame
+        if (g_governor && g_governor->update(MetricsRegistry::nowUs() - startUs)) {
+            applyQosSettings(disableRtsp ? nullptr : &streamer, qpMin, qpMax);
+        }
         
         return processed;
     };
@@ -255,45 +416,56 @@ int main(int argc, char** argv) {
     capturer.registerFrameCallback(callback);
     
     // Start frame capture
-    std::cout << "Starting continuous frame capture and processing..." << std::endl;
+    LOGI(TAG) << "Starting continuous frame capture and processing...";
     if (!capturer.start()) {
-        std::cerr << "Error: Could not start frame capture" << std::endl;
+        LOGE(TAG) << "Could not start frame capture";
         return 1;
     }
 
     if (!disableRtsp) {
         // Start the streamer
-        std::cout << "Starting RTSP streamer" << std::endl;
+        LOGI(TAG) << "Starting RTSP streamer";
         if (!streamer.initialize(false, false, true)) {
-            std::cerr << "Failed to start RTSP streamer" << std::endl;
+            LOGE(TAG) << "Failed to start RTSP streamer";
             return 1;
         }
-        std::cout << "RTSP streamer started" << std::endl;
-        std::cout << "Connect to one of these URLs with any RTSP client (e.g., VLC):" << std::endl;
-        std::cout << streamer.getStreamUrl() << std::endl;
+        LOGI(TAG) << "RTSP streamer started";
+        LOGI(TAG) << "Connect to one of these URLs with any RTSP client (e.g., VLC):";
+        LOGI(TAG) << streamer.getStreamUrl();
     }
 
-    std::cout << "Press Ctrl+C to exit" << std::endl;
+    LOGI(TAG) << "Press Ctrl+C to exit";
     
     auto startTime = std::chrono::steady_clock::now();
     auto lastStatusTime = startTime;
+    auto lastMetricsTime = startTime;
     // Main loop - keep running until signal received
     while (g_running.load()) {
         // Print client count and status every 5 seconds
         auto now = std::chrono::steady_clock::now();
         
         if (std::chrono::duration_cast<std::chrono::seconds>(now - lastStatusTime).count() >= 5) {
-            std::cout << "RTSP clients connected: " << streamer.getClientCount() << '\n';
-            std::cout << "Frame count: " << frameCount << '\n';
-            std::cout << "FPS: " << frameCount / std::chrono::duration<double>(now - startTime).count() << '\n';
+            LOGI(TAG) << "RTSP clients connected: " << streamer.getClientCount()
+                      << ", frame count: " << frameCount
+                      << ", FPS: " << frameCount / std::chrono::duration<double>(now - startTime).count();
             lastStatusTime = now;
         }
+
+        // Percentiles of the last period only
+        if (metricsPeriod > 0 && std::chrono::duration_cast<std::chrono::seconds>(now - lastMetricsTime).count() >= metricsPeriod) {
+            logMetrics(true);
+            lastMetricsTime = now;
+        }
+
+        if (g_traceRequested.exchange(false) && !tracePath.empty()) {
+            writeTrace(tracePath);
+        }
         
         // Sleep to avoid excessive CPU usage
         std::this_thread::sleep_for(std::chrono::milliseconds(100));
     }
     
-    std::cout << "Shutting down..." << std::endl;
+    LOGI(TAG) << "Interrupt signal (" << g_signal.load() << ") received. Shutting down...";
 
 
     while (g_running) {
@@ -301,7 +473,7 @@ int main(int argc, char** argv) {
     }
     
     // Clean up resources
-    std::cout << "Shutting down and releasing resources..." << std::endl;
+    LOGI(TAG) << "Shutting down and releasing resources...";
     
     // Stop frame capture
     capturer.stop();
@@ -313,7 +485,12 @@ int main(int argc, char** argv) {
     
     // Release anonymizer
     g_anonymizer.reset();
+
+    logMetrics(false);
+    if (!tracePath.empty()) {
+        writeTrace(tracePath);
+    }
     
-    std::cout << "Exited gracefully" << std::endl;
+    LOGI(TAG) << "Exited gracefully";
     return 0;
 }
@@ -0,0 +1,77 @@
+#include "vb_mapping_cache.h"
+#include "../common/logger.h"
+#include "../common/metrics.h"
+
+extern "C" {
+    #include "cvi_type.h"
+    #include "cvi_sys.h"
+}
+
+#define TAG "VbMappingCache"
+
+VbMappingCache& VbMappingCache::instance() {
+    static VbMappingCache cache;
+    return cache;
+}
+
+VbMappingCache::~VbMappingCache() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    unmapAll();
+}
+
+void* VbMappingCache::map(uint64_t phyAddr, uint32_t size) {
+    static MetricCounter& mapped = MetricsRegistry::instance().counter("vb.mmap");
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (Mapping& m : m_mappings) {
+        if (m.phyAddr == phyAddr) {
+            if (m.size >= size) {
+                return m.virAddr;
+            }
+            // Same block, larger range: map it again
+            CVI_SYS_Munmap(m.virAddr, m.size);
+            m = m_mappings.back();
+            m_mappings.pop_back();
+            break;
+        }
+    }
+
+    // The blocks in use cannot be unmapped here, only reported
+    if (m_mappings.size() == kMaxMappings) {
+        LOGW(TAG) << kMaxMappings << " blocks mapped, were the VB pools recreated without clear()?";
+    }
+
+    void* virAddr = CVI_SYS_MmapCache(phyAddr, size);
+    if (!virAddr) {
+        LOGE(TAG) << "Could not map 0x" << std::hex << phyAddr << std::dec << " (" << size << " bytes)";
+        return nullptr;
+    }
+    mapped.add();
+    m_mappings.push_back(Mapping{phyAddr, size, virAddr});
+    return virAddr;
+}
+
+void VbMappingCache::invalidate(uint64_t phyAddr, void* virAddr, uint32_t size) {
+    CVI_SYS_IonInvalidateCache(phyAddr, virAddr, size);
+}
+
+void VbMappingCache::flush(uint64_t phyAddr, void* virAddr, uint32_t size) {
+    CVI_SYS_IonFlushCache(phyAddr, virAddr, size);
+}
+
+void VbMappingCache::clear() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    unmapAll();
+}
+
+size_t VbMappingCache::size() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_mappings.size();
+}
+
+void VbMappingCache::unmapAll() {
+    for (const Mapping& m : m_mappings) {
+        CVI_SYS_Munmap(m.virAddr, m.size);
+    }
+    m_mappings.clear();
+}
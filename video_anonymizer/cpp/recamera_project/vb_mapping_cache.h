@@ -0,0 +1,80 @@
+#ifndef VB_MAPPING_CACHE_H
+#define VB_MAPPING_CACHE_H
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief Keeps the VB blocks mapped in user space between frames
+ *
+ * The VB pools recycle a small fixed set of physical blocks. Instead of a
+ * CVI_SYS_Mmap / CVI_SYS_Munmap pair per plane and per frame, every block is
+ * mapped once, cached, at its first use, and unmapped when the pools are
+ * torn down. The mappings are cached, so the CPU reads and writes them at
+ * full speed, and coherency with the hardware blocks is kept explicitly:
+ * - invalidate() before reading what VPSS or VI wrote
+ * - flush() after writing what VENC will read
+ *
+ * Thread safe: the capture and the encoding threads share the cache.
+ */
+class VbMappingCache {
+public:
+    /**
+     * @brief Get the cache shared by the whole process
+     */
+    static VbMappingCache& instance();
+
+    /**
+     * @brief Get the virtual address of a physical range, mapping it at first use
+     *
+     * @param phyAddr Physical address of the range
+     * @param size Size of the range in bytes
+     * @return Virtual address, nullptr if the mapping failed
+     */
+    void* map(uint64_t phyAddr, uint32_t size);
+
+    /**
+     * @brief Drop the CPU cache lines of a range written by the hardware
+     */
+    void invalidate(uint64_t phyAddr, void* virAddr, uint32_t size);
+
+    /**
+     * @brief Write back the CPU cache lines of a range read by the hardware
+     */
+    void flush(uint64_t phyAddr, void* virAddr, uint32_t size);
+
+    /**
+     * @brief Unmap all the ranges, before the VB pools are destroyed
+     */
+    void clear();
+
+    /**
+     * @brief Get the number of mapped ranges
+     */
+    size_t size() const;
+
+private:
+    VbMappingCache() = default;
+    ~VbMappingCache();
+    VbMappingCache(const VbMappingCache&) = delete;
+    VbMappingCache& operator=(const VbMappingCache&) = delete;
+
+    // Unmap all the ranges, with m_mutex held
+    void unmapAll();
+
+    struct Mapping {
+        uint64_t phyAddr;
+        uint32_t size;
+        void* virAddr;
+    };
+
+    // Far more blocks than the pools have, reported as a leak
+    static constexpr size_t kMaxMappings = 64;
+
+    mutable std::mutex m_mutex;
+    // A few blocks per pool, a linear search is the fastest
+    std::vector<Mapping> m_mappings;
+};
+
+#endif // VB_MAPPING_CACHE_H